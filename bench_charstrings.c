@@ -0,0 +1,136 @@
+/* Benchmark for the charstring engines: converts every glyph of Type 1
+   fonts to Type 2 with t1char_convert_charstring() and copies every
+   glyph of OpenType/CFF fonts with cs_copy_charstring(), repeating each
+   font for about a second, and reports glyphs per second.
+
+./bench_charstrings font.pfb font.otf ...
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libtexpdf.h"
+
+#define BENCH_SECONDS 1.0
+
+static card8 dst[65536];
+
+static double
+seconds (clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static long
+convert_type1 (cff_font *cff)
+{
+  cff_index *cstrings = cff->cstrings;
+  t1_ginfo   ginfo;
+  long       gid;
+
+  for (gid = 0; gid < cstrings->count; gid++) {
+    t1char_convert_charstring(dst, sizeof(dst),
+			      cstrings->data + cstrings->offset[gid] - 1,
+			      cstrings->offset[gid+1] - cstrings->offset[gid],
+			      cff->subrs[0], 0.0, 0.0, &ginfo);
+  }
+
+  return cstrings->count;
+}
+
+static long
+copy_type2 (cff_font *cff, cff_index *cstrings)
+{
+  cs_ginfo ginfo;
+  long     gid;
+  int      fd;
+
+  for (gid = 0; gid < cstrings->count; gid++) {
+    fd = (cff->flag & FONTTYPE_CIDFONT) ? cff_fdselect_lookup(cff, gid) : 0;
+    cs_copy_charstring(dst, sizeof(dst),
+		       cstrings->data + cstrings->offset[gid] - 1,
+		       cstrings->offset[gid+1] - cstrings->offset[gid],
+		       cff->gsubr, cff->subrs[fd], 0.0, 0.0, &ginfo);
+  }
+
+  return cstrings->count;
+}
+
+static void
+bench_font (const char *filename)
+{
+  FILE      *fp;
+  sfnt      *sfont = NULL;
+  cff_font  *cff;
+  cff_index *cstrings = NULL;
+  long       glyphs = 0;
+  ULONG      offset;
+  clock_t    start;
+  int        type1;
+
+  fp = fopen(filename, "rb");
+  if (!fp) {
+    perror(filename);
+    return;
+  }
+
+  type1 = is_pfb(fp);
+  if (type1) {
+    cff = t1_load_font(NULL, 0, fp);
+  } else {
+    cff = NULL;
+    sfont = sfnt_open(fp);
+    if (sfont && sfnt_read_table_directory(sfont, 0) >= 0 &&
+	sfont->type == SFNT_TYPE_POSTSCRIPT &&
+	(offset = sfnt_find_table_pos(sfont, "CFF ")) != 0)
+      cff = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
+    if (cff) {
+      cff_read_charsets(cff);
+      if (cff->flag & FONTTYPE_CIDFONT) {
+	cff_read_fdselect(cff);
+	cff_read_fdarray(cff);
+      }
+      cff_read_private(cff);
+      cff_read_subrs(cff);
+      cff_seek_set(cff, (long) cff_dict_get(cff->topdict, "CharStrings", 0));
+      cstrings = cff_get_index(cff);
+    }
+  }
+  if (!cff) {
+    fprintf(stderr, "%s: Not a Type 1 or OpenType/CFF font.\n", filename);
+    if (sfont)
+      sfnt_close(sfont);
+    fclose(fp);
+    return;
+  }
+
+  start = clock();
+  do {
+    glyphs += type1 ? convert_type1(cff) : copy_type2(cff, cstrings);
+  } while (seconds(start) < BENCH_SECONDS);
+  printf("%-40s %-7s %8.0f glyphs/s\n", filename,
+	 type1 ? "convert" : "copy", glyphs / seconds(start));
+
+  if (cstrings)
+    cff_release_index(cstrings);
+  cff_close(cff);
+  if (sfont)
+    sfnt_close(sfont);
+  fclose(fp);
+}
+
+int main (int argc, char **argv)
+{
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s font.pfb font.otf ...\n", argv[0]);
+    return 1;
+  }
+  for (i = 1; i < argc; i++)
+    bench_font(argv[i]);
+
+  return 0;
+}
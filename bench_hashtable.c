@@ -0,0 +1,121 @@
+/* Benchmark for the texpdf_ht_* hash table: append, lookup (hits and
+   misses), iteration, removal and clearing with 1k, 100k and 1M keys,
+   or the given key counts.
+
+./bench_hashtable [keys...]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libtexpdf.h"
+
+#define KEY_SIZE 16
+
+static double
+seconds (clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void
+report (long count, const char *what, long ops, clock_t start)
+{
+  printf("%8ld keys %-8s %8.1f ns/op\n",
+         count, what, seconds(start) * 1e9 / ops);
+}
+
+static int
+make_key (char *key, const char *prefix, long i)
+{
+  return sprintf(key, "%s%lx", prefix, i * 2654435761UL & 0xffffffffUL);
+}
+
+static void
+bench_table (long count)
+{
+  struct ht_table ht;
+  struct ht_iter  iter;
+  char   *keys, *misses, *key;
+  int    *lens, *miss_lens;
+  long    i, n, found = 0;
+  clock_t start;
+
+  keys      = NEW(count * KEY_SIZE, char);
+  lens      = NEW(count, int);
+  misses    = NEW(count * KEY_SIZE, char);
+  miss_lens = NEW(count, int);
+  for (i = 0; i < count; i++) {
+    lens[i]      = make_key(keys + i * KEY_SIZE, "Font", i);
+    miss_lens[i] = make_key(misses + i * KEY_SIZE, "Form", i);
+  }
+
+  texpdf_ht_init_table(&ht, NULL);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    key = keys + i * KEY_SIZE;
+    texpdf_ht_append_table(&ht, key, lens[i], key);
+  }
+  report(count, "append", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    n = (i * 7919) % count;
+    if (texpdf_ht_lookup_table(&ht, keys + n * KEY_SIZE, lens[n]))
+      found++;
+  }
+  report(count, "hit", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    if (texpdf_ht_lookup_table(&ht, misses + i * KEY_SIZE, miss_lens[i]))
+      found++;
+  }
+  report(count, "miss", count, start);
+
+  start = clock();
+  if (ht_set_iter(&ht, &iter) >= 0) {
+    do {
+      if (ht_iter_getval(&iter))
+        found++;
+    } while (ht_iter_next(&iter) >= 0);
+    ht_clear_iter(&iter);
+  }
+  report(count, "iterate", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i += 2)
+    ht_remove_table(&ht, keys + i * KEY_SIZE, lens[i]);
+  report(count, "remove", (count + 1) / 2, start);
+
+  start = clock();
+  texpdf_ht_clear_table(&ht);
+  report(count, "clear", count, start);
+
+  if (found != 2 * count)
+    fprintf(stderr, "Found %ld entries, expected %ld.\n", found, 2 * count);
+
+  RELEASE(miss_lens);
+  RELEASE(misses);
+  RELEASE(lens);
+  RELEASE(keys);
+}
+
+int main (int argc, char **argv)
+{
+  int i;
+
+  if (argc > 1) {
+    for (i = 1; i < argc; i++)
+      bench_table(atol(argv[i]) > 0 ? atol(argv[i]) : 1);
+  } else {
+    bench_table(1000);
+    bench_table(100000);
+    bench_table(1000000);
+  }
+
+  return 0;
+}
@@ -0,0 +1,123 @@
+/* Benchmark for the page tree: writes a document with many pages, as a
+   balanced tree and as a streamed one, then reads it back and times
+   texpdf_doc_get_page() for the first, middle and last page.
+
+./bench_page_tree [pages] [cluster]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libtexpdf.h"
+
+#define LOOKUPS 2000
+
+static double
+seconds (clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void
+write_document (const char *filename, long num_pages, int cluster, int streaming)
+{
+  pdf_rect mediabox = {0, 0, 595, 842};
+  pdf_doc *p;
+  char     buf[64];
+  long     i;
+  clock_t  start;
+
+  p = texpdf_open_document(filename, 0, 595, 842, 0, 0, 0);
+  if (streaming)
+    texpdf_doc_enable_streaming_pages(p);
+  if (cluster > 0)
+    texpdf_doc_set_page_cluster(p, cluster);
+  texpdf_init_device(p, 1, 2, 0);
+  texpdf_doc_set_mediabox(p, 0, &mediabox);
+
+  start = clock();
+  for (i = 0; i < num_pages; i++) {
+    texpdf_doc_begin_page(p, 1.0, 72.0, 770.0);
+    sprintf(buf, "0 0 m %ld %ld l S", i % 500, i % 700);
+    texpdf_doc_add_page_content(p, buf, strlen(buf));
+    texpdf_doc_end_page(p);
+  }
+  texpdf_close_document(p);
+  texpdf_close_device();
+  printf("%-9s write %18.3f s\n",
+         streaming ? "streamed" : "balanced", seconds(start));
+}
+
+static void
+time_lookup (pdf_file *pf, const char *name, const char *what,
+             long page_no, int repeat)
+{
+  pdf_obj *page, *resources;
+  pdf_rect bbox;
+  clock_t  start;
+  int      i;
+
+  start = clock();
+  for (i = 0; i < repeat; i++) {
+    resources = NULL;
+    page = texpdf_doc_get_page(pf, page_no, NULL, &bbox, &resources);
+    if (!page) {
+      fprintf(stderr, "Cannot get page %ld.\n", page_no);
+      exit(1);
+    }
+    texpdf_release_obj(page);
+    if (resources)
+      texpdf_release_obj(resources);
+  }
+  printf("%-9s %-5s page %-7ld %10.2f us\n",
+         name, what, page_no, seconds(start) * 1e6 / repeat);
+}
+
+static void
+read_document (const char *filename, const char *name, long num_pages)
+{
+  pdf_file *pf;
+  FILE     *fp;
+
+  fp = fopen(filename, "rb");
+  if (!fp) {
+    perror(filename);
+    exit(1);
+  }
+  pf = texpdf_open(filename, fp);
+  if (!pf) {
+    fprintf(stderr, "Cannot open %s.\n", filename);
+    exit(1);
+  }
+  /* The first lookup is timed on its own. */
+  time_lookup(pf, name, "first", num_pages, 1);
+  time_lookup(pf, name, "next",  1, LOOKUPS);
+  time_lookup(pf, name, "next",  (num_pages + 1) / 2, LOOKUPS);
+  time_lookup(pf, name, "next",  num_pages, LOOKUPS);
+  texpdf_close(pf);
+  fclose(fp);
+}
+
+int main (int argc, char **argv)
+{
+  long num_pages = argc > 1 ? atol(argv[1]) : 20000;
+  int  cluster   = argc > 2 ? atoi(argv[2]) : 0;
+
+  if (num_pages < 1)
+    num_pages = 1;
+
+  write_document("bench_page_tree_balanced.pdf", num_pages, cluster, 0);
+  write_document("bench_page_tree_streamed.pdf", num_pages, cluster, 1);
+
+  texpdf_files_init();
+  read_document("bench_page_tree_balanced.pdf", "balanced", num_pages);
+  read_document("bench_page_tree_streamed.pdf", "streamed", num_pages);
+  texpdf_files_close();
+
+  remove("bench_page_tree_balanced.pdf");
+  remove("bench_page_tree_streamed.pdf");
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* Benchmark for the resource registry: defines many named resources
+   and looks them up again, by category name and by category ID.
+
+./bench_resources [count]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libtexpdf.h"
+
+static double
+seconds (clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void
+report (const char *what, long count, clock_t start)
+{
+  printf("%-24s %8.1f ns/op\n", what, seconds(start) * 1e9 / count);
+}
+
+int main (int argc, char **argv)
+{
+  long    count = argc > 1 ? atol(argv[1]) : 100000;
+  long    i, id, found = 0;
+  char    name[32];
+  clock_t start;
+
+  if (count < 1)
+    count = 1;
+
+  texpdf_set_compression(0);
+  pdf_out_init("/dev/null", 0);
+  texpdf_init_resources();
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "P%ld", i);
+    pdf_defineresource("Pattern", name, texpdf_new_dict(), 0);
+  }
+  report("define (by name)", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "X%ld", i);
+    pdf_defineresource_id(PDF_RESOURCE_XOBJECT, name, texpdf_new_dict(), 0);
+  }
+  report("define (by ID)", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "P%ld", (i * 7919) % count);
+    if (pdf_findresource("Pattern", name) >= 0)
+      found++;
+  }
+  report("find (by name)", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "X%ld", (i * 7919) % count);
+    if (pdf_findresource_id(PDF_RESOURCE_XOBJECT, name) >= 0)
+      found++;
+  }
+  report("find (by ID)", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "Q%ld", i);
+    if (pdf_findresource("Pattern", name) >= 0)
+      found++;
+  }
+  report("find (missing)", count, start);
+
+  start = clock();
+  for (i = 0; i < count; i++) {
+    sprintf(name, "P%ld", i);
+    id = pdf_findresource_id(PDF_RESOURCE_PATTERN, name);
+    texpdf_release_obj(texpdf_get_resource_reference(id));
+  }
+  report("reference", count, start);
+
+  start = clock();
+  texpdf_close_resources();
+  pdf_out_flush();
+  report("close and write", 2 * count, start);
+
+  if (found != 2 * count) {
+    fprintf(stderr, "Found %ld of %ld resources.\n", found, 2 * count);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* Benchmark for string output: literal-string escaping and hex encoding
+   of Latin, CJK (UTF-16BE) and binary strings, both through the
+   pdfobj_escape_str()/pdfobj_hexencode_str() helpers and as string
+   objects written to a PDF file.
+
+./bench_strings [megabytes]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libtexpdf.h"
+
+#define SAMPLE_LEN 4096
+#define CHUNK      1023 /* input bytes per call; output fits in 4096 */
+
+static const char *latin_text =
+  "The quick brown fox (jumps) over the lazy dog; \\ and then some more "
+  "plain ASCII text with numbers 0123456789 and punctuation, too. ";
+
+static void
+fill_latin (unsigned char *s, int len)
+{
+  int i, n = strlen(latin_text);
+
+  for (i = 0; i < len; i++)
+    s[i] = latin_text[i % n];
+}
+
+static void
+fill_cjk (unsigned char *s, int len)
+{
+  int i;
+
+  /* UTF-16BE code units from the CJK Unified Ideographs block */
+  for (i = 0; i + 1 < len; i += 2) {
+    unsigned code = 0x4E00 + (rand() % 0x5200);
+    s[i]   = code >> 8;
+    s[i+1] = code & 0xff;
+  }
+}
+
+static void
+fill_binary (unsigned char *s, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    s[i] = rand() & 0xff;
+}
+
+static double
+seconds (clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void
+bench_helpers (const char *name, const unsigned char *s, long total)
+{
+  char    buf[4096];
+  long    done;
+  int     i, n;
+  clock_t start;
+  volatile int sink = 0;
+
+  start = clock();
+  for (done = 0; done < total; done += SAMPLE_LEN) {
+    for (i = 0; i < SAMPLE_LEN; i += CHUNK) {
+      n = SAMPLE_LEN - i < CHUNK ? SAMPLE_LEN - i : CHUNK;
+      sink += pdfobj_escape_str(buf, sizeof(buf), s + i, n);
+    }
+  }
+  printf("%-8s escape    %8.1f MB/s\n", name, total / 1e6 / seconds(start));
+
+  start = clock();
+  for (done = 0; done < total; done += SAMPLE_LEN) {
+    for (i = 0; i < SAMPLE_LEN; i += CHUNK) {
+      n = SAMPLE_LEN - i < CHUNK ? SAMPLE_LEN - i : CHUNK;
+      sink += pdfobj_hexencode_str(buf, sizeof(buf), s + i, n);
+    }
+  }
+  printf("%-8s hexencode %8.1f MB/s\n", name, total / 1e6 / seconds(start));
+}
+
+/* Strings of 64 bytes, as found in text and annotations, written out. */
+static void
+bench_objects (const char *name, const unsigned char *s, long total)
+{
+  pdf_obj *array = NULL;
+  long     done;
+  int      i;
+  clock_t  start;
+
+  texpdf_set_compression(0);
+  pdf_out_init("/dev/null", 0);
+  start = clock();
+  for (done = 0, i = 0; done < total; done += 64, i++) {
+    if (!array)
+      array = texpdf_new_array();
+    texpdf_add_array(array, texpdf_new_string(s + (done % (SAMPLE_LEN - 64)), 64));
+    if (i % 1024 == 1023) {
+      texpdf_release_obj(texpdf_ref_obj(array));
+      texpdf_release_obj(array);
+      array = NULL;
+    }
+  }
+  if (array) {
+    texpdf_release_obj(texpdf_ref_obj(array));
+    texpdf_release_obj(array);
+  }
+  pdf_out_flush();
+  printf("%-8s objects   %8.1f MB/s\n", name, total / 1e6 / seconds(start));
+}
+
+int main (int argc, char **argv)
+{
+  static unsigned char latin[SAMPLE_LEN], cjk[SAMPLE_LEN], binary[SAMPLE_LEN];
+  long total = (argc > 1 ? atol(argv[1]) : 64) * 1000000L;
+
+  srand(1);
+  fill_latin(latin, SAMPLE_LEN);
+  fill_cjk(cjk, SAMPLE_LEN);
+  fill_binary(binary, SAMPLE_LEN);
+
+  bench_helpers("Latin",  latin,  total);
+  bench_helpers("CJK",    cjk,    total);
+  bench_helpers("binary", binary, total);
+
+  bench_objects("Latin",  latin,  total / 4);
+  bench_objects("CJK",    cjk,    total / 4);
+  bench_objects("binary", binary, total / 4);
+
+  return 0;
+}
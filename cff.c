@@ -39,22 +39,94 @@
 #define CFF_DEBUG     5
 #define CFF_DEBUG_STR "CFF"
 
-static unsigned long get_unsigned (FILE *stream, int n)
+/*
+ * Font data is read from memory: either the caller's buffer (e.g. the
+ * mapped sfnt file) or a copy read in once by cff_open().
+ */
+static unsigned long get_unsigned (cff_font *cff, int n)
 {
+  const card8  *p;
   unsigned long v = 0;
 
+  if (cff->pos > cff->size || n > cff->size - cff->pos)
+    ERROR("%s: Unexpected end of font data.", CFF_DEBUG_STR);
+
+  p = cff->buffer + cff->pos;
+  cff->pos += n;
   while (n-- > 0)
-    v = v*0x100u + get_unsigned_byte(stream);
+    v = v*0x100u + *p++;
 
   return v;
 }
 
-#define get_offset(s, n) get_unsigned((s), (n))
+#define get_card8(c)     ((card8)  get_unsigned((c), 1))
+#define get_card16(c)    ((card16) get_unsigned((c), 2))
+#define get_offset(c, n) get_unsigned((c), (n))
+
+/* Returns a pointer to size bytes at the current position and skips them. */
+static card8 *
+get_data (cff_font *cff, long size)
+{
+  card8 *data;
+
+  if (size < 0 || cff->pos > cff->size || size > cff->size - cff->pos)
+    ERROR("%s: Unexpected end of font data.", CFF_DEBUG_STR);
+
+  data = cff->buffer + cff->pos;
+  cff->pos += size;
+
+  return data;
+}
+
+long
+cff_read_bytes (card8 *dest, long len, cff_font *cff)
+{
+  if (cff->pos >= cff->size)
+    return 0;
+  if (len > cff->size - cff->pos)
+    len = cff->size - cff->pos;
+
+  memcpy(dest, cff->buffer + cff->pos, len);
+  cff->pos += len;
+
+  return len;
+}
 
 /*
- * Read Header, Name INDEX, Top DICT INDEX, and String INDEX.
+ * Read the whole font file into memory and parse the CFF data at offset.
  */
 cff_font *cff_open(FILE *stream, long offset, int n)
+{
+  cff_font *cff;
+  card8    *buffer;
+  long      size;
+
+  size = file_size(stream);
+  if (size <= 0)
+    return NULL;
+  buffer = NEW(size, card8);
+  rewind(stream);
+  if (fread(buffer, 1, size, stream) != (size_t) size) {
+    RELEASE(buffer);
+    ERROR("%s: Reading font file failed.", CFF_DEBUG_STR);
+  }
+
+  cff = cff_open_buffer(buffer, size, offset, n);
+  if (cff)
+    cff->buffer_owned = 1;
+  else
+    RELEASE(buffer);
+
+  return cff;
+}
+
+/*
+ * Read Header, Name INDEX, Top DICT INDEX, and String INDEX.
+ *
+ * The CFF data starts at offset within buffer, which must remain valid
+ * until cff_close(): INDEX data read from it is not copied.
+ */
+cff_font *cff_open_buffer(card8 *buffer, long size, long offset, int n)
 {
   cff_font  *cff;
   cff_index *idx;
@@ -63,7 +135,10 @@ cff_font *cff_open(FILE *stream, long offset, int n)
 
   cff->fontname = NULL;
   cff->index    = n;
-  cff->stream   = stream;
+  cff->buffer   = buffer;
+  cff->size     = size;
+  cff->pos      = 0;
+  cff->buffer_owned = 0;
   cff->offset   = offset;
   cff->filter   = 0;      /* not used */
   cff->flag     = 0;
@@ -85,10 +160,10 @@ cff_font *cff_open(FILE *stream, long offset, int n)
   cff->_string    = NULL;
 
   cff_seek_set(cff, 0);
-  cff->header.major    = get_unsigned_byte(cff->stream);
-  cff->header.minor    = get_unsigned_byte(cff->stream);
-  cff->header.hdr_size = get_unsigned_byte(cff->stream);
-  cff->header.offsize  = get_unsigned_byte(cff->stream);
+  cff->header.major    = get_card8(cff);
+  cff->header.minor    = get_card8(cff);
+  cff->header.hdr_size = get_card8(cff);
+  cff->header.offsize  = get_card8(cff);
   if (cff->header.offsize < 1 ||
       cff->header.offsize > 4)
     ERROR("invalid offsize data");
@@ -142,12 +217,12 @@ cff_font *cff_open(FILE *stream, long offset, int n)
   cff->string = cff_get_index(cff);
 
   /* offset to GSubr */
-  cff->gsubr_offset = tell_position(cff->stream) - offset;
+  cff->gsubr_offset = cff_tell(cff) - offset;
 
   /* Number of glyphs */
   offset = (long) cff_dict_get(cff->topdict, "CharStrings", 0);
   cff_seek_set(cff, offset);
-  cff->num_glyphs = get_unsigned_pair(cff->stream);
+  cff->num_glyphs = get_card16(cff);
 
   /* Check for font type */
   if (cff_dict_known(cff->topdict, "ROS")) {
@@ -222,6 +297,8 @@ cff_close (cff_font *cff)
     }
     if (cff->_string)
       cff_release_index(cff->_string);
+    if (cff->buffer_owned)
+      RELEASE(cff->buffer);
 
     RELEASE(cff);
   }
@@ -257,6 +334,7 @@ cff_set_name (cff_font *cff, char *name)
     cff_release_index(cff->name);
 
   cff->name = idx = NEW(1, cff_index);
+  idx->shared  = 0;
   idx->count   = 1;
   idx->offsize = 1;
   idx->offset  = NEW(2, l_offset);
@@ -294,21 +372,22 @@ cff_get_index_header (cff_font *cff)
   card16     i, count;
 
   idx = NEW(1, cff_index);
+  idx->shared = 0;
 
-  idx->count = count = get_unsigned_pair(cff->stream);
+  idx->count = count = get_card16(cff);
   if (count > 0) {
-    idx->offsize = get_unsigned_byte(cff->stream);
+    idx->offsize = get_card8(cff);
     if (idx->offsize < 1 || idx->offsize > 4)
       ERROR("invalid offsize data");
 
     idx->offset = NEW(count+1, l_offset);
     for (i=0;i<count;i++) {
-      (idx->offset)[i] = get_offset(cff->stream, idx->offsize);
+      (idx->offset)[i] = get_offset(cff, idx->offsize);
     }
     if (count == 0xFFFF)
       cff_seek(cff, cff_tell(cff) + idx->offsize);
     else
-      (idx->offset)[i] = get_offset(cff->stream, idx->offsize);
+      (idx->offset)[i] = get_offset(cff, idx->offsize);
 
     if (idx->offset[0] != 1)
       ERROR("cff_get_index(): invalid index data");
@@ -323,24 +402,96 @@ cff_get_index_header (cff_font *cff)
   return idx;
 }
 
+static l_offset
+lazy_index_offset (cff_lazy_index *idx, long i)
+{
+  const card8 *p = idx->offset + i * idx->offsize;
+  l_offset     v = 0;
+  int          n;
+
+  for (n = 0; n < idx->offsize; n++)
+    v = v*0x100u + p[n];
+
+  return v;
+}
+
+/*
+ * Locate an INDEX without decoding its offset array; entries are looked
+ * up with cff_lazy_index_get(). The font data must outlive the index.
+ */
+cff_lazy_index *
+cff_get_lazy_index (cff_font *cff)
+{
+  cff_lazy_index *idx;
+
+  idx = NEW(1, cff_lazy_index);
+
+  idx->count = get_card16(cff);
+  if (idx->count > 0) {
+    idx->offsize = get_card8(cff);
+    if (idx->offsize < 1 || idx->offsize > 4)
+      ERROR("invalid offsize data");
+
+    idx->offset = get_data(cff, (long) idx->offsize * (idx->count + 1));
+    if (lazy_index_offset(idx, 0) != 1)
+      ERROR("cff_get_lazy_index(): invalid index data");
+    idx->datalen = lazy_index_offset(idx, idx->count) - 1;
+    idx->data    = get_data(cff, idx->datalen);
+  } else {
+    idx->offsize = 0;
+    idx->offset  = NULL;
+    idx->data    = NULL;
+    idx->datalen = 0;
+  }
+
+  return idx;
+}
+
+/* Returns a pointer to entry i within the font data and its size. */
+card8 *
+cff_lazy_index_get (cff_lazy_index *idx, card16 i, long *size)
+{
+  l_offset start, end;
+
+  if (i >= idx->count)
+    ERROR("%s: Invalid INDEX entry %u.", CFF_DEBUG_STR, i);
+
+  start = lazy_index_offset(idx, i);
+  end   = lazy_index_offset(idx, i + 1);
+  if (start < 1 || end < start || end - 1 > idx->datalen)
+    ERROR("%s: Invalid INDEX offset data.", CFF_DEBUG_STR);
+
+  *size = end - start;
+
+  return idx->data + start - 1;
+}
+
+void
+cff_release_lazy_index (cff_lazy_index *idx)
+{
+  if (idx)
+    RELEASE(idx);
+}
+
 cff_index *
 cff_get_index (cff_font *cff)
 {
   cff_index *idx;
   card16     i, count;
-  long       length, nb_read, offset;
+  long       length;
 
   idx = NEW(1, cff_index);
+  idx->shared = 0;
 
-  idx->count = count = get_unsigned_pair(cff->stream);
+  idx->count = count = get_card16(cff);
   if (count > 0) {
-    idx->offsize = get_unsigned_byte(cff->stream);
+    idx->offsize = get_card8(cff);
     if (idx->offsize < 1 || idx->offsize > 4)
       ERROR("invalid offsize data");
 
     idx->offset = NEW(count + 1, l_offset);
     for (i = 0 ; i < count + 1; i++) {
-      idx->offset[i] = get_offset(cff->stream, idx->offsize);
+      idx->offset[i] = get_offset(cff, idx->offsize);
     }
 
     if (idx->offset[0] != 1)
@@ -348,13 +499,9 @@ cff_get_index (cff_font *cff)
 
     length = idx->offset[count] - idx->offset[0];
 
-    idx->data = NEW(length, card8);
-    offset    = 0;
-    while (length > 0) {
-      nb_read = cff_read_data(idx->data + offset, length, cff);
-      offset += nb_read;
-      length -= nb_read;
-    }
+    /* Data is a slice of the font buffer. */
+    idx->data   = get_data(cff, length);
+    idx->shared = 1;
   } else {
     idx->offsize = 0;
     idx->offset  = NULL;
@@ -454,6 +601,7 @@ cff_index *cff_new_index (card16 count)
   idx = NEW(1, cff_index);
   idx->count = count;
   idx->offsize = 0;
+  idx->shared = 0;
 
   if (count > 0) {
     idx->offset = NEW(count + 1, l_offset);
@@ -469,7 +617,7 @@ cff_index *cff_new_index (card16 count)
 void cff_release_index (cff_index *idx)
 {
   if (idx) {
-    if (idx->data) {
+    if (idx->data && !idx->shared) {
       RELEASE(idx->data);
     }
     if (idx->offset) {
@@ -650,27 +798,27 @@ long cff_read_encoding (cff_font *cff)
 
   cff_seek_set(cff, offset);
   cff->encoding = encoding = NEW(1, cff_encoding);
-  encoding->format = get_unsigned_byte(cff->stream);
+  encoding->format = get_card8(cff);
   length = 1;
 
   switch (encoding->format & (~0x80)) {
   case 0:
-    encoding->num_entries = get_unsigned_byte(cff->stream);
+    encoding->num_entries = get_card8(cff);
     (encoding->data).codes = NEW(encoding->num_entries, card8);
     for (i=0;i<(encoding->num_entries);i++) {
-      (encoding->data).codes[i] = get_unsigned_byte(cff->stream);
+      (encoding->data).codes[i] = get_card8(cff);
     }
     length += encoding->num_entries + 1;
     break;
   case 1:
     {
       cff_range1 *ranges;
-      encoding->num_entries = get_unsigned_byte(cff->stream);
+      encoding->num_entries = get_card8(cff);
       encoding->data.range1 = ranges
 	= NEW(encoding->num_entries, cff_range1);
       for (i=0;i<(encoding->num_entries);i++) {
-	ranges[i].first = get_unsigned_byte(cff->stream);
-	ranges[i].n_left = get_unsigned_byte(cff->stream);
+	ranges[i].first = get_card8(cff);
+	ranges[i].n_left = get_card8(cff);
       }
       length += (encoding->num_entries) * 2 + 1;
     }
@@ -684,11 +832,11 @@ long cff_read_encoding (cff_font *cff)
   /* Supplementary data */
   if ((encoding->format) & 0x80) {
     cff_map *map;
-    encoding->num_supps = get_unsigned_byte(cff->stream);
+    encoding->num_supps = get_card8(cff);
     encoding->supp = map = NEW(encoding->num_supps, cff_map);
     for (i=0;i<(encoding->num_supps);i++) {
-      map[i].code = get_unsigned_byte(cff->stream);
-      map[i].glyph = get_unsigned_pair(cff->stream); /* SID */
+      map[i].code = get_card8(cff);
+      map[i].glyph = get_card16(cff); /* SID */
     }
     length += (encoding->num_supps) * 3 + 1;
   } else {
@@ -866,7 +1014,7 @@ long cff_read_charsets (cff_font *cff)
 
   cff_seek_set(cff, offset);
   cff->charsets = charset = NEW(1, cff_charsets);
-  charset->format = get_unsigned_byte(cff->stream);
+  charset->format = get_card8(cff);
   charset->num_entries = 0;
 
   count = cff->num_glyphs - 1;
@@ -879,7 +1027,7 @@ long cff_read_charsets (cff_font *cff)
     charset->data.glyphs = NEW(charset->num_entries, s_SID);
     length += (charset->num_entries) * 2;
     for (i=0;i<(charset->num_entries);i++) {
-      charset->data.glyphs[i] = get_unsigned_pair(cff->stream);
+      charset->data.glyphs[i] = get_card16(cff);
     }
     count = 0;
     break;
@@ -888,8 +1036,8 @@ long cff_read_charsets (cff_font *cff)
       cff_range1 *ranges = NULL;
       while (count > 0 && charset->num_entries < cff->num_glyphs) {
 	ranges = RENEW(ranges, charset->num_entries + 1, cff_range1);
-	ranges[charset->num_entries].first = get_unsigned_pair(cff->stream);
-	ranges[charset->num_entries].n_left = get_unsigned_byte(cff->stream);
+	ranges[charset->num_entries].first = get_card16(cff);
+	ranges[charset->num_entries].n_left = get_card8(cff);
 	count -= ranges[charset->num_entries].n_left + 1; /* no-overrap */
 	charset->num_entries += 1;
 	charset->data.range1 = ranges;
@@ -902,8 +1050,8 @@ long cff_read_charsets (cff_font *cff)
       cff_range2 *ranges = NULL;
       while (count > 0 && charset->num_entries < cff->num_glyphs) {
 	ranges = RENEW(ranges, charset->num_entries + 1, cff_range2);
-	ranges[charset->num_entries].first = get_unsigned_pair(cff->stream);
-	ranges[charset->num_entries].n_left = get_unsigned_pair(cff->stream);
+	ranges[charset->num_entries].first = get_card16(cff);
+	ranges[charset->num_entries].n_left = get_card16(cff);
 	count -= ranges[charset->num_entries].n_left + 1; /* non-overrapping */
 	charset->num_entries += 1;
       }
@@ -1207,7 +1355,7 @@ long cff_read_fdselect (cff_font *cff)
   offset = (long) cff_dict_get(cff->topdict, "FDSelect", 0);
   cff_seek_set(cff, offset);
   cff->fdselect = fdsel = NEW(1, cff_fdselect);
-  fdsel->format = get_unsigned_byte(cff->stream);
+  fdsel->format = get_card8(cff);
 
   length = 1;
 
@@ -1216,22 +1364,22 @@ long cff_read_fdselect (cff_font *cff)
     fdsel->num_entries = cff->num_glyphs;
     (fdsel->data).fds = NEW(fdsel->num_entries, card8);
     for (i=0;i<(fdsel->num_entries);i++) {
-      (fdsel->data).fds[i] = get_unsigned_byte(cff->stream);
+      (fdsel->data).fds[i] = get_card8(cff);
     }
     length += fdsel->num_entries;
     break;
   case 3:
     {
       cff_range3 *ranges;
-      fdsel->num_entries = get_unsigned_pair(cff->stream);
+      fdsel->num_entries = get_card16(cff);
       fdsel->data.ranges = ranges = NEW(fdsel->num_entries, cff_range3);
       for (i=0;i<(fdsel->num_entries);i++) {
-	ranges[i].first = get_unsigned_pair(cff->stream);
-	ranges[i].fd = get_unsigned_byte(cff->stream);
+	ranges[i].first = get_card16(cff);
+	ranges[i].fd = get_card8(cff);
       }
       if (ranges[0].first != 0)
 	ERROR("Range not starting with 0.");
-      if (cff->num_glyphs != get_unsigned_pair(cff->stream))
+      if (cff->num_glyphs != get_card16(cff))
 	ERROR("Sentinel value mismatched with number of glyphs.");
       length += (fdsel->num_entries) * 3 + 4;
     }
@@ -1353,6 +1501,15 @@ card8 cff_fdselect_lookup (cff_font *cff, card16 gid)
 }
 
 long cff_read_subrs (cff_font *cff)
+{
+  return cff_read_used_subrs(cff, NULL);
+}
+
+/*
+ * Local Subrs of a CIDFont are read only for Font DICTs with a non-zero
+ * entry in used_fds, or for all of them if used_fds is NULL.
+ */
+long cff_read_used_subrs (cff_font *cff, const char *used_fds)
 {
   long len = 0;
   long offset;
@@ -1373,7 +1530,8 @@ long cff_read_subrs (cff_font *cff)
   cff->subrs = NEW(cff->num_fds, cff_index *);
   if (cff->flag & FONTTYPE_CIDFONT) {
     for (i=0;i<cff->num_fds;i++) {
-      if (cff->private[i] == NULL ||
+      if ((used_fds && !used_fds[i]) ||
+	  cff->private[i] == NULL ||
 	  !cff_dict_known(cff->private[i], "Subrs")) {
 	(cff->subrs)[i] = NULL;
       } else {
@@ -1454,11 +1612,8 @@ long cff_read_private (cff_font *cff)
 	  > 0) {
 	offset = (long) cff_dict_get(cff->fdarray[i], "Private", 1);
 	cff_seek_set(cff, offset);
-	data = NEW(size, card8);
-	if (cff_read_data(data, size, cff) != size)
-	  ERROR("reading file failed");
+	data = get_data(cff, size);
 	(cff->private)[i] = cff_dict_unpack(data, data+size);
-	RELEASE(data);
 	len += size;
       } else {
 	(cff->private)[i] = NULL;
@@ -1471,11 +1626,8 @@ long cff_read_private (cff_font *cff)
 	(size = (long) cff_dict_get(cff->topdict, "Private", 0)) > 0) {
       offset = (long) cff_dict_get(cff->topdict, "Private", 1);
       cff_seek_set(cff, offset);
-      data = NEW(size, card8);
-      if (cff_read_data(data, size, cff) != size)
-	ERROR("reading file failed");
+      data = get_data(cff, size);
       cff->private[0] = cff_dict_unpack(data, data+size);
-      RELEASE(data);
       len += size;
     } else {
       (cff->private)[0] = NULL;
@@ -71,7 +71,11 @@ typedef struct
    */
   cff_index  *_string;
 
-  FILE         *stream;
+  /* Font data; owned if cff_open() read it from a file. */
+  card8        *buffer;
+  l_offset      size;
+  l_offset      pos;
+  int           buffer_owned;
 
   int           filter;   /* not used, ASCII Hex filter if needed */
 
@@ -79,11 +83,13 @@ typedef struct
   int           flag;     /* Flag: see above */
 } cff_font;
 
-extern cff_font *cff_open  (FILE *file, long offset, int idx);
-#define cff_seek_set(c, p) seek_absolute (((c)->stream), ((c)->offset) + (p));
-#define cff_read_data(d, l, c)   fread(d, 1, l, (c)->stream)
-#define cff_tell(c) ftell((c)->stream)
-#define cff_seek(c, p) seek_absolute((c)->stream, p)
+extern cff_font *cff_open        (FILE *file, long offset, int idx);
+extern cff_font *cff_open_buffer (card8 *buffer, long size, long offset, int idx);
+extern long      cff_read_bytes  (card8 *dest, long len, cff_font *cff);
+#define cff_seek_set(c, p) ((c)->pos = ((c)->offset) + (p))
+#define cff_read_data(d, l, c)   cff_read_bytes((d), (l), (c))
+#define cff_tell(c) ((c)->pos)
+#define cff_seek(c, p) ((c)->pos = (p))
 
 extern void      cff_close (cff_font *cff);
 
@@ -93,6 +99,10 @@ extern long cff_put_header (cff_font *cff, card8 *dest, long destlen);
 /* CFF INDEX */
 extern cff_index *cff_get_index        (cff_font *cff);
 extern cff_index *cff_get_index_header (cff_font *cff);
+extern cff_lazy_index *cff_get_lazy_index     (cff_font *cff);
+extern card8          *cff_lazy_index_get     (cff_lazy_index *idx, card16 i,
+                                               long *size);
+extern void            cff_release_lazy_index (cff_lazy_index *idx);
 extern void       cff_release_index    (cff_index *idx);
 extern cff_index *cff_new_index        (card16 count);
 extern long       cff_index_size       (cff_index *idx);
@@ -103,7 +113,9 @@ extern char *cff_get_name (cff_font *cff);
 extern long  cff_set_name (cff_font *cff, char *name);
 
 /* Global and Local Subrs INDEX */
-extern long  cff_read_subrs (cff_font *cff);
+extern long  cff_read_subrs      (cff_font *cff);
+/* Same, but only Local Subrs of the Font DICTs flagged in used_fds. */
+extern long  cff_read_used_subrs (cff_font *cff, const char *used_fds);
 
 /* Encoding */
 extern long   cff_read_encoding    (cff_font *cff);
@@ -53,8 +53,18 @@ typedef struct {
   c_offsize offsize; /* Offset array element size, 1-4    */
   l_offset  *offset; /* Offset array, count + 1 offsets   */
   card8     *data;   /* Object data                       */
+  int        shared; /* data points into the font buffer  */
 } cff_index;
 
+/* INDEX read in place: offsets are decoded only for entries accessed. */
+typedef struct {
+  card16    count;   /* number of objects stored in INDEX */
+  c_offsize offsize; /* Offset array element size, 1-4    */
+  card8    *offset;  /* Offset array within the font data */
+  card8    *data;    /* Object data within the font data  */
+  l_offset  datalen; /* Size of object data               */
+} cff_lazy_index;
+
 typedef struct {
   card8     major;    /* format major version (starting at 1) */
   card8     minor;    /* format minor version (starting at 0) */
@@ -578,7 +578,7 @@ CIDFont_type0_try_open (const char *name,
     return CID_OPEN_ERROR_NO_CFF_TABLE;
   }
 
-  info->cffont = cff_open(info->sfont->stream, offset, 0);
+  info->cffont = cff_open_buffer(info->sfont->buffer, info->sfont->size, offset, 0);
   if (!info->cffont)
     return CID_OPEN_ERROR_CANNOT_OPEN_CFF_FONT;
 
@@ -611,7 +611,8 @@ void
 CIDFont_type0_dofont (CIDFont *font)
 {
   cff_font *cffont;
-  cff_index    *charstrings, *idx;
+  cff_index    *charstrings;
+  cff_lazy_index *idx;
   cff_charsets *charset = NULL;
   cff_fdselect *fdselect = NULL;
   long   charstring_len, max_len;
@@ -622,7 +623,7 @@ CIDFont_type0_dofont (CIDFont *font)
   long cid;
   card16 cs_count, last_cid = 0;
   int    fd, prev_fd;
-  char  *used_chars;
+  char  *used_chars, *used_fds;
   unsigned char *CIDToGIDMap = NULL;
   CIDType0Error error;
   CIDType0Info info;
@@ -678,19 +679,18 @@ CIDFont_type0_dofont (CIDFont *font)
     CIDToGIDMap = NEW(2 * cid_count, unsigned char);
     memset(CIDToGIDMap, 0, 2 * cid_count);
     add_to_used_chars2(used_chars, 0); /* .notdef */
-    for (cid = 0; cid <= CID_MAX; cid++) {
-      if (is_used_char2(used_chars, cid)) {
-        gid = cff_charsets_lookup(cffont, (card16)cid);
-        if (cid != 0 && gid == 0) {
-          WARN("Glyph for CID %u missing in font \"%s\".", (CID) cid, font->ident);
-          used_chars[cid/8] &= ~(1 << (7 - (cid % 8)));
-          continue;
-        }
-        CIDToGIDMap[2*cid]   = (gid >> 8) & 0xff;
-        CIDToGIDMap[2*cid+1] = gid & 0xff;
-        last_cid = cid;
-        num_glyphs++;
+    for (cid = used_chars2_next(used_chars, 0); cid >= 0;
+         cid = used_chars2_next(used_chars, cid + 1)) {
+      gid = cff_charsets_lookup(cffont, (card16)cid);
+      if (cid != 0 && gid == 0) {
+        WARN("Glyph for CID %u missing in font \"%s\".", (CID) cid, font->ident);
+        used_chars[cid/8] &= ~(1 << (7 - (cid % 8)));
+        continue;
       }
+      CIDToGIDMap[2*cid]   = (gid >> 8) & 0xff;
+      CIDToGIDMap[2*cid+1] = gid & 0xff;
+      last_cid = cid;
+      num_glyphs++;
     }
 
     add_CIDMetrics(info.sfont, font->fontdict, CIDToGIDMap, last_cid,
@@ -711,13 +711,21 @@ CIDFont_type0_dofont (CIDFont *font)
   cff_read_fdarray(cffont);
   cff_read_private(cffont);
 
-  cff_read_subrs(cffont);
+  /* Local Subrs are read only for Font DICTs used by the subset. */
+  used_fds = NEW(cffont->num_fds, char);
+  memset(used_fds, 0, cffont->num_fds);
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
+    gid = (CIDToGIDMap[2*cid] << 8)|(CIDToGIDMap[2*cid+1]);
+    used_fds[cff_fdselect_lookup(cffont, gid)] = 1;
+  }
+  cff_read_used_subrs(cffont, used_fds);
+  RELEASE(used_fds);
 
+  /* Charstrings are located one by one in the font data. */
   offset = (long) cff_dict_get(cffont->topdict, "CharStrings", 0);
   cff_seek_set(cffont, offset);
-  idx = cff_get_index_header(cffont);
-  /* offset is now absolute offset ... bad */
-  offset = cff_tell(cffont);
+  idx = cff_get_lazy_index(cffont);
   
   if ((cs_count = idx->count) < 2) {
     ERROR("No valid charstring data found.");
@@ -745,24 +753,19 @@ CIDFont_type0_dofont (CIDFont *font)
    * TODO: Re-assign FD number.
    */
   prev_fd = -1; gid = 0;
-  data = NEW(CS_STR_LEN_MAX, card8);
-  for (cid = 0; cid <= last_cid; cid++) {
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
     unsigned short gid_org;
 
-    if (!is_used_char2(used_chars, cid))
-      continue;
-
     gid_org = (CIDToGIDMap[2*cid] << 8)|(CIDToGIDMap[2*cid+1]);
-    if ((size = (idx->offset)[gid_org+1] - (idx->offset)[gid_org])
-        > CS_STR_LEN_MAX)
+    data = cff_lazy_index_get(idx, gid_org, &size);
+    if (size > CS_STR_LEN_MAX)
       ERROR("Charstring too long: gid=%u", gid_org);
     if (charstring_len + CS_STR_LEN_MAX >= max_len) {
       max_len = charstring_len + 2 * CS_STR_LEN_MAX;
       charstrings->data = RENEW(charstrings->data, max_len, card8);
     }
     (charstrings->offset)[gid] = charstring_len + 1;
-    cff_seek(cffont, offset + (idx->offset)[gid_org] - 1);
-    cff_read_data(data, size, cffont);
     fd = cff_fdselect_lookup(cffont, gid_org);
     charstring_len += cs_copy_charstring(charstrings->data + charstring_len,
                                          max_len - charstring_len,
@@ -782,8 +785,7 @@ CIDFont_type0_dofont (CIDFont *font)
   }
   if (gid != num_glyphs)
     ERROR("Unexpeced error: ?????");
-  RELEASE(data);
-  cff_release_index(idx);
+  cff_release_lazy_index(idx);
 
   RELEASE(CIDToGIDMap);
   
@@ -798,10 +800,10 @@ CIDFont_type0_dofont (CIDFont *font)
   cff_release_fdselect(cffont->fdselect);
   cffont->fdselect = fdselect;
 
-  /* no Global subr */
+  /* no Global subr unless subroutinized */
   if (cffont->gsubr)
     cff_release_index(cffont->gsubr);
-  cffont->gsubr = cff_new_index(0);
+  cffont->gsubr = cs_subroutinize(cffont->cstrings);
 
   for (fd = 0; fd < cffont->num_fds; fd++) {
     if (cffont->subrs && cffont->subrs[fd]) {
@@ -874,7 +876,7 @@ CIDFont_type0_open (CIDFont *font, const char *name,
       return -1;
     }
 
-    cffont = cff_open(sfont->stream, offset, 0);
+    cffont = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
     if (!cffont) {
       ERROR("Cannot read CFF font data");
     }
@@ -1045,7 +1047,8 @@ void
 CIDFont_type0_t1cdofont (CIDFont *font)
 {
   cff_font  *cffont;
-  cff_index *charstrings, *idx;
+  cff_index *charstrings;
+  cff_lazy_index *idx;
   long   charstring_len, max_len;
   long   destlen = 0;
   long   size, offset = 0;
@@ -1097,19 +1100,10 @@ CIDFont_type0_t1cdofont (CIDFont *font)
     nominal_width = CFF_NOMINALWIDTHX_DEFAULT;
   }
 
-  num_glyphs = 0; last_cid = 0;
   add_to_used_chars2(used_chars, 0); /* .notdef */
-  for (i = 0; i < (cffont->num_glyphs + 7)/8; i++) {
-    int c, j;
-
-    c = used_chars[i];
-    for (j = 7; j >= 0; j--) {
-      if (c & (1 << j)) {
-        num_glyphs++;
-        last_cid = (i + 1) * 8 - j - 1;
-      }
-    }
-  }
+  i = ((cffont->num_glyphs + 7) / 8) * 8 - 1;
+  num_glyphs = used_chars2_count(used_chars, i);
+  last_cid   = used_chars2_prev (used_chars, i);
 
   {
     cff_fdselect *fdselect;
@@ -1131,12 +1125,12 @@ CIDFont_type0_t1cdofont (CIDFont *font)
     charset->num_entries = num_glyphs-1;
     charset->data.glyphs = NEW(num_glyphs-1, s_SID);
 
-    for (gid = 0, cid = 0; cid <= last_cid; cid++) {
-      if (is_used_char2(used_chars, cid)) {
-        if (gid > 0)
-          charset->data.glyphs[gid-1] = cid;
-        gid++;
-      }
+    for (gid = 0, cid = used_chars2_next(used_chars, 0);
+         cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(used_chars, cid + 1)) {
+      if (gid > 0)
+        charset->data.glyphs[gid-1] = cid;
+      gid++;
     }
     /* cff_release_charsets(cffont->charsets); */
     cffont->charsets = charset;
@@ -1169,9 +1163,7 @@ CIDFont_type0_t1cdofont (CIDFont *font)
   /* */
   offset = (long) cff_dict_get(cffont->topdict, "CharStrings", 0);
   cff_seek_set(cffont, offset);
-  idx = cff_get_index_header(cffont);
-  /* offset is now absolute offset ... bad */
-  offset = cff_tell(cffont);
+  idx = cff_get_lazy_index(cffont);
 
   if (idx->count < 2)
     ERROR("No valid charstring data found.");
@@ -1183,21 +1175,17 @@ CIDFont_type0_t1cdofont (CIDFont *font)
   charstring_len = 0;
 
   gid  = 0;
-  data = NEW(CS_STR_LEN_MAX, card8);
-  for (cid = 0; cid <= last_cid; cid++) {
-    if (!is_used_char2(used_chars, cid))
-      continue;
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
 
-    if ((size = (idx->offset)[cid+1] - (idx->offset)[cid])
-        > CS_STR_LEN_MAX)
+    data = cff_lazy_index_get(idx, cid, &size);
+    if (size > CS_STR_LEN_MAX)
       ERROR("Charstring too long: gid=%u", cid);
     if (charstring_len + CS_STR_LEN_MAX >= max_len) {
       max_len = charstring_len + 2 * CS_STR_LEN_MAX;
       charstrings->data = RENEW(charstrings->data, max_len, card8);
     }
     (charstrings->offset)[gid] = charstring_len + 1;
-    cff_seek(cffont, offset + (idx->offset)[cid] - 1);
-    cff_read_data(data, size, cffont);
     charstring_len += cs_copy_charstring(charstrings->data + charstring_len,
                                          max_len - charstring_len,
                                          data, size,
@@ -1207,18 +1195,17 @@ CIDFont_type0_t1cdofont (CIDFont *font)
   }
   if (gid != num_glyphs)
     ERROR("Unexpeced error: ?????");
-  RELEASE(data);
-  cff_release_index(idx);
+  cff_release_lazy_index(idx);
 
   (charstrings->offset)[num_glyphs] = charstring_len + 1;
   charstrings->count = num_glyphs;
   cffont->num_glyphs    = num_glyphs;
   cffont->cstrings      = charstrings;
   
-  /* no Global subr */
+  /* no Global subr unless subroutinized */
   if (cffont->gsubr)
     cff_release_index(cffont->gsubr);
-  cffont->gsubr = cff_new_index(0);
+  cffont->gsubr = cs_subroutinize(cffont->cstrings);
 
   if (cffont->subrs && cffont->subrs[0]) {
     cff_release_index(cffont->subrs[0]);
@@ -1254,11 +1241,10 @@ CIDFont_type0_t1cdofont (CIDFont *font)
 
     CIDToGIDMap = NEW(2 * (last_cid+1), unsigned char);
     memset(CIDToGIDMap, 0, 2 * (last_cid + 1));
-    for (cid = 0; cid <= last_cid; cid++) {
-      if (is_used_char2(used_chars, cid)) {
-        CIDToGIDMap[2*cid  ] = (cid >> 8) & 0xff;
-        CIDToGIDMap[2*cid+1] = cid & 0xff;
-      }
+    for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(used_chars, cid + 1)) {
+      CIDToGIDMap[2*cid  ] = (cid >> 8) & 0xff;
+      CIDToGIDMap[2*cid+1] = cid & 0xff;
     }
     add_CIDMetrics(info.sfont, font->fontdict, CIDToGIDMap, last_cid,
                    ((CIDFont_get_parent_id(font, 1) < 0) ? 0 : 1));
@@ -1413,7 +1399,7 @@ create_ToUnicode_stream (cff_font *cffont,
 {
   pdf_obj *stream = NULL;
   CMap    *cmap;
-  CID      cid;
+  long     cid;
   card16   gid;
   long     glyph_count, total_fail_count;
   char    *cmap_name;
@@ -1443,31 +1429,31 @@ create_ToUnicode_stream (cff_font *cffont,
   glyph_count = total_fail_count = 0;
   p      = wbuf;
   endptr = wbuf + WBUF_SIZE;
-  for (cid = 1; cid < cffont->num_glyphs; cid++) { /* Skip .notdef */
-    if (is_used_char2(used_glyphs, cid)) {
-      char *glyph;
-      long  len;
-      int   fail_count;
-
-      wbuf[0] = (cid >> 8) & 0xff;
-      wbuf[1] = (cid & 0xff);
-
-      p = wbuf + 2;
-      gid = cff_charsets_lookup_inverse(cffont, cid);
-      if (gid == 0)
-        continue;
-      glyph = cff_get_string(cffont, gid);
-      if (glyph) {
-        len = agl_sput_UTF16BE(glyph, &p, endptr, &fail_count);
-        if (len < 1 || fail_count) {
-          total_fail_count += fail_count;
-        } else {
-          CMap_add_bfchar(cmap, wbuf, 2, wbuf+2, len);
-        }
-        RELEASE(glyph);
+  for (cid = used_chars2_next(used_glyphs, 1); /* Skip .notdef */
+       cid >= 0 && cid < cffont->num_glyphs;
+       cid = used_chars2_next(used_glyphs, cid + 1)) {
+    char *glyph;
+    long  len;
+    int   fail_count;
+
+    wbuf[0] = (cid >> 8) & 0xff;
+    wbuf[1] = (cid & 0xff);
+
+    p = wbuf + 2;
+    gid = cff_charsets_lookup_inverse(cffont, cid);
+    if (gid == 0)
+      continue;
+    glyph = cff_get_string(cffont, gid);
+    if (glyph) {
+      len = agl_sput_UTF16BE(glyph, &p, endptr, &fail_count);
+      if (len < 1 || fail_count) {
+        total_fail_count += fail_count;
+      } else {
+        CMap_add_bfchar(cmap, wbuf, 2, wbuf+2, len);
       }
-      glyph_count++;
+      RELEASE(glyph);
     }
+    glyph_count++;
   }
 
   if (total_fail_count != 0 &&
@@ -1643,7 +1629,8 @@ add_metrics (CIDFont *font, cff_font *cffont,
 {
   pdf_obj *tmp;
   double   val;
-  card16   cid, gid;
+  long     cid;
+  card16   gid;
   char    *used_chars;
   int      i, parent_id;
 
@@ -1678,14 +1665,13 @@ add_metrics (CIDFont *font, cff_font *cffont,
    * and to use "CID_start [ w0 w1 ...]".
    */
   tmp = texpdf_new_array();
-  for (cid = 0; cid <= last_cid; cid++) {
-    if (is_used_char2(used_chars, cid)) {
-      gid = (CIDToGIDMap[2*cid] << 8)|CIDToGIDMap[2*cid+1];
-      if (widths[gid] != default_width) {
-        texpdf_add_array(tmp, texpdf_new_number(cid));
-        texpdf_add_array(tmp, texpdf_new_number(cid));
-        texpdf_add_array(tmp, texpdf_new_number(ROUND(widths[gid], 1.0)));
-      }
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
+    gid = (CIDToGIDMap[2*cid] << 8)|CIDToGIDMap[2*cid+1];
+    if (widths[gid] != default_width) {
+      texpdf_add_array(tmp, texpdf_new_number(cid));
+      texpdf_add_array(tmp, texpdf_new_number(cid));
+      texpdf_add_array(tmp, texpdf_new_number(ROUND(widths[gid], 1.0)));
     }
   }
   texpdf_add_dict(font->fontdict,
@@ -1705,7 +1691,8 @@ CIDFont_type0_t1dofont (CIDFont *font)
   FILE     *fp;
   long      i, offset;
   char     *used_chars = NULL;
-  card16    last_cid, gid, cid;
+  card16    last_cid, gid;
+  long      cid;
   unsigned char *CIDToGIDMap;
 
   ASSERT(font);
@@ -1782,19 +1769,10 @@ CIDFont_type0_t1dofont (CIDFont *font)
     nominalwidth = 0.0;
   }
 
-  num_glyphs = 0; last_cid = 0;
   add_to_used_chars2(used_chars, 0); /* .notdef */
-  for (i = 0; i < (cffont->num_glyphs + 7)/8; i++) {
-    int c, j;
-
-    c = used_chars[i];
-    for (j = 7; j >= 0; j--) {
-      if (c & (1 << j)) {
-        num_glyphs++;
-        last_cid = (i + 1) * 8 - j - 1;
-      }
-    }
-  }
+  i = ((cffont->num_glyphs + 7) / 8) * 8 - 1;
+  num_glyphs = used_chars2_count(used_chars, i);
+  last_cid   = used_chars2_prev (used_chars, i);
 
   {
     cff_fdselect *fdselect;
@@ -1818,14 +1796,14 @@ CIDFont_type0_t1dofont (CIDFont *font)
     charset->num_entries = num_glyphs-1;
     charset->data.glyphs = NEW(num_glyphs-1, s_SID);
 
-    for (gid = 0, cid = 0; cid <= last_cid; cid++) {
-      if (is_used_char2(used_chars, cid)) {
-        if (gid > 0)
-          charset->data.glyphs[gid-1] = cid;
-        CIDToGIDMap[2*cid  ] = (gid >> 8) & 0xff;
-        CIDToGIDMap[2*cid+1] = gid & 0xff;
-        gid++;
-      }
+    for (gid = 0, cid = used_chars2_next(used_chars, 0);
+         cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(used_chars, cid + 1)) {
+      if (gid > 0)
+        charset->data.glyphs[gid-1] = cid;
+      CIDToGIDMap[2*cid  ] = (gid >> 8) & 0xff;
+      CIDToGIDMap[2*cid+1] = gid & 0xff;
+      gid++;
     }
 
     cff_release_charsets(cffont->charsets);
@@ -1871,9 +1849,8 @@ CIDFont_type0_t1dofont (CIDFont *font)
     cstring->data = NULL;
     cstring->offset[0] = 1;
     gid = 0;
-    for (cid = 0; cid <= last_cid; cid++) {
-      if (!is_used_char2(used_chars, cid))
-          continue;
+    for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(used_chars, cid + 1)) {
 
       if (offset + CS_STR_LEN_MAX >= max) {
         max += CS_STR_LEN_MAX*2;
@@ -1932,6 +1909,9 @@ CIDFont_type0_t1dofont (CIDFont *font)
                (double) cff_get_sid(cffont, "Identity"));
   cff_dict_set(cffont->topdict, "ROS", 2, 0.0);
 
+  cff_release_index(cffont->gsubr);
+  cffont->gsubr = cs_subroutinize(cffont->cstrings);
+
   cffont->num_glyphs = num_glyphs;
   offset = write_fontfile(font, cffont);
 
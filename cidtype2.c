@@ -236,12 +236,11 @@ add_TTCIDHMetrics (pdf_obj *fontdict, struct tt_glyphs *g,
   } else {
     dw = PDFUNIT(g->gd[0].advw);
   }
-  for (cid = 0; cid <= last_cid; cid++) {
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
     USHORT idx, gid;
     double width;
 
-    if (!is_used_char2(used_chars, cid))
-      continue;
     gid = (cidtogidmap) ? ((cidtogidmap[2*cid] << 8)|cidtogidmap[2*cid+1]) : cid;
     idx = tt_get_index(g, gid);
     if (cid != 0 && idx == 0)
@@ -307,15 +306,14 @@ add_TTCIDVMetrics (pdf_obj *fontdict, struct tt_glyphs *g,
   defaultAdvanceHeight = PDFUNIT(g->default_advh);
 
   w2_array = texpdf_new_array();
-  for (cid = 0; cid <= last_cid; cid++) {
+  for (cid = used_chars2_next(used_chars, 0); cid >= 0 && cid <= last_cid;
+       cid = used_chars2_next(used_chars, cid + 1)) {
     USHORT idx;
 #if 0
     USHORT gid;
 #endif
     double vertOriginX, vertOriginY, advanceHeight;
 
-    if (!is_used_char2(used_chars, cid))
-      continue;
 #if 0
     gid = (cidtogidmap) ? ((cidtogidmap[2*cid] << 8)|cidtogidmap[2*cid+1]) : cid;
 #endif
@@ -497,7 +495,8 @@ CIDFont_type2_dofont (CIDFont *font)
   CMap    *cmap = NULL;
   tt_cmap *ttcmap = NULL;
   unsigned long offset = 0;
-  CID      cid, last_cid;
+  CID      last_cid;
+  long     cid;
   unsigned char *cidtogidmap;
   USHORT   num_glyphs;
   int      i, glyph_ordering = 0, unicode_cmap = 0;
@@ -627,7 +626,7 @@ CIDFont_type2_dofont (CIDFont *font)
   used_chars = h_used_chars = v_used_chars = NULL;
   {
     Type0Font *parent;
-    int        parent_id, c;
+    int        parent_id;
 
     if ((parent_id = CIDFont_get_parent_id(font, 0)) >= 0) {
       parent = Type0Font_cache_get(parent_id);
@@ -643,26 +642,10 @@ CIDFont_type2_dofont (CIDFont *font)
     /*
      * Quick check of max CID.
      */
-    c = 0;
-    for (i = 8191; i >= 0; i--) {
-      if (h_used_chars && h_used_chars[i] != 0) {
-	last_cid = i * 8 + 7;
-	c = h_used_chars[i];
-	break;
-      }
-      if (v_used_chars && v_used_chars[i] != 0) {
-	last_cid = i * 8 + 7;
-	c = v_used_chars[i];
-	break;
-      }
-    }
-    if (last_cid > 0) {
-      for (i = 0; i < 8; i++) {
-	if ((c >> i) & 1)
-	  break;
-	last_cid--;
-      }
-    }
+    if (h_used_chars)
+      last_cid = MAX(last_cid, used_chars2_prev(h_used_chars, CID_MAX));
+    if (v_used_chars)
+      last_cid = MAX(last_cid, used_chars2_prev(v_used_chars, CID_MAX));
     if (last_cid >= 0xFFFFu) {
       ERROR("CID count > 65535");
     }
@@ -685,13 +668,11 @@ CIDFont_type2_dofont (CIDFont *font)
    */
   if (h_used_chars) {
     used_chars = h_used_chars;
-    for (cid = 1; cid <= last_cid; cid++) {
+    for (cid = used_chars2_next(h_used_chars, 1); cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(h_used_chars, cid + 1)) {
       long           code;
       unsigned short gid;
 
-      if (!is_used_char2(h_used_chars, cid))
-	continue;
-
       if (glyph_ordering) {
 	gid  = cid;
 	code = cid;
@@ -715,7 +696,7 @@ CIDFont_type2_dofont (CIDFont *font)
       }
 
       if (gid == 0) {
-	WARN("Glyph missing in font. (CID=%u, code=0x%04x)", cid, code);
+	WARN("Glyph missing in font. (CID=%u, code=0x%04x)", (CID) cid, code);
       }
 
       /* TODO: duplicated glyph */
@@ -759,13 +740,11 @@ CIDFont_type2_dofont (CIDFont *font)
       }
     }
 
-    for (cid = 1; cid <= last_cid; cid++) {
+    for (cid = used_chars2_next(v_used_chars, 1); cid >= 0 && cid <= last_cid;
+         cid = used_chars2_next(v_used_chars, cid + 1)) {
       long           code;
       unsigned short gid;
 
-      if (!is_used_char2(v_used_chars, cid))
-	continue;
-
       /* There may be conflict of horizontal and vertical glyphs
        * when font is used with /UCS. However, we simply ignore
        * that...
@@ -796,7 +775,7 @@ CIDFont_type2_dofont (CIDFont *font)
 #endif /* FIX_CJK_UNIOCDE_SYMBOLS */
       }
       if (gid == 0) {
-	WARN("Glyph missing in font. (CID=%u, code=0x%04x)", cid, code);
+	WARN("Glyph missing in font. (CID=%u, code=0x%04x)", (CID) cid, code);
       } else if (gsub_list) {
 	otl_gsub_apply(gsub_list, &gid);
       }
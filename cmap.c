@@ -75,6 +75,8 @@ static unsigned char *get_mem (CMap *cmap, int size);
 static mapDef *mapDef_new     (void);
 static void    mapDef_release (mapDef *t);
 static int     locate_tbl     (mapDef **cur, const unsigned char *code, int dim);
+static void    flat_build     (CMap *cmap);
+static void    flat_clear     (CMap *cmap);
 
 CMap *
 CMap_new (void)
@@ -109,6 +111,10 @@ CMap_new (void)
   cmap->reverseMap = NEW(65536, int);
   memset(cmap->reverseMap, 0, 65536 * sizeof(int));
 
+  cmap->flat.state = 0;
+  memset(cmap->flat.one, 0, sizeof(cmap->flat.one));
+  memset(cmap->flat.two, 0, sizeof(cmap->flat.two));
+
   return cmap;
 }
 
@@ -143,6 +149,8 @@ CMap_release (CMap *cmap)
   if (cmap->reverseMap)
     RELEASE(cmap->reverseMap);
 
+  flat_clear(cmap);
+
   RELEASE(cmap);
 }
 
@@ -259,6 +267,27 @@ CMap_decode_char (CMap *cmap,
   unsigned char c = 0;
   long    count = 0;
 
+  /* Fast path: defined CID or code mappings of 1- and 2-byte codes. */
+  if (cmap->flat.state == 0)
+    flat_build(cmap);
+  if (cmap->flat.state > 0 && *inbytesleft > 0) {
+    p = *inbuf;
+    if ((t = cmap->flat.one[p[0]]) != NULL)
+      count = 1;
+    else if (*inbytesleft > 1 && cmap->flat.two[p[0]] &&
+	     (t = cmap->flat.two[p[0]][p[1]]) != NULL)
+      count = 2;
+    if (t && *outbytesleft >= t->len) {
+      memcpy(*outbuf, t->code, t->len);
+      *outbuf       += t->len;
+      *outbytesleft -= t->len;
+      *inbuf        += count;
+      *inbytesleft  -= count;
+      return;
+    }
+    count = 0;
+  }
+
   p = save = *inbuf;
   /*
    * First handle some special cases:
@@ -489,6 +518,7 @@ CMap_set_usecmap (CMap *cmap, CMap *ucmap)
   }
 
   cmap->useCMap = ucmap;
+  flat_clear(cmap);
 }
 
 /* Test the validity of character c. */
@@ -525,6 +555,7 @@ CMap_add_codespacerange (CMap *cmap,
 
   ASSERT(cmap && dim > 0);
 
+  flat_clear(cmap);
   for (i = 0; i < cmap->codespace.num; i++) {
     int j, overlap = 1;
     csr = cmap->codespace.ranges + i;
@@ -788,6 +819,97 @@ locate_tbl (mapDef **cur, const unsigned char *code, int dim)
   return 0;
 }
 
+/*
+ * Find the mapping of the inlen byte code in this CMap or its useCMap
+ * parents, as CMap_decode_char() would. Returns the number of bytes
+ * consumed (0 if not defined anywhere), -1 if the code needs more
+ * than inlen bytes, or -2 if it must be left to the slow path.
+ */
+static int
+flat_resolve (CMap *cmap, const unsigned char *code, int inlen, mapDef **entry)
+{
+  mapDef *t;
+  int     count;
+  unsigned char c;
+
+  *entry = NULL;
+  for (; cmap; cmap = cmap->useCMap) {
+    if (cmap->type == CMAP_TYPE_IDENTITY)
+      return -2;
+    if (!cmap->mapTbl)
+      continue;
+
+    t = cmap->mapTbl;
+    for (count = 0; ; t = t[c].next) {
+      if (count == inlen)
+	return -1;
+      c = code[count++];
+      if (LOOKUP_END(t[c].flag))
+	break;
+    }
+    if (MAP_DEFINED(t[c].flag)) {
+      switch (MAP_TYPE(t[c].flag)) {
+      case MAP_IS_CID: case MAP_IS_CODE:
+	*entry = &t[c];
+	return count;
+      default: /* Leave warnings and errors to the slow path. */
+	return -2;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void
+flat_build (CMap *cmap)
+{
+  unsigned char code[2];
+  mapDef *entry;
+  int     c1, c2;
+
+  /* Longer codes are left out of the tables and take the slow path. */
+  if (cmap->type == CMAP_TYPE_IDENTITY) {
+    cmap->flat.state = -1;
+    return;
+  }
+
+  for (c1 = 0; c1 < 256; c1++) {
+    code[0] = c1;
+    switch (flat_resolve(cmap, code, 1, &entry)) {
+    case 1:
+      cmap->flat.one[c1] = entry;
+      break;
+    case -1:
+      cmap->flat.two[c1] = NEW(256, mapDef *);
+      for (c2 = 0; c2 < 256; c2++) {
+	code[1] = c2;
+	if (flat_resolve(cmap, code, 2, &entry) != 2)
+	  entry = NULL;
+	cmap->flat.two[c1][c2] = entry;
+      }
+      break;
+    }
+  }
+  cmap->flat.state = 1;
+}
+
+static void
+flat_clear (CMap *cmap)
+{
+  int c;
+
+  if (cmap->flat.state == 0)
+    return;
+  for (c = 0; c < 256; c++) {
+    cmap->flat.one[c] = NULL;
+    if (cmap->flat.two[c])
+      RELEASE(cmap->flat.two[c]);
+    cmap->flat.two[c] = NULL;
+  }
+  cmap->flat.state = 0;
+}
+
 /*
  * Guess how many bytes consumed as a `single' character:
  * Substring of length bytesconsumed bytes of input string is interpreted as
@@ -830,6 +952,8 @@ check_range (CMap *cmap,
 	     const unsigned char *srclo, const unsigned char *srchi, int srcdim,
 	     const unsigned char *dst, int dstdim)
 {
+  flat_clear(cmap);
+
   if ((srcdim < 1 || dstdim < 1) ||
       (!srclo || !srchi || !dst) ||
       memcmp(srclo, srchi, srcdim - 1) ||
@@ -865,6 +989,8 @@ struct CMap_cache {
   int    num;
   int    max;
   CMap **cmaps;
+
+  struct ht_table index; /* CMap name --> id */
 };
 
 static struct CMap_cache *__cache = NULL;
@@ -878,6 +1004,38 @@ static struct CMap_cache *__cache = NULL;
 
 #include "dpxfile.h"
 
+static void
+hval_free (void *hval)
+{
+  RELEASE(hval);
+}
+
+static int
+CMap_cache_lookup (const char *cmap_name)
+{
+  int *id;
+
+  id = texpdf_ht_lookup_table(&__cache->index, cmap_name, strlen(cmap_name));
+
+  return id ? *id : -1;
+}
+
+static void
+CMap_cache_register (const char *cmap_name, int id)
+{
+  int *value;
+
+  if (!cmap_name || CMap_cache_lookup(cmap_name) >= 0)
+    return;
+
+  value  = NEW(1, int);
+  *value = id;
+  texpdf_ht_append_table(&__cache->index, cmap_name, strlen(cmap_name), value);
+}
+
+static int CMap_cache_load_binary (CMap *cmap, const char *cmap_name, FILE *fp);
+static void CMap_cache_save_binary (CMap *cmap, const char *cmap_name, FILE *fp);
+
 void
 CMap_cache_init (void)
 {
@@ -892,6 +1050,7 @@ CMap_cache_init (void)
   __cache->max   = CMAP_CACHE_ALLOC_SIZE;
   __cache->cmaps = NEW(__cache->max, CMap *);
   __cache->num   = 0;
+  texpdf_ht_init_table(&__cache->index, hval_free);
 
   /* Create Identity mapping */
   __cache->cmaps[0] = CMap_new();
@@ -909,6 +1068,9 @@ CMap_cache_init (void)
   CMap_add_codespacerange(__cache->cmaps[1], range_min, range_max, 2);
 
   __cache->num += 2;
+
+  CMap_cache_register("Identity-H", 0);
+  CMap_cache_register("Identity-V", 1);
 }
 
 CMap *
@@ -928,14 +1090,9 @@ texpdf_CMap_cache_find (const char *cmap_name)
     CMap_cache_init();
   ASSERT(__cache);
 
-  for (id = 0; id < __cache->num; id++) {
-    char *name = NULL;
-    /* CMapName may be undefined when processing usecmap. */
-    name = CMap_get_name(__cache->cmaps[id]);
-    if (name && strcmp(cmap_name, name) == 0) {
-      return id;
-    }
-  }
+  id = CMap_cache_lookup(cmap_name);
+  if (id >= 0)
+    return id;
 
   fp = DPXFOPEN(cmap_name, DPX_RES_TYPE_CMAP);
   if (!fp)
@@ -956,9 +1113,15 @@ texpdf_CMap_cache_find (const char *cmap_name)
   id = __cache->num;
   (__cache->num)++;
   __cache->cmaps[id] = CMap_new();
+  /* Registered before parsing so that a self-referring usecmap is caught. */
+  CMap_cache_register(cmap_name, id);
 
-  if (CMap_parse(__cache->cmaps[id], fp) < 0)
-    ERROR("%s: Parsing CMap file failed.", CMAP_DEBUG_STR);
+  if (CMap_cache_load_binary(__cache->cmaps[id], cmap_name, fp) < 0) {
+    if (CMap_parse(__cache->cmaps[id], fp) < 0)
+      ERROR("%s: Parsing CMap file failed.", CMAP_DEBUG_STR);
+    CMap_cache_save_binary(__cache->cmaps[id], cmap_name, fp);
+  }
+  CMap_cache_register(CMap_get_name(__cache->cmaps[id]), id);
 
   DPXFCLOSE(fp);
 
@@ -972,19 +1135,16 @@ int
 CMap_cache_add (CMap *cmap)
 {
   int   id;
-  char *cmap_name0, *cmap_name1;
+  char *cmap_name0;
 
   if (!CMap_is_valid(cmap))
     ERROR("%s: Invalid CMap.", CMAP_DEBUG_STR);
 
-  for (id = 0; id < __cache->num; id++) {
-    cmap_name0 = CMap_get_name(cmap);
-    cmap_name1 = CMap_get_name(__cache->cmaps[id]);
-    if (!strcmp(cmap_name0, cmap_name1)) {
-      ERROR("%s: CMap \"%s\" already defined.",
-	    CMAP_DEBUG_STR, cmap_name0);
-      return -1;
-    }
+  cmap_name0 = CMap_get_name(cmap);
+  if (CMap_cache_lookup(cmap_name0) >= 0) {
+    ERROR("%s: CMap \"%s\" already defined.",
+	  CMAP_DEBUG_STR, cmap_name0);
+    return -1;
   }
 
   if (__cache->num >= __cache->max) {
@@ -994,6 +1154,7 @@ CMap_cache_add (CMap *cmap)
   id = __cache->num;
   (__cache->num)++;
   __cache->cmaps[id] = cmap;
+  CMap_cache_register(cmap_name0, id);
 
   return id;
 }
@@ -1007,7 +1168,435 @@ CMap_cache_close (void)
       CMap_release(__cache->cmaps[id]);
     }
     RELEASE(__cache->cmaps);
+    texpdf_ht_clear_table(&__cache->index);
     RELEASE(__cache);
     __cache = NULL;
   }
 }
+
+/************************** BINARY CMAP **************************/
+
+/*
+ * Precompiled CMaps: the mapping tables of a parsed CMap are written
+ * to <dir>/<name>.bcmap and read back on later runs instead of
+ * parsing the PostScript CMap file again. The source file size and
+ * modification time are recorded so that stale files are ignored.
+ * All numbers are big-endian.
+ */
+#include <sys/stat.h>
+
+#define BCMAP_MAGIC     "TPDFBCM1"
+#define BCMAP_MAGIC_LEN 8
+
+static char *bcmap_dir = NULL;
+
+void
+texpdf_CMap_set_cache_dir (const char *dir)
+{
+  if (bcmap_dir)
+    RELEASE(bcmap_dir);
+  bcmap_dir = NULL;
+  if (dir && dir[0]) {
+    bcmap_dir = NEW(strlen(dir)+1, char);
+    strcpy(bcmap_dir, dir);
+  }
+}
+
+static char *
+bcmap_filename (const char *cmap_name)
+{
+  char *filename;
+
+  if (!bcmap_dir || !cmap_name ||
+      strchr(cmap_name, '/') || strchr(cmap_name, '\\'))
+    return NULL;
+
+  filename = NEW(strlen(bcmap_dir) + strlen(cmap_name) + 8, char);
+  sprintf(filename, "%s/%s.bcmap", bcmap_dir, cmap_name);
+
+  return filename;
+}
+
+static int
+bcmap_source_stamp (FILE *fp, ULONG *size, ULONG *mtime)
+{
+  struct stat sb;
+
+  if (fstat(fileno(fp), &sb) != 0)
+    return -1;
+  *size  = (ULONG) sb.st_size;
+  *mtime = (ULONG) sb.st_mtime;
+
+  return 0;
+}
+
+static void
+bcmap_put (FILE *fp, ULONG value, int n)
+{
+  while (n-- > 0)
+    fputc((value >> (8 * n)) & 0xff, fp);
+}
+
+static void
+bcmap_put_string (FILE *fp, const char *str)
+{
+  int len = str ? strlen(str) : 0;
+
+  bcmap_put(fp, len, 2);
+  if (len > 0)
+    fwrite(str, 1, len, fp);
+}
+
+static ULONG
+bcmap_count_maps (mapDef *t)
+{
+  ULONG count = 0;
+  int   c;
+
+  for (c = 0; c < 256; c++) {
+    if (LOOKUP_CONTINUE(t[c].flag))
+      count += bcmap_count_maps(t[c].next);
+    else if (MAP_DEFINED(t[c].flag))
+      count++;
+  }
+
+  return count;
+}
+
+static void
+bcmap_put_maps (FILE *fp, mapDef *t, unsigned char *code, int dim)
+{
+  int c;
+
+  for (c = 0; c < 256; c++) {
+    code[dim] = c;
+    if (LOOKUP_CONTINUE(t[c].flag)) {
+      bcmap_put_maps(fp, t[c].next, code, dim + 1);
+    } else if (MAP_DEFINED(t[c].flag)) {
+      bcmap_put(fp, dim + 1, 1);
+      fwrite(code, 1, dim + 1, fp);
+      bcmap_put(fp, MAP_TYPE(t[c].flag), 1);
+      bcmap_put(fp, t[c].len, 2);
+      fwrite(t[c].code, 1, t[c].len, fp);
+    }
+  }
+}
+
+static void
+CMap_cache_save_binary (CMap *cmap, const char *cmap_name, FILE *src)
+{
+  char  *filename, *tmpname;
+  FILE  *fp;
+  ULONG  size, mtime, count;
+  unsigned char code[256];
+  long   cid;
+  int    i;
+
+  filename = bcmap_filename(cmap_name);
+  if (!filename)
+    return;
+  if (bcmap_source_stamp(src, &size, &mtime) < 0) {
+    RELEASE(filename);
+    return;
+  }
+
+  /* Written under a temporary name and renamed, so readers never see a partial file. */
+  fp = dpx_open_temp_file(filename, &tmpname);
+  if (!fp) {
+    RELEASE(filename);
+    return;
+  }
+
+  fwrite(BCMAP_MAGIC, 1, BCMAP_MAGIC_LEN, fp);
+  bcmap_put(fp, size,  4);
+  bcmap_put(fp, mtime, 4);
+
+  bcmap_put_string(fp, cmap->name);
+  bcmap_put_string(fp, cmap->useCMap ? cmap->useCMap->name : NULL);
+  bcmap_put_string(fp, cmap->CSI ? cmap->CSI->registry : NULL);
+  bcmap_put_string(fp, cmap->CSI ? cmap->CSI->ordering : NULL);
+  bcmap_put(fp, cmap->CSI ? cmap->CSI->supplement : 0, 4);
+  bcmap_put(fp, cmap->type,  1);
+  bcmap_put(fp, cmap->wmode, 1);
+  bcmap_put(fp, cmap->profile.minBytesIn,  1);
+  bcmap_put(fp, cmap->profile.maxBytesIn,  1);
+  bcmap_put(fp, cmap->profile.minBytesOut, 1);
+  bcmap_put(fp, cmap->profile.maxBytesOut, 1);
+
+  bcmap_put(fp, cmap->codespace.num, 2);
+  for (i = 0; i < cmap->codespace.num; i++) {
+    rangeDef *csr = cmap->codespace.ranges + i;
+    bcmap_put(fp, csr->dim, 1);
+    fwrite(csr->codeLo, 1, csr->dim, fp);
+    fwrite(csr->codeHi, 1, csr->dim, fp);
+  }
+
+  bcmap_put(fp, cmap->mapTbl ? bcmap_count_maps(cmap->mapTbl) : 0, 4);
+  if (cmap->mapTbl)
+    bcmap_put_maps(fp, cmap->mapTbl, code, 0);
+
+  for (count = 0, cid = 0; cid < 65536; cid++) {
+    if (cmap->reverseMap[cid])
+      count++;
+  }
+  bcmap_put(fp, count, 4);
+  for (cid = 0; cid < 65536; cid++) {
+    if (cmap->reverseMap[cid]) {
+      bcmap_put(fp, cid, 2);
+      bcmap_put(fp, cmap->reverseMap[cid], 4);
+    }
+  }
+
+  if (fclose(fp) == 0)
+    rename(tmpname, filename);
+  else
+    remove(tmpname);
+
+  RELEASE(tmpname);
+  RELEASE(filename);
+}
+
+struct bcmap_reader {
+  const unsigned char *cursor;
+  const unsigned char *endptr;
+  int                  error;
+};
+
+static ULONG
+bcmap_get (struct bcmap_reader *r, int n)
+{
+  ULONG value = 0;
+
+  if (r->error || r->endptr - r->cursor < n) {
+    r->error = 1;
+    return 0;
+  }
+  while (n-- > 0)
+    value = (value << 8) | *(r->cursor)++;
+
+  return value;
+}
+
+static const unsigned char *
+bcmap_get_bytes (struct bcmap_reader *r, ULONG len)
+{
+  const unsigned char *p = r->cursor;
+
+  if (r->error || (ULONG) (r->endptr - r->cursor) < len) {
+    r->error = 1;
+    return NULL;
+  }
+  r->cursor += len;
+
+  return p;
+}
+
+static char *
+bcmap_get_string (struct bcmap_reader *r)
+{
+  const unsigned char *p;
+  char  *str;
+  ULONG  len;
+
+  len = bcmap_get(r, 2);
+  p   = bcmap_get_bytes(r, len);
+  if (!p || len == 0)
+    return NULL;
+
+  str = NEW(len + 1, char);
+  memcpy(str, p, len);
+  str[len] = '\0';
+
+  return str;
+}
+
+/* Returns a partly loaded CMap to the state CMap_new() left it in. */
+static void
+CMap_clear (CMap *cmap)
+{
+  mapData *map;
+
+  if (cmap->name)
+    RELEASE(cmap->name);
+  cmap->name    = NULL;
+  cmap->type    = CMAP_TYPE_CODE_TO_CID;
+  cmap->wmode   = 0;
+  cmap->useCMap = NULL;
+  if (cmap->CSI) {
+    if (cmap->CSI->registry) RELEASE(cmap->CSI->registry);
+    if (cmap->CSI->ordering) RELEASE(cmap->CSI->ordering);
+    RELEASE(cmap->CSI);
+  }
+  cmap->CSI = NULL;
+
+  cmap->profile.minBytesIn  = 2;
+  cmap->profile.maxBytesIn  = 2;
+  cmap->profile.minBytesOut = 2;
+  cmap->profile.maxBytesOut = 2;
+
+  cmap->codespace.num = 0;
+  if (cmap->mapTbl)
+    mapDef_release(cmap->mapTbl);
+  cmap->mapTbl = NULL;
+  for (map = cmap->mapData->prev; map; ) {
+    mapData *prev = map->prev;
+    RELEASE(map->data);
+    RELEASE(map);
+    map = prev;
+  }
+  cmap->mapData->prev = NULL;
+  cmap->mapData->pos  = 0;
+
+  memset(cmap->reverseMap, 0, 65536 * sizeof(int));
+  flat_clear(cmap);
+}
+
+/*
+ * Returns -1 if there is no usable binary CMap, leaving cmap as it was
+ * passed in so that the source CMap can be parsed instead.
+ */
+static int
+CMap_cache_load_binary (CMap *cmap, const char *cmap_name, FILE *src)
+{
+  struct bcmap_reader r;
+  unsigned char *data;
+  char  *filename, *usecmap_name;
+  FILE  *fp;
+  ULONG  size, mtime, count, i;
+  long   len;
+  CIDSysInfo csi;
+
+  filename = bcmap_filename(cmap_name);
+  if (!filename)
+    return -1;
+  fp = fopen(filename, FOPEN_RBIN_MODE);
+  RELEASE(filename);
+  if (!fp)
+    return -1;
+  if (bcmap_source_stamp(src, &size, &mtime) < 0) {
+    fclose(fp);
+    return -1;
+  }
+
+  len  = file_size(fp);
+  data = NEW(len > 0 ? len : 1, unsigned char);
+  if (len < BCMAP_MAGIC_LEN + 8 ||
+      fread(data, 1, len, fp) != (size_t) len ||
+      memcmp(data, BCMAP_MAGIC, BCMAP_MAGIC_LEN)) {
+    RELEASE(data);
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  r.cursor = data + BCMAP_MAGIC_LEN;
+  r.endptr = data + len;
+  r.error  = 0;
+  if (bcmap_get(&r, 4) != size || bcmap_get(&r, 4) != mtime) {
+    RELEASE(data);
+    return -1;
+  }
+
+  if (__verbose)
+    MESG("[bcmap]");
+
+  cmap->name   = bcmap_get_string(&r);
+  usecmap_name = bcmap_get_string(&r);
+  csi.registry = bcmap_get_string(&r);
+  csi.ordering = bcmap_get_string(&r);
+  csi.supplement = bcmap_get(&r, 4);
+  if (csi.registry && csi.ordering)
+    CMap_set_CIDSysInfo(cmap, &csi);
+  if (csi.registry)
+    RELEASE(csi.registry);
+  if (csi.ordering)
+    RELEASE(csi.ordering);
+  cmap->type  = bcmap_get(&r, 1);
+  cmap->wmode = bcmap_get(&r, 1);
+
+  if (usecmap_name) {
+    int   id = texpdf_CMap_cache_find(usecmap_name);
+    CMap *ucmap;
+
+    /* Codespace ranges of usecmap are already part of this CMap. */
+    if (id < 0)
+      r.error = 1;
+    else {
+      /* A stale or broken file must not make the CMap use itself. */
+      for (ucmap = texpdf_CMap_cache_get(id);
+	   ucmap && ucmap != cmap; ucmap = ucmap->useCMap);
+      if (ucmap)
+	r.error = 1;
+      else
+	cmap->useCMap = texpdf_CMap_cache_get(id);
+    }
+    RELEASE(usecmap_name);
+  }
+
+  {
+    int profile[4];
+
+    for (i = 0; i < 4; i++)
+      profile[i] = bcmap_get(&r, 1);
+
+    count = bcmap_get(&r, 2);
+    for (i = 0; i < count && !r.error; i++) {
+      const unsigned char *lo, *hi;
+      int dim;
+
+      dim = bcmap_get(&r, 1);
+      lo  = bcmap_get_bytes(&r, dim);
+      hi  = bcmap_get_bytes(&r, dim);
+      if (lo && hi && dim > 0)
+        CMap_add_codespacerange(cmap, lo, hi, dim);
+    }
+    cmap->profile.minBytesIn  = profile[0];
+    cmap->profile.maxBytesIn  = profile[1];
+    cmap->profile.minBytesOut = profile[2];
+    cmap->profile.maxBytesOut = profile[3];
+  }
+
+  count = bcmap_get(&r, 4);
+  for (i = 0; i < count && !r.error; i++) {
+    const unsigned char *code, *dst;
+    mapDef *cur;
+    int     dim, type, dstlen;
+
+    dim    = bcmap_get(&r, 1);
+    code   = bcmap_get_bytes(&r, dim);
+    type   = bcmap_get(&r, 1);
+    dstlen = bcmap_get(&r, 2);
+    dst    = bcmap_get_bytes(&r, dstlen);
+    if (!code || !dst || dim < 1)
+      break;
+
+    if (!cmap->mapTbl)
+      cmap->mapTbl = mapDef_new();
+    cur = cmap->mapTbl;
+    if (locate_tbl(&cur, code, dim) < 0) {
+      r.error = 1;
+      break;
+    }
+    cur[code[dim-1]].flag = (MAP_LOOKUP_END|type);
+    cur[code[dim-1]].len  = dstlen;
+    cur[code[dim-1]].code = get_mem(cmap, dstlen);
+    memcpy(cur[code[dim-1]].code, dst, dstlen);
+  }
+
+  count = bcmap_get(&r, 4);
+  for (i = 0; i < count && !r.error; i++) {
+    long cid = bcmap_get(&r, 2);
+    cmap->reverseMap[cid] = bcmap_get(&r, 4);
+  }
+
+  RELEASE(data);
+
+  if (r.error || !cmap->name) {
+    WARN("%s: Ignoring broken binary CMap file for \"%s\".",
+	 CMAP_DEBUG_STR, cmap_name);
+    CMap_clear(cmap);
+    return -1;
+  }
+
+  return 0;
+}
@@ -120,4 +120,7 @@ extern int   texpdf_CMap_cache_find  (const char *cmap_name);
 extern void  CMap_cache_close (void);
 extern int   CMap_cache_add   (CMap *cmap);
 
+/* Directory for precompiled (binary) CMaps, NULL to disable. */
+extern void  texpdf_CMap_set_cache_dir (const char *dir);
+
 #endif /* _CMAP_H_ */
@@ -98,6 +98,19 @@ struct CMap {
   } profile;
 
   int *reverseMap;
+
+  /*
+   * Flattened lookup for 1- and 2-byte codes with useCMap parents
+   * merged in, built on first use by CMap_decode_char().
+   * one[c] is the mapping of the single byte code c; two[c], if not
+   * NULL, holds the mappings of the 2-byte codes starting with c.
+   * Codes not found here take the mapDef walk in CMap_decode_char().
+   */
+  struct {
+    int      state; /* 0: not built, 1: built, -1: not applicable */
+    mapDef  *one[256];
+    mapDef **two[256];
+  } flat;
 };
 
 #endif /* _CMAP_P_H_ */
@@ -309,7 +309,7 @@ CMap_create_stream (CMap *cmap)
       long     res_id;
       pdf_obj *ucmap_ref;
 
-      res_id = pdf_findresource("CMap", CMap_get_name(cmap->useCMap));
+      res_id = pdf_findresource_id(PDF_RESOURCE_CMAP, CMap_get_name(cmap->useCMap));
       if (res_id >= 0) {
 	ucmap_ref = texpdf_get_resource_reference(res_id);
       } else {
@@ -320,9 +320,9 @@ CMap_create_stream (CMap *cmap)
 	  ERROR("Uh ah. I cannot continue...");
 	}
 
-	res_id = pdf_defineresource("CMap",
-				    CMap_get_name(cmap->useCMap),
-				    ucmap_obj, PDF_RES_FLUSH_IMMEDIATE);
+	res_id = pdf_defineresource_id(PDF_RESOURCE_CMAP,
+				       CMap_get_name(cmap->useCMap),
+				       ucmap_obj, PDF_RES_FLUSH_IMMEDIATE);
 	ucmap_ref = texpdf_get_resource_reference(res_id);
       }
       texpdf_add_dict(stream_dict, texpdf_new_name("UseCMap"), ucmap_ref);
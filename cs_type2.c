@@ -60,22 +60,36 @@
 #define CS_SUBR_RETURN   2
 #define CS_CHAR_END      3
 
-static int status = CS_PARSE_ERROR;
+/*
+ * Interpreter state. Each cs_copy_charstring() call has its own, so
+ * charstrings of different fonts may be processed concurrently.
+ */
+typedef struct
+{
+  int    status;
 
-#define DST_NEED(a,b) {if ((a) < (b)) { status = CS_BUFFER_ERROR ; return ; }}
-#define SRC_NEED(a,b) {if ((a) < (b)) { status = CS_PARSE_ERROR  ; return ; }}
-#define NEED(a,b)     {if ((a) < (b)) { status = CS_STACK_ERROR  ; return ; }}
+  /* hintmask and cntrmask need number of stem zones */
+  int    num_stems;
+  int    phase;
 
-/* hintmask and cntrmask need number of stem zones */
-static int num_stems = 0;
-static int phase     = 0;
+  /* subroutine nesting */
+  int    nest;
 
-/* subroutine nesting */
-static int nest      = 0;
+  /* advance width */
+  int    have_width;
+  double width;
 
-/* advance width */
-static int    have_width = 0;
-static double width      = 0.0;
+  /* Operand stack and Transient array */
+  int    stack_top;
+  double arg_stack[CS_ARG_STACK_MAX];
+  double trn_array[CS_TRANS_ARRAY_MAX];
+
+  cff_index *gsubr_idx, *subr_idx;
+} cs_state;
+
+#define DST_NEED(a,b) {if ((a) < (b)) { cs->status = CS_BUFFER_ERROR ; return ; }}
+#define SRC_NEED(a,b) {if ((a) < (b)) { cs->status = CS_PARSE_ERROR  ; return ; }}
+#define NEED(a,b)     {if ((a) < (b)) { cs->status = CS_STACK_ERROR  ; return ; }}
 
 /*
  * Standard Encoding Accented Characters:
@@ -87,11 +101,6 @@ static double width      = 0.0;
 static double seac[4] = {0.0, 0.0, 0.0, 0.0};
 #endif
 
-/* Operand stack and Transient array */
-static int    stack_top = 0;
-static double arg_stack[CS_ARG_STACK_MAX];
-static double trn_array[CS_TRANS_ARRAY_MAX];
-
 /*
  * Type 2 CharString encoding
  */
@@ -182,14 +191,14 @@ static double trn_array[CS_TRANS_ARRAY_MAX];
  * clear_stack() put all operands sotred in operand stack to dest.
  */
 static void
-clear_stack (card8 **dest, card8 *limit)
+clear_stack (cs_state *cs, card8 **dest, card8 *limit)
 {
   int i;
 
-  for (i = 0; i < stack_top; i++) {
+  for (i = 0; i < cs->stack_top; i++) {
     double value;
     long   ivalue;
-    value  = arg_stack[i];
+    value  = cs->arg_stack[i];
     /* Nearest integer value */
     ivalue = (long) floor(value+0.5);
     if (value >= 0x8000L || value <= (-0x8000L - 1)) {
@@ -232,7 +241,7 @@ clear_stack (card8 **dest, card8 *limit)
     }
   }
 
-  stack_top = 0; /* clear stack */
+  cs->stack_top = 0; /* clear stack */
 
   return;
 }
@@ -248,7 +257,8 @@ clear_stack (card8 **dest, card8 *limit)
  */
 
 static void
-do_operator1 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+do_operator1 (cs_state *cs,
+	      card8 **dest, card8 *limit, card8 **data, card8 *endptr)
 {
   card8 op = **data;
 
@@ -260,74 +270,74 @@ do_operator1 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
   /* charstring may have hintmask if above operator have seen */
   case cs_hstem:
   case cs_vstem:
-    if (phase == 0 && (stack_top % 2)) {
-      have_width = 1;
-      width = arg_stack[0];
+    if (cs->phase == 0 && (cs->stack_top % 2)) {
+      cs->have_width = 1;
+      cs->width = cs->arg_stack[0];
     }
-    num_stems += stack_top/2;
-    clear_stack(dest, limit);
+    cs->num_stems += cs->stack_top/2;
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
-    phase = 1;
+    cs->phase = 1;
     break;
   case cs_hintmask:
   case cs_cntrmask:
-    if (phase < 2) {
-      if (phase == 0 && (stack_top % 2)) {
-	have_width = 1;
-	width = arg_stack[0];
+    if (cs->phase < 2) {
+      if (cs->phase == 0 && (cs->stack_top % 2)) {
+	cs->have_width = 1;
+	cs->width = cs->arg_stack[0];
       }
-      num_stems += stack_top/2;
+      cs->num_stems += cs->stack_top/2;
     }
-    clear_stack(dest, limit);
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
-    if (num_stems > 0) {
-      int masklen = (num_stems + 7) / 8;
+    if (cs->num_stems > 0) {
+      int masklen = (cs->num_stems + 7) / 8;
       DST_NEED(limit, *dest + masklen);
       SRC_NEED(endptr, *data + masklen);
       memmove(*dest, *data, masklen);
       *data += masklen;
       *dest += masklen;
     }
-    phase = 2;
+    cs->phase = 2;
     break;
   case cs_rmoveto:
-    if (phase == 0 && (stack_top % 2)) {
-      have_width = 1;
-      width = arg_stack[0];
+    if (cs->phase == 0 && (cs->stack_top % 2)) {
+      cs->have_width = 1;
+      cs->width = cs->arg_stack[0];
     }
-    clear_stack(dest, limit);
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
-    phase = 2;
+    cs->phase = 2;
     break;
   case cs_hmoveto:
   case cs_vmoveto:
-    if (phase == 0 && (stack_top % 2) == 0) {
-      have_width = 1;
-      width = arg_stack[0];
+    if (cs->phase == 0 && (cs->stack_top % 2) == 0) {
+      cs->have_width = 1;
+      cs->width = cs->arg_stack[0];
     }
-    clear_stack(dest, limit);
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
-    phase = 2;
+    cs->phase = 2;
     break;
   case cs_endchar:
-    if (stack_top == 1) {
-      have_width = 1;
-      width = arg_stack[0];
-      clear_stack(dest, limit);
-    } else if (stack_top == 4 || stack_top == 5) {
+    if (cs->stack_top == 1) {
+      cs->have_width = 1;
+      cs->width = cs->arg_stack[0];
+      clear_stack(cs, dest, limit);
+    } else if (cs->stack_top == 4 || cs->stack_top == 5) {
       WARN("\"seac\" character deprecated in Type 2 charstring.");
-      status = CS_PARSE_ERROR;
+      cs->status = CS_PARSE_ERROR;
       return;
-    } else if (stack_top > 0) {
+    } else if (cs->stack_top > 0) {
       WARN("%s: Operand stack not empty.", CS_TYPE2_DEBUG_STR);
     }
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
-    status = CS_CHAR_END;
+    cs->status = CS_CHAR_END;
     break;
   /* above oprators are candidate for first stack-clearing operator */
   case cs_rlineto:
@@ -340,12 +350,12 @@ do_operator1 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
   case cs_hhcurveto:
   case cs_vhcurveto:
   case cs_hvcurveto:
-    if (phase < 2) {
+    if (cs->phase < 2) {
       WARN("%s: Broken Type 2 charstring.", CS_TYPE2_DEBUG_STR);
-      status = CS_PARSE_ERROR;
+      cs->status = CS_PARSE_ERROR;
       return;
     }
-    clear_stack(dest, limit);
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 1);
     *(*dest)++ = op;
     break;
@@ -359,7 +369,7 @@ do_operator1 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
   default:
     /* no-op ? */
     WARN("%s: Unknown charstring operator: 0x%02x", CS_TYPE2_DEBUG_STR, op);
-    status = CS_PARSE_ERROR;
+    cs->status = CS_PARSE_ERROR;
     break;
   }
 
@@ -374,7 +384,8 @@ do_operator1 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
  *  random: How random ?
  */
 static void
-do_operator2 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+do_operator2 (cs_state *cs,
+	      card8 **dest, card8 *limit, card8 **data, card8 *endptr)
 {
   card8 op;
 
@@ -388,18 +399,18 @@ do_operator2 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
   switch(op) {
   case cs_dotsection: /* deprecated */
     WARN("Operator \"dotsection\" deprecated in Type 2 charstring.");
-    status = CS_PARSE_ERROR;
+    cs->status = CS_PARSE_ERROR;
     return;
   case cs_hflex:
   case cs_flex:
   case cs_hflex1:
   case cs_flex1:
-    if (phase < 2) {
+    if (cs->phase < 2) {
       WARN("%s: Broken Type 2 charstring.", CS_TYPE2_DEBUG_STR);
-      status = CS_PARSE_ERROR;
+      cs->status = CS_PARSE_ERROR;
       return;
     }
-    clear_stack(dest, limit);
+    clear_stack(cs, dest, limit);
     DST_NEED(limit, *dest + 2);
     *(*dest)++ = cs_escape;
     *(*dest)++ = op;
@@ -407,166 +418,166 @@ do_operator2 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
   /* all operator above are stack-clearing */
   /* no output */
   case cs_and:
-    NEED(stack_top, 2);
-    stack_top--;
-    if (arg_stack[stack_top] && arg_stack[stack_top-1]) {
-      arg_stack[stack_top-1] = 1.0;
+    NEED(cs->stack_top, 2);
+    cs->stack_top--;
+    if (cs->arg_stack[cs->stack_top] && cs->arg_stack[cs->stack_top-1]) {
+      cs->arg_stack[cs->stack_top-1] = 1.0;
     } else {
-      arg_stack[stack_top-1] = 0.0;
+      cs->arg_stack[cs->stack_top-1] = 0.0;
     }
     break;
   case cs_or:
-    NEED(stack_top, 2);
-    stack_top--;
-    if (arg_stack[stack_top] || arg_stack[stack_top-1]) {
-      arg_stack[stack_top-1] = 1.0;
+    NEED(cs->stack_top, 2);
+    cs->stack_top--;
+    if (cs->arg_stack[cs->stack_top] || cs->arg_stack[cs->stack_top-1]) {
+      cs->arg_stack[cs->stack_top-1] = 1.0;
     } else {
-      arg_stack[stack_top-1] = 0.0;
+      cs->arg_stack[cs->stack_top-1] = 0.0;
     }
     break;
   case cs_not:
-    NEED(stack_top, 1);
-    if (arg_stack[stack_top-1]) {
-      arg_stack[stack_top-1] = 0.0;
+    NEED(cs->stack_top, 1);
+    if (cs->arg_stack[cs->stack_top-1]) {
+      cs->arg_stack[cs->stack_top-1] = 0.0;
     } else {
-      arg_stack[stack_top-1] = 1.0;
+      cs->arg_stack[cs->stack_top-1] = 1.0;
     }
     break;
   case cs_abs:
-    NEED(stack_top, 1);
-    arg_stack[stack_top-1] = fabs(arg_stack[stack_top-1]);
+    NEED(cs->stack_top, 1);
+    cs->arg_stack[cs->stack_top-1] = fabs(cs->arg_stack[cs->stack_top-1]);
     break;
   case cs_add:
-    NEED(stack_top, 2);
-    arg_stack[stack_top-2] += arg_stack[stack_top-1];
-    stack_top--;
+    NEED(cs->stack_top, 2);
+    cs->arg_stack[cs->stack_top-2] += cs->arg_stack[cs->stack_top-1];
+    cs->stack_top--;
     break;
   case cs_sub:
-    NEED(stack_top, 2);
-    arg_stack[stack_top-2] -= arg_stack[stack_top-1];
-    stack_top--;
+    NEED(cs->stack_top, 2);
+    cs->arg_stack[cs->stack_top-2] -= cs->arg_stack[cs->stack_top-1];
+    cs->stack_top--;
     break;
   case cs_div: /* doesn't check overflow */
-    NEED(stack_top, 2);
-    arg_stack[stack_top-2] /= arg_stack[stack_top-1];
-    stack_top--;
+    NEED(cs->stack_top, 2);
+    cs->arg_stack[cs->stack_top-2] /= cs->arg_stack[cs->stack_top-1];
+    cs->stack_top--;
     break;
   case cs_neg:
-    NEED(stack_top, 1);
-    arg_stack[stack_top-1] *= -1.0;
+    NEED(cs->stack_top, 1);
+    cs->arg_stack[cs->stack_top-1] *= -1.0;
     break;
   case cs_eq:
-    NEED(stack_top, 2);
-    stack_top--;
-    if (arg_stack[stack_top] == arg_stack[stack_top-1]) {
-      arg_stack[stack_top-1] = 1.0;
+    NEED(cs->stack_top, 2);
+    cs->stack_top--;
+    if (cs->arg_stack[cs->stack_top] == cs->arg_stack[cs->stack_top-1]) {
+      cs->arg_stack[cs->stack_top-1] = 1.0;
     } else {
-      arg_stack[stack_top-1] = 0.0;
+      cs->arg_stack[cs->stack_top-1] = 0.0;
     }
     break;
   case cs_drop:
-    NEED(stack_top, 1);
-    stack_top--;
+    NEED(cs->stack_top, 1);
+    cs->stack_top--;
     break;
   case cs_put:
-    NEED(stack_top, 2);
+    NEED(cs->stack_top, 2);
     {
-      int idx = (int)arg_stack[--stack_top];
+      int idx = (int)cs->arg_stack[--cs->stack_top];
       NEED(CS_TRANS_ARRAY_MAX, idx);
-      trn_array[idx] = arg_stack[--stack_top];
+      cs->trn_array[idx] = cs->arg_stack[--cs->stack_top];
     }
     break;
   case cs_get:
-    NEED(stack_top, 1);
+    NEED(cs->stack_top, 1);
     {
-      int idx = (int)arg_stack[stack_top-1];
+      int idx = (int)cs->arg_stack[cs->stack_top-1];
       NEED(CS_TRANS_ARRAY_MAX, idx);
-      arg_stack[stack_top-1] = trn_array[idx];
+      cs->arg_stack[cs->stack_top-1] = cs->trn_array[idx];
     }
     break;
   case cs_ifelse:
-    NEED(stack_top, 4);
-    stack_top -= 3;
-    if (arg_stack[stack_top+1] > arg_stack[stack_top+2]) {
-      arg_stack[stack_top-1] = arg_stack[stack_top];
+    NEED(cs->stack_top, 4);
+    cs->stack_top -= 3;
+    if (cs->arg_stack[cs->stack_top+1] > cs->arg_stack[cs->stack_top+2]) {
+      cs->arg_stack[cs->stack_top-1] = cs->arg_stack[cs->stack_top];
     }
     break;
   case cs_mul:
-    NEED(stack_top, 2);
-    arg_stack[stack_top-2] = arg_stack[stack_top-2] * arg_stack[stack_top-1];
-    stack_top--;
+    NEED(cs->stack_top, 2);
+    cs->arg_stack[cs->stack_top-2] = cs->arg_stack[cs->stack_top-2] * cs->arg_stack[cs->stack_top-1];
+    cs->stack_top--;
     break;
   case cs_sqrt:
-    NEED(stack_top, 1);
-    arg_stack[stack_top-1] = sqrt(arg_stack[stack_top-1]);
+    NEED(cs->stack_top, 1);
+    cs->arg_stack[cs->stack_top-1] = sqrt(cs->arg_stack[cs->stack_top-1]);
     break;
   case cs_dup:
-    NEED(stack_top, 1);
-    NEED(CS_ARG_STACK_MAX, stack_top+1);
-    arg_stack[stack_top] = arg_stack[stack_top-1];
-    stack_top++;
+    NEED(cs->stack_top, 1);
+    NEED(CS_ARG_STACK_MAX, cs->stack_top+1);
+    cs->arg_stack[cs->stack_top] = cs->arg_stack[cs->stack_top-1];
+    cs->stack_top++;
     break;
   case cs_exch:
-    NEED(stack_top, 2);
+    NEED(cs->stack_top, 2);
     {
-      double save = arg_stack[stack_top-2];
-      arg_stack[stack_top-2] = arg_stack[stack_top-1];
-      arg_stack[stack_top-1] = save;
+      double save = cs->arg_stack[cs->stack_top-2];
+      cs->arg_stack[cs->stack_top-2] = cs->arg_stack[cs->stack_top-1];
+      cs->arg_stack[cs->stack_top-1] = save;
     }
     break;
   case cs_index:
-    NEED(stack_top, 2); /* need two arguments at least */
+    NEED(cs->stack_top, 2); /* need two arguments at least */
     {
-      int idx = (int)arg_stack[stack_top-1];
+      int idx = (int)cs->arg_stack[cs->stack_top-1];
       if (idx < 0) {
-	arg_stack[stack_top-1] = arg_stack[stack_top-2];
+	cs->arg_stack[cs->stack_top-1] = cs->arg_stack[cs->stack_top-2];
       } else {
-	NEED(stack_top, idx+2);
-	arg_stack[stack_top-1] = arg_stack[stack_top-idx-2];
+	NEED(cs->stack_top, idx+2);
+	cs->arg_stack[cs->stack_top-1] = cs->arg_stack[cs->stack_top-idx-2];
       }
     }
     break;
   case cs_roll:
-    NEED(stack_top, 2);
+    NEED(cs->stack_top, 2);
     {
       int N, J;
-      J = (int)arg_stack[--stack_top];
-      N = (int)arg_stack[--stack_top];
-      NEED(stack_top, N);
+      J = (int)cs->arg_stack[--cs->stack_top];
+      N = (int)cs->arg_stack[--cs->stack_top];
+      NEED(cs->stack_top, N);
       if (J > 0) {
 	J = J % N;
 	while (J-- > 0) {
-	  double save = arg_stack[stack_top-1];
-	  int i = stack_top - 1;
-	  while (i > stack_top-N) {
-	    arg_stack[i] = arg_stack[i-1];
+	  double save = cs->arg_stack[cs->stack_top-1];
+	  int i = cs->stack_top - 1;
+	  while (i > cs->stack_top-N) {
+	    cs->arg_stack[i] = cs->arg_stack[i-1];
 	    i--;
 	  }
-	  arg_stack[i] = save;
+	  cs->arg_stack[i] = save;
 	}
       } else {
 	J = (-J) % N;
 	while (J-- > 0) {
-	  double save = arg_stack[stack_top-N];
-	  int i = stack_top - N;
-	  while (i < stack_top-1) {
-	    arg_stack[i] = arg_stack[i+1];
+	  double save = cs->arg_stack[cs->stack_top-N];
+	  int i = cs->stack_top - N;
+	  while (i < cs->stack_top-1) {
+	    cs->arg_stack[i] = cs->arg_stack[i+1];
 	    i++;
 	  }
-	  arg_stack[i] = save;
+	  cs->arg_stack[i] = save;
 	}
       }
     }
     break;
   case cs_random:
     WARN("%s: Charstring operator \"random\" found.", CS_TYPE2_DEBUG_STR);
-    NEED(CS_ARG_STACK_MAX, stack_top+1);
-    arg_stack[stack_top++] = 1.0;
+    NEED(CS_ARG_STACK_MAX, cs->stack_top+1);
+    cs->arg_stack[cs->stack_top++] = 1.0;
     break;
   default:
     /* no-op ? */
     WARN("%s: Unknown charstring operator: 0x0c%02x", CS_TYPE2_DEBUG_STR, op);
-    status = CS_PARSE_ERROR;
+    cs->status = CS_PARSE_ERROR;
     break;
   }
 
@@ -578,7 +589,7 @@ do_operator2 (card8 **dest, card8 *limit, card8 **data, card8 *endptr)
  *  exactly the same as the DICT encoding (except 29)
  */
 static void
-get_integer (card8 **data, card8 *endptr)
+get_integer (cs_state *cs, card8 **data, card8 *endptr)
 {
   long result = 0;
   card8 b0 = **data, b1, b2;
@@ -606,12 +617,12 @@ get_integer (card8 **data, card8 *endptr)
     result = -(b0-251)*256-b1-108;
     *data += 1;
   } else {
-    status = CS_PARSE_ERROR;
+    cs->status = CS_PARSE_ERROR;
     return;
   }
 
-  NEED(CS_ARG_STACK_MAX, stack_top+1);
-  arg_stack[stack_top++] = (double) result;
+  NEED(CS_ARG_STACK_MAX, cs->stack_top+1);
+  cs->arg_stack[cs->stack_top++] = (double) result;
 
   return;
 }
@@ -620,7 +631,7 @@ get_integer (card8 **data, card8 *endptr)
  * Signed 16.16-bits fixed number for Type 2 charstring encoding
  */
 static void
-get_fixed (card8 **data, card8 *endptr)
+get_fixed (cs_state *cs, card8 **data, card8 *endptr)
 {
   long ivalue;
   double rvalue;
@@ -634,8 +645,8 @@ get_fixed (card8 **data, card8 *endptr)
   ivalue = *(*data+2) * 0x100 + *(*data+3);
   rvalue += ((double) ivalue) / 0x10000L;
 
-  NEED(CS_ARG_STACK_MAX, stack_top+1);
-  arg_stack[stack_top++] = rvalue;
+  NEED(CS_ARG_STACK_MAX, cs->stack_top+1);
+  cs->arg_stack[cs->stack_top++] = rvalue;
   *data += 4;
 
   return;
@@ -686,81 +697,126 @@ get_subr (card8 **subr, long *len, cff_index *subr_idx, long id)
  */
 
 static void
-do_charstring (card8 **dest, card8 *limit,
-	       card8 **data, card8 *endptr,
-	       cff_index *gsubr_idx, cff_index *subr_idx)
+do_charstring (cs_state *cs, card8 **dest, card8 *limit,
+	       card8 **data, card8 *endptr);
+
+static void
+call_subr (cs_state *cs, card8 **dest, card8 *limit,
+	   card8 **data, cff_index *subr_idx)
 {
-  card8 b0 = 0, *subr;
-  long  len;
+  card8 *subr;
+  long   len;
+
+  if (cs->stack_top < 1) {
+    cs->status = CS_STACK_ERROR;
+    return;
+  }
+  cs->stack_top--;
+  get_subr(&subr, &len, subr_idx, (long) cs->arg_stack[cs->stack_top]);
+  if (limit < *dest + len)
+    ERROR("%s: Possible buffer overflow.", CS_TYPE2_DEBUG_STR);
+  do_charstring(cs, dest, limit, &subr, subr + len);
+  *data += 1;
+}
+
+static void
+do_callsubr (cs_state *cs,
+	     card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+{
+  call_subr(cs, dest, limit, data, cs->subr_idx);
+}
+
+static void
+do_callgsubr (cs_state *cs,
+	      card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+{
+  call_subr(cs, dest, limit, data, cs->gsubr_idx);
+}
 
-  if (nest > CS_SUBR_NEST_MAX)
+static void
+do_return (cs_state *cs,
+	   card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+{
+  cs->status = CS_SUBR_RETURN;
+}
+
+static void
+do_shortint (cs_state *cs,
+	     card8 **dest, card8 *limit, card8 **data, card8 *endptr)
+{
+  get_integer(cs, data, endptr);
+}
+
+/*
+ * Operators and the shortint prefix are dispatched on their first byte.
+ */
+typedef void (*cs_operator) (cs_state *cs, card8 **dest, card8 *limit,
+			     card8 **data, card8 *endptr);
+
+static const cs_operator cs_operators[32] = {
+  do_operator1, do_operator1, do_operator1, do_operator1, /*  0 -  3 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /*  4 -  7 */
+  do_operator1, do_operator1, do_callsubr,  do_return,    /*  8 - 11 */
+  do_operator2, do_operator1, do_operator1, do_operator1, /* 12 - 15 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 16 - 19 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 20 - 23 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 24 - 27 */
+  do_shortint,  do_callgsubr, do_operator1, do_operator1  /* 28 - 31 */
+};
+
+static void
+do_charstring (cs_state *cs, card8 **dest, card8 *limit,
+	       card8 **data, card8 *endptr)
+{
+  card8 b0;
+
+  if (cs->nest > CS_SUBR_NEST_MAX)
     ERROR("%s: Subroutine nested too deeply.", CS_TYPE2_DEBUG_STR);
 
-  nest++;
+  cs->nest++;
 
-  while (*data < endptr && status == CS_PARSE_OK) {
+  while (*data < endptr && cs->status == CS_PARSE_OK) {
     b0 = **data;
-    if (b0 == 255) { /* 16-bit.16-bit fixed signed number */
-      get_fixed(data, endptr);
-    } else if (b0 == cs_return) {
-      status = CS_SUBR_RETURN;
-    } else if (b0 == cs_callgsubr) {
-      if (stack_top < 1) {
-	status = CS_STACK_ERROR;
-      } else {
-	stack_top--;
-	get_subr(&subr, &len, gsubr_idx, (long) arg_stack[stack_top]);
-	if (*dest + len > limit)
-	  ERROR("%s: Possible buffer overflow.", CS_TYPE2_DEBUG_STR);
-	do_charstring(dest, limit, &subr, subr + len,
-		      gsubr_idx, subr_idx);
-	*data += 1;
+    if (b0 >= 32 && b0 <= 246) { /* int (1), by far the most common */
+      if (cs->stack_top >= CS_ARG_STACK_MAX) {
+	cs->status = CS_STACK_ERROR;
+	break;
       }
-    } else if (b0 == cs_callsubr) {
-      if (stack_top < 1) {
-	status = CS_STACK_ERROR;
-      } else {
-	stack_top--;
-	get_subr(&subr, &len, subr_idx, (long) arg_stack[stack_top]);
-	if (limit < *dest + len)
-	  ERROR("%s: Possible buffer overflow.", CS_TYPE2_DEBUG_STR);
-	do_charstring(dest, limit, &subr, subr + len,
-		      gsubr_idx, subr_idx);
-	*data += 1;
-      }
-    } else if (b0 == cs_escape) {
-      do_operator2(dest, limit, data, endptr);
-    } else if (b0 < 32 && b0 != 28) { /* 19, 20 need mask */
-      do_operator1(dest, limit, data, endptr);
-    } else if ((b0 <= 22 && b0 >= 27) || b0 == 31) { /* reserved */
-      status = CS_PARSE_ERROR; /* not an error ? */
-    } else { /* integer */
-      get_integer(data, endptr);
+      cs->arg_stack[cs->stack_top++] = (double) (b0 - 139);
+      *data += 1;
+    } else if (b0 == 255) { /* 16-bit.16-bit fixed signed number */
+      get_fixed(cs, data, endptr);
+    } else if (b0 >= 32) { /* int (2) */
+      get_integer(cs, data, endptr);
+    } else {
+      cs_operators[b0](cs, dest, limit, data, endptr);
     }
   }
 
-  if (status == CS_SUBR_RETURN) {
-    status = CS_PARSE_OK;
-  } else if (status == CS_CHAR_END && *data < endptr) {
+  if (cs->status == CS_SUBR_RETURN) {
+    cs->status = CS_PARSE_OK;
+  } else if (cs->status == CS_CHAR_END && *data < endptr) {
     WARN("%s: Garbage after endchar.", CS_TYPE2_DEBUG_STR);
-  } else if (status < CS_PARSE_OK) { /* error */
+  } else if (cs->status < CS_PARSE_OK) { /* error */
     ERROR("%s: Parsing charstring failed: (status=%d, stack=%d)",
-	  CS_TYPE2_DEBUG_STR, status, stack_top);
+	  CS_TYPE2_DEBUG_STR, cs->status, cs->stack_top);
   }
 
-  nest--;
+  cs->nest--;
 
   return;
 }
 
 static void
-cs_parse_init (void)
+cs_parse_init (cs_state *cs, cff_index *gsubr, cff_index *subr)
 {
-  status = CS_PARSE_OK;
-  nest   = 0;
-  phase  = 0;
-  num_stems = 0;
-  stack_top = 0;
+  cs->status = CS_PARSE_OK;
+  cs->nest   = 0;
+  cs->phase  = 0;
+  cs->num_stems = 0;
+  cs->stack_top = 0;
+  cs->gsubr_idx = gsubr;
+  cs->subr_idx  = subr;
 }
 
 /*
@@ -772,20 +828,21 @@ cs_copy_charstring (card8 *dst, long dstlen,
 		    cff_index *gsubr, cff_index *subr,
 		    double default_width, double nominal_width, cs_ginfo *ginfo)
 {
-  card8 *save = dst;
+  cs_state  state, *cs = &state;
+  card8    *save = dst;
 
-  cs_parse_init();
+  cs_parse_init(cs, gsubr, subr);
 
-  width = 0.0;
-  have_width = 0;
+  cs->width = 0.0;
+  cs->have_width = 0;
 
   /* expand call(g)subrs */
-  do_charstring(&dst, dst + dstlen, &src, src + srclen, gsubr, subr);
+  do_charstring(cs, &dst, dst + dstlen, &src, src + srclen);
 
   if (ginfo) {
     ginfo->flags = 0; /* not used */
-    if (have_width) {
-      ginfo->wx = nominal_width + width;
+    if (cs->have_width) {
+      ginfo->wx = nominal_width + cs->width;
     } else {
       ginfo->wx = default_width;
     }
@@ -793,3 +850,576 @@ cs_copy_charstring (card8 *dst, long dstlen,
 
   return (long)(dst - save);
 }
+
+/*
+ * Subroutinizer:
+ *  Flattened charstrings of a subset font are searched for repeated
+ *  token sequences, which are moved into global subroutines. Tokens
+ *  are operands or operators; hintmask and cntrmask carry their mask
+ *  bytes. Sequences are found with a suffix array over token IDs and
+ *  chosen greedily by estimated saving. The whole pass runs against a
+ *  time budget; selection stops early when it runs out, and earlier
+ *  stages give up. Subroutines do not call other subroutines.
+ */
+
+#include <time.h>
+#ifdef HAVE_ZLIB_COMPRESS2
+#include <zlib.h>
+#endif /* HAVE_ZLIB_COMPRESS2 */
+
+#define SUBR_TOKENS_MAX 64 /* longest token sequence considered */
+#define SUBR_CALL_COST   3 /* estimated bytes for "n callgsubr" */
+#define SUBR_COUNT_MAX   65535
+
+static double subr_time_limit = 0.0;
+
+void
+texpdf_cs_set_subroutinize (double seconds)
+{
+  subr_time_limit = seconds;
+}
+
+struct cs_tokens
+{
+  long   count, max;
+  long  *id;     /* token ID, negative for tokens never shared */
+  long  *cum;    /* bytes before this token within all data */
+  long  *src;    /* offset of token within charstring data */
+  card8 *depth;  /* operands on the stack before this token */
+};
+
+struct cs_subr
+{
+  long  pos;     /* first occurrence */
+  int   ntok;
+  long  bytes;
+  long  uses;
+  long  index;   /* final position in the subroutine INDEX */
+};
+
+struct cs_cand
+{
+  long  lb, rb;  /* interval in the suffix array */
+  int   ntok;
+  long  bytes;
+  long  est;
+};
+
+static void
+add_token (struct cs_tokens *t, long id, long src, long len, int depth)
+{
+  if (t->count + 1 >= t->max) {
+    t->max  += MAX(1024, t->max);
+    t->id    = RENEW(t->id,    t->max, long);
+    t->cum   = RENEW(t->cum,   t->max + 1, long);
+    t->src   = RENEW(t->src,   t->max, long);
+    t->depth = RENEW(t->depth, t->max, card8);
+  }
+  if (t->count == 0)
+    t->cum[0] = 0;
+  t->id[t->count]    = id;
+  t->src[t->count]   = src;
+  t->depth[t->count] = depth;
+  t->cum[t->count+1] = t->cum[t->count] + len;
+  t->count++;
+}
+
+/*
+ * Split one flattened charstring into tokens. Returns -1 if it uses
+ * anything other than the stack-clearing operators cs_copy_charstring
+ * emits, in which case it is kept as a single unshared token.
+ */
+static int
+tokenize_charstring (struct cs_tokens *t, struct ht_table *ids,
+		     card8 *data, long start, long end)
+{
+  long  pos, len, id;
+  int   nargs = 0, stems = 0, hint_phase = 0, depth;
+  long  first = t->count;
+
+  for (pos = start; pos < end; pos += len) {
+    card8 b0 = data[pos];
+
+    depth = nargs;
+    if (b0 >= 32 || b0 == 28) {
+      len = (b0 == 28) ? 3 : (b0 < 247) ? 1 : (b0 < 255) ? 2 : 5;
+      nargs++;
+    } else if (b0 == cs_escape) {
+      len = 2;
+      if (pos + 1 >= end ||
+	  data[pos+1] < cs_hflex || data[pos+1] > cs_flex1)
+	goto unshared;
+      nargs = 0;
+    } else {
+      len = 1;
+      switch (b0) {
+      case cs_hstem: case cs_vstem: case cs_hstemhm: case cs_vstemhm:
+	stems += nargs / 2;
+	hint_phase = 1;
+	break;
+      case cs_hintmask: case cs_cntrmask:
+	if (hint_phase < 2)
+	  stems += nargs / 2;
+	len += (stems + 7) / 8;
+	hint_phase = 2;
+	break;
+      case cs_rmoveto: case cs_hmoveto: case cs_vmoveto:
+	hint_phase = 2;
+	break;
+      case cs_endchar:
+      case cs_rlineto: case cs_hlineto: case cs_vlineto:
+      case cs_rrcurveto: case cs_rcurveline: case cs_rlinecurve:
+      case cs_vvcurveto: case cs_hhcurveto:
+      case cs_vhcurveto: case cs_hvcurveto:
+	break;
+      default:
+	goto unshared;
+      }
+      nargs = 0;
+    }
+    if (pos + len > end || nargs >= CS_ARG_STACK_MAX)
+      goto unshared;
+
+    id = (long) texpdf_ht_lookup_table(ids, data + pos, len);
+    if (!id) {
+      id = ids->count + 1;
+      texpdf_ht_append_table(ids, data + pos, len, (void *) id);
+    }
+    add_token(t, id, pos, len, depth);
+  }
+  add_token(t, -(t->count + 1), end, 0, 0); /* end of charstring */
+
+  return 0;
+
+ unshared:
+  t->count = first;
+  add_token(t, -(t->count + 1), start, end - start, 0);
+  add_token(t, -(t->count + 1), end, 0, 0);
+
+  return -1;
+}
+
+static int
+common_tokens (const struct cs_tokens *t, long a, long b)
+{
+  const long *id = t->id;
+  int   n;
+
+  for (n = 0; n < SUBR_TOKENS_MAX &&
+	 id[a+n] == id[b+n] && id[a+n] > 0; n++);
+
+  return n;
+}
+
+static int
+cmp_suffix (const struct cs_tokens *t, long a, long b)
+{
+  int   n;
+
+  n = common_tokens(t, a, b);
+  if (n == SUBR_TOKENS_MAX)
+    return 0;
+  if (t->id[a+n] < 0 && t->id[b+n] < 0) /* both ended */
+    return 0;
+
+  return t->id[a+n] < t->id[b+n] ? -1 : 1;
+}
+
+/*
+ * Bottom-up merge sort of the suffixes in sa, which needs the token
+ * context that qsort() cannot pass portably. Returns -1 if the deadline
+ * passes first, leaving sa a partly sorted permutation.
+ */
+static int
+sort_suffixes (long *sa, long n, const struct cs_tokens *t, clock_t deadline)
+{
+  long  *buf, *src, *dst, *swap;
+  long   width, lo, mid, hi, i, j, k, x, done = 0;
+  int    status = 0;
+
+  /* Runs of 16 by insertion sort. */
+  for (lo = 0; lo < n; lo += 16) {
+    hi = MIN(lo + 16, n);
+    for (i = lo + 1; i < hi; i++) {
+      x = sa[i];
+      for (j = i; j > lo && cmp_suffix(t, sa[j-1], x) > 0; j--)
+	sa[j] = sa[j-1];
+      sa[j] = x;
+    }
+  }
+
+  buf = NEW(n + 1, long);
+  src = sa;
+  dst = buf;
+  for (width = 16; width < n; width *= 2) {
+    for (lo = 0; lo < n; lo += 2 * width) {
+      mid = MIN(lo + width, n);
+      hi  = MIN(lo + 2 * width, n);
+      for (i = lo, j = mid, k = lo; k < hi; k++) {
+	if (i < mid && (j >= hi || cmp_suffix(t, src[i], src[j]) <= 0))
+	  dst[k] = src[i++];
+	else
+	  dst[k] = src[j++];
+      }
+      done += hi - lo;
+      if (done >= 0x10000) {
+	done = 0;
+	if (clock() > deadline) {
+	  status = -1;
+	  break;
+	}
+      }
+    }
+    if (status < 0)
+      break;
+    swap = src; src = dst; dst = swap;
+  }
+  if (src != sa)
+    memcpy(sa, src, n * sizeof(long));
+  RELEASE(buf);
+
+  return status;
+}
+
+static int CDECL
+cmp_cand (const void *v1, const void *v2)
+{
+  const struct cs_cand *c1 = v1, *c2 = v2;
+
+  return c1->est < c2->est ? 1 : c1->est > c2->est ? -1 : 0;
+}
+
+static int CDECL
+cmp_long (const void *v1, const void *v2)
+{
+  long  a = *(const long *) v1, b = *(const long *) v2;
+
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static int CDECL
+cmp_subr_uses (const void *v1, const void *v2)
+{
+  const struct cs_subr *s1 = *(struct cs_subr * const *) v1;
+  const struct cs_subr *s2 = *(struct cs_subr * const *) v2;
+
+  return s1->uses < s2->uses ? 1 : s1->uses > s2->uses ? -1 : 0;
+}
+
+static long
+subr_bias (long count)
+{
+  return count < 1240 ? 107 : count < 33900 ? 1131 : 32768;
+}
+
+static int
+put_subr_number (card8 *dest, long v)
+{
+  if (v >= -107 && v <= 107) {
+    dest[0] = v + 139;
+    return 1;
+  } else if (v >= 108 && v <= 1131) {
+    v = 0xf700u + v - 108;
+  } else if (v >= -1131 && v <= -108) {
+    v = 0xfb00u - v - 108;
+  } else {
+    dest[0] = 28;
+    dest[1] = (v >> 8) & 0xff;
+    dest[2] = v & 0xff;
+    return 3;
+  }
+  dest[0] = (v >> 8) & 0xff;
+  dest[1] = v & 0xff;
+
+  return 2;
+}
+
+static int
+subr_ends_char (struct cs_tokens *t, card8 *data, struct cs_subr *s)
+{
+  long last = s->pos + s->ntok - 1;
+
+  return t->cum[last+1] - t->cum[last] == 1 && data[t->src[last]] == cs_endchar;
+}
+
+/*
+ * Size of the packed INDEXes as they end up in the PDF file, deflated
+ * at the current compression level.
+ */
+static long
+subr_packed_size (cff_index *idx1, cff_index *idx2)
+{
+  card8 *buf;
+  long   len, size;
+
+  len  = cff_index_size(idx1) + cff_index_size(idx2);
+  buf  = NEW(len, card8);
+  size = cff_pack_index(idx1, buf, len);
+  size += cff_pack_index(idx2, buf + size, len - size);
+#ifdef HAVE_ZLIB_COMPRESS2
+  if (texpdf_get_compression() > 0) {
+    uLongf zlen = compressBound(size);
+    card8 *zbuf = NEW(zlen, card8);
+
+    if (compress2(zbuf, &zlen, buf, size, texpdf_get_compression()) == Z_OK)
+      size = zlen;
+    RELEASE(zbuf);
+  }
+#endif /* HAVE_ZLIB_COMPRESS2 */
+  RELEASE(buf);
+
+  return size;
+}
+
+/*
+ * Subroutinize the charstrings in cstrings in place. Returns the new
+ * Global Subrs INDEX, which is empty, with cstrings left unchanged, if
+ * subroutinization is disabled, runs out of time before any sequence
+ * is chosen, or does not make the deflated font smaller.
+ */
+cff_index *
+cs_subroutinize (cff_index *cstrings)
+{
+  struct cs_tokens  tokens;
+  struct ht_table   ids;
+  struct cs_cand   *cands = NULL;
+  struct cs_subr   *subrs = NULL, **order;
+  cff_index        *gsubr, *result, *empty;
+  long   *sa = NULL, *lcp = NULL, *call, *pos, *stack_lcp, *stack_lb;
+  long    i, j, k, g, n, num_cands = 0, max_cands = 0, num_subrs = 0, max_subrs = 0;
+  long    bias, datalen;
+  long   *glyph;
+  clock_t deadline;
+
+  if (subr_time_limit <= 0.0 || !cstrings || cstrings->count < 2)
+    return cff_new_index(0);
+  deadline = clock() + (clock_t) (subr_time_limit * CLOCKS_PER_SEC);
+
+  /* Tokens of all charstrings, each charstring followed by an end marker. */
+  memset(&tokens, 0, sizeof(tokens));
+  texpdf_ht_init_table(&ids, NULL);
+  glyph = NEW(cstrings->count + 1, long);
+  for (g = 0; g < cstrings->count; g++) {
+    if ((g & 0xff) == 0 && clock() > deadline)
+      break;
+    glyph[g] = tokens.count;
+    tokenize_charstring(&tokens, &ids, cstrings->data,
+			cstrings->offset[g] - 1, cstrings->offset[g+1] - 1);
+  }
+  glyph[g] = tokens.count;
+  texpdf_ht_clear_table(&ids);
+  n = tokens.count;
+  if (g < cstrings->count)
+    goto done;
+
+  /* Suffix array of suffixes starting at shareable tokens. */
+  sa = NEW(n, long);
+  for (i = 0, k = 0; i < n; i++) {
+    if (tokens.id[i] > 0)
+      sa[k++] = i;
+  }
+  if (sort_suffixes(sa, k, &tokens, deadline) < 0)
+    goto done;
+  lcp = NEW(k + 1, long);
+  lcp[0] = 0;
+  for (i = 1; i < k; i++) {
+    if ((i & 0xffff) == 0 && clock() > deadline)
+      goto done;
+    lcp[i] = common_tokens(&tokens, sa[i-1], sa[i]);
+  }
+  lcp[k] = 0;
+
+  /* Each LCP interval is a token sequence repeated rb - lb + 1 times. */
+  stack_lcp = NEW(k + 1, long);
+  stack_lb  = NEW(k + 1, long);
+  j = 0;
+  stack_lcp[j] = 0; stack_lb[j] = 0;
+  for (i = 1; i <= k; i++) {
+    long lb = i - 1;
+
+    while (lcp[i] < stack_lcp[j]) {
+      long  l = stack_lcp[j], bytes;
+
+      lb = stack_lb[j];
+      j--;
+      bytes = tokens.cum[sa[lb] + l] - tokens.cum[sa[lb]];
+      if (l >= 2) {
+	struct cs_cand *c;
+
+	if (num_cands >= max_cands) {
+	  max_cands += MAX(1024, max_cands);
+	  cands = RENEW(cands, max_cands, struct cs_cand);
+	}
+	c = &cands[num_cands++];
+	c->lb    = lb;
+	c->rb    = i - 1;
+	c->ntok  = l;
+	c->bytes = bytes;
+	c->est   = (i - lb) * (bytes - SUBR_CALL_COST) - (bytes + 3);
+	if (c->est <= 0)
+	  num_cands--;
+      }
+    }
+    if (lcp[i] > stack_lcp[j]) {
+      j++;
+      stack_lcp[j] = lcp[i];
+      stack_lb[j]  = lb;
+    }
+  }
+  RELEASE(stack_lb);
+  RELEASE(stack_lcp);
+
+  /* Greedy selection of non-overlapping occurrences. */
+  qsort(cands, num_cands, sizeof(struct cs_cand), cmp_cand);
+  call = NEW(n, long);  /* subroutine called at token, -1, or -2 if covered */
+  for (i = 0; i < n; i++)
+    call[i] = -1;
+  pos = NEW(k + 1, long);
+  for (i = 0; i < num_cands && num_subrs < SUBR_COUNT_MAX; i++) {
+    struct cs_cand *c = &cands[i];
+    long  m = 0, last = -1, saving;
+
+    if ((i & 0xff) == 0 && clock() > deadline)
+      break;
+
+    for (j = c->lb; j <= c->rb; j++)
+      pos[j - c->lb] = sa[j];
+    qsort(pos, c->rb - c->lb + 1, sizeof(long), cmp_long);
+    for (j = 0; j <= c->rb - c->lb; j++) {
+      long p = pos[j];
+
+      if (p < last || tokens.depth[p] >= CS_ARG_STACK_MAX - 1)
+	continue;
+      for (g = 0; g < c->ntok && call[p+g] == -1; g++);
+      if (g < c->ntok)
+	continue;
+      pos[m++] = p;
+      last = p + c->ntok;
+    }
+    saving = m * (c->bytes - SUBR_CALL_COST) - (c->bytes + 3);
+    if (m < 2 || saving <= 0)
+      continue;
+
+    if (num_subrs >= max_subrs) {
+      max_subrs += MAX(256, max_subrs);
+      subrs = RENEW(subrs, max_subrs, struct cs_subr);
+    }
+    subrs[num_subrs].pos   = pos[0];
+    subrs[num_subrs].ntok  = c->ntok;
+    subrs[num_subrs].bytes = c->bytes;
+    subrs[num_subrs].uses  = m;
+    for (j = 0; j < m; j++) {
+      call[pos[j]] = num_subrs;
+      for (g = 1; g < c->ntok; g++)
+	call[pos[j]+g] = -2;
+    }
+    num_subrs++;
+  }
+  RELEASE(pos);
+  if (num_subrs == 0) {
+    RELEASE(call);
+    goto done;
+  }
+
+  /* Most used subroutines get the shortest subroutine numbers. */
+  order = NEW(num_subrs + 1, struct cs_subr *);
+  for (i = 0; i < num_subrs; i++)
+    order[i] = &subrs[i];
+  qsort(order, num_subrs, sizeof(struct cs_subr *), cmp_subr_uses);
+  for (i = 0; i < num_subrs; i++)
+    order[i]->index = i;
+  bias = subr_bias(num_subrs);
+
+  /* Global Subrs */
+  gsubr = cff_new_index(num_subrs);
+  for (i = 0, datalen = 0; i < num_subrs; i++)
+    datalen += order[i]->bytes + 1;
+  gsubr->data = NEW(datalen, card8);
+  for (i = 0, datalen = 0; i < num_subrs; i++) {
+    struct cs_subr *s = order[i];
+
+    for (j = s->pos; j < s->pos + s->ntok; j++) {
+      long len = tokens.cum[j+1] - tokens.cum[j];
+
+      memcpy(gsubr->data + datalen, cstrings->data + tokens.src[j], len);
+      datalen += len;
+    }
+    if (!subr_ends_char(&tokens, cstrings->data, s))
+      gsubr->data[datalen++] = cs_return;
+    gsubr->offset[i+1] = datalen + 1;
+  }
+  RELEASE(order);
+
+  /* Charstrings with calls. */
+  result = cff_new_index(cstrings->count);
+  result->data = NEW(tokens.cum[n] + 1, card8);
+  for (g = 0, datalen = 0; g < cstrings->count; g++) {
+    result->offset[g] = datalen + 1;
+    for (i = glyph[g]; i < glyph[g+1]; i++) {
+      if (call[i] >= 0) {
+	datalen += put_subr_number(result->data + datalen,
+				   subrs[call[i]].index - bias);
+	result->data[datalen++] = cs_callgsubr;
+	i += subrs[call[i]].ntok - 1;
+      } else {
+	long len = tokens.cum[i+1] - tokens.cum[i];
+
+	memcpy(result->data + datalen, cstrings->data + tokens.src[i], len);
+	datalen += len;
+      }
+    }
+  }
+  result->offset[g] = datalen + 1;
+  RELEASE(call);
+
+  /*
+   * Deflate finds much of the same redundancy, so the subroutinized
+   * font is kept only if it is still smaller once compressed.
+   */
+  empty = cff_new_index(0);
+  if (subr_packed_size(result, gsubr) < subr_packed_size(cstrings, empty)) {
+    RELEASE(cstrings->data);
+    RELEASE(cstrings->offset);
+    cstrings->data   = result->data;
+    cstrings->offset = result->offset;
+    result->data     = NULL;
+    result->offset   = NULL;
+    cff_release_index(empty);
+  } else {
+    cff_release_index(gsubr);
+    gsubr = empty;
+  }
+  cff_release_index(result);
+
+  RELEASE(subrs);
+  RELEASE(lcp);
+  RELEASE(sa);
+  if (cands)
+    RELEASE(cands);
+  RELEASE(glyph);
+  RELEASE(tokens.id);
+  RELEASE(tokens.cum);
+  RELEASE(tokens.src);
+  RELEASE(tokens.depth);
+
+  return gsubr;
+
+ done:
+  if (subrs)
+    RELEASE(subrs);
+  if (lcp)
+    RELEASE(lcp);
+  if (sa)
+    RELEASE(sa);
+  if (cands)
+    RELEASE(cands);
+  RELEASE(glyph);
+  if (tokens.id) {
+    RELEASE(tokens.id);
+    RELEASE(tokens.cum);
+    RELEASE(tokens.src);
+    RELEASE(tokens.depth);
+  }
+
+  return cff_new_index(0);
+}
@@ -40,4 +40,8 @@ extern long cs_copy_charstring (card8 *dest, long destlen,
 				cff_index *gsubr, cff_index *subr,
 				double default_width, double nominal_width, cs_ginfo *ginfo);
 
+/* Optional subroutinization of subset charstrings, off by default. */
+extern void       texpdf_cs_set_subroutinize (double seconds);
+extern cff_index *cs_subroutinize            (cff_index *cstrings);
+
 #endif /* _CS_TYPE2_H_ */
@@ -83,120 +83,136 @@ void texpdf_MD5_init (MD5_CONTEXT *ctx)
  * (as found in Colin Plumbs public domain implementation). */
 /* #define FF(b, c, d) ((b & c) | (~b & d)) */
 #define FF(b, c, d) (d ^ (b & (c ^ d)))
-#define FG(b, c, d) FF(d, b, c)
+/* FG's two terms have no bits in common, so "+" can replace "|" and the
+ * term that does not depend on b can be computed ahead of it. */
+#define FG(b, c, d) ((d & b) + (~d & c))
 #define FH(b, c, d) (b ^ c ^ d)
 #define FI(b, c, d) (c ^ (b | ~d))
 
 /* transform n*64 bytes */
-static void transform (MD5_CONTEXT *ctx, const unsigned char *data)
+static void transform (MD5_CONTEXT *ctx, const unsigned char *data, unsigned long n)
 {
   uint32_t correct_words[16];
   register uint32_t A = ctx->A;
   register uint32_t B = ctx->B;
   register uint32_t C = ctx->C;
   register uint32_t D = ctx->D;
-  uint32_t *cwp = correct_words;
+  uint32_t *cwp;
+
+  /* The chaining variables stay in registers across blocks. */
+  for (; n > 0; n--, data += 64) {
+    uint32_t A0 = A, B0 = B, C0 = C, D0 = D;
+
+    cwp = correct_words;
 
 #ifdef WORDS_BIGENDIAN
-  { int i; const unsigned char *p1; unsigned char *p2;
-    for (i = 0, p1 = data, p2 = (unsigned char *)correct_words; i < 16; i++, p2 += 4 ) {
-      p2[3] = *p1++; p2[2] = *p1++; p2[1] = *p1++; p2[0] = *p1++;
+    { int i; const unsigned char *p1; unsigned char *p2;
+      for (i = 0, p1 = data, p2 = (unsigned char *)correct_words; i < 16; i++, p2 += 4 ) {
+        p2[3] = *p1++; p2[2] = *p1++; p2[1] = *p1++; p2[0] = *p1++;
+      }
     }
-  }
 #else
-  memcpy(correct_words, data, sizeof(uint32_t) * 16);
+    memcpy(correct_words, data, sizeof(uint32_t) * 16);
 #endif
 
 #define OP(a, b, c, d, s, T) \
-  do { a += FF(b, c, d) + (*cwp++) + T; a = rol(a, s); a += b; } while (0)
-
-  /* Before we start, one word about the strange constants.
-   * They are defined in RFC 1321 as
-   *
-   *   T[i] = (int) (4294967296.0 * fabs (sin (i))), i=1..64
-   */
-
-  /* Round 1. */
-  OP(A, B, C, D,  7, 0xd76aa478);
-  OP(D, A, B, C, 12, 0xe8c7b756);
-  OP(C, D, A, B, 17, 0x242070db);
-  OP(B, C, D, A, 22, 0xc1bdceee);
-  OP(A, B, C, D,  7, 0xf57c0faf);
-  OP(D, A, B, C, 12, 0x4787c62a);
-  OP(C, D, A, B, 17, 0xa8304613);
-  OP(B, C, D, A, 22, 0xfd469501);
-  OP(A, B, C, D,  7, 0x698098d8);
-  OP(D, A, B, C, 12, 0x8b44f7af);
-  OP(C, D, A, B, 17, 0xffff5bb1);
-  OP(B, C, D, A, 22, 0x895cd7be);
-  OP(A, B, C, D,  7, 0x6b901122);
-  OP(D, A, B, C, 12, 0xfd987193);
-  OP(C, D, A, B, 17, 0xa679438e);
-  OP(B, C, D, A, 22, 0x49b40821);
+    do { a += FF(b, c, d) + (*cwp++) + T; a = rol(a, s); a += b; } while (0)
+
+    /* Before we start, one word about the strange constants.
+     * They are defined in RFC 1321 as
+     *
+     *   T[i] = (int) (4294967296.0 * fabs (sin (i))), i=1..64
+     */
+
+    /* Round 1. */
+    OP(A, B, C, D,  7, 0xd76aa478);
+    OP(D, A, B, C, 12, 0xe8c7b756);
+    OP(C, D, A, B, 17, 0x242070db);
+    OP(B, C, D, A, 22, 0xc1bdceee);
+    OP(A, B, C, D,  7, 0xf57c0faf);
+    OP(D, A, B, C, 12, 0x4787c62a);
+    OP(C, D, A, B, 17, 0xa8304613);
+    OP(B, C, D, A, 22, 0xfd469501);
+    OP(A, B, C, D,  7, 0x698098d8);
+    OP(D, A, B, C, 12, 0x8b44f7af);
+    OP(C, D, A, B, 17, 0xffff5bb1);
+    OP(B, C, D, A, 22, 0x895cd7be);
+    OP(A, B, C, D,  7, 0x6b901122);
+    OP(D, A, B, C, 12, 0xfd987193);
+    OP(C, D, A, B, 17, 0xa679438e);
+    OP(B, C, D, A, 22, 0x49b40821);
 
 #undef OP
 #define OP(f, a, b, c, d, k, s, T) \
-  do { a += f(b, c, d) + correct_words[k] + T; a = rol(a, s); a += b; } while (0)
-
-  /* Round 2. */
-  OP(FG, A, B, C, D,  1,  5, 0xf61e2562);
-  OP(FG, D, A, B, C,  6,  9, 0xc040b340);
-  OP(FG, C, D, A, B, 11, 14, 0x265e5a51);
-  OP(FG, B, C, D, A,  0, 20, 0xe9b6c7aa);
-  OP(FG, A, B, C, D,  5,  5, 0xd62f105d);
-  OP(FG, D, A, B, C, 10,  9, 0x02441453);
-  OP(FG, C, D, A, B, 15, 14, 0xd8a1e681);
-  OP(FG, B, C, D, A,  4, 20, 0xe7d3fbc8);
-  OP(FG, A, B, C, D,  9,  5, 0x21e1cde6);
-  OP(FG, D, A, B, C, 14,  9, 0xc33707d6);
-  OP(FG, C, D, A, B,  3, 14, 0xf4d50d87);
-  OP(FG, B, C, D, A,  8, 20, 0x455a14ed);
-  OP(FG, A, B, C, D, 13,  5, 0xa9e3e905);
-  OP(FG, D, A, B, C,  2,  9, 0xfcefa3f8);
-  OP(FG, C, D, A, B,  7, 14, 0x676f02d9);
-  OP(FG, B, C, D, A, 12, 20, 0x8d2a4c8a);
-
-  /* Round 3. */
-  OP(FH, A, B, C, D,  5,  4, 0xfffa3942);
-  OP(FH, D, A, B, C,  8, 11, 0x8771f681);
-  OP(FH, C, D, A, B, 11, 16, 0x6d9d6122);
-  OP(FH, B, C, D, A, 14, 23, 0xfde5380c);
-  OP(FH, A, B, C, D,  1,  4, 0xa4beea44);
-  OP(FH, D, A, B, C,  4, 11, 0x4bdecfa9);
-  OP(FH, C, D, A, B,  7, 16, 0xf6bb4b60);
-  OP(FH, B, C, D, A, 10, 23, 0xbebfbc70);
-  OP(FH, A, B, C, D, 13,  4, 0x289b7ec6);
-  OP(FH, D, A, B, C,  0, 11, 0xeaa127fa);
-  OP(FH, C, D, A, B,  3, 16, 0xd4ef3085);
-  OP(FH, B, C, D, A,  6, 23, 0x04881d05);
-  OP(FH, A, B, C, D,  9,  4, 0xd9d4d039);
-  OP(FH, D, A, B, C, 12, 11, 0xe6db99e5);
-  OP(FH, C, D, A, B, 15, 16, 0x1fa27cf8);
-  OP(FH, B, C, D, A,  2, 23, 0xc4ac5665);
-
-  /* Round 4.  */
-  OP(FI, A, B, C, D,  0,  6, 0xf4292244);
-  OP(FI, D, A, B, C,  7, 10, 0x432aff97);
-  OP(FI, C, D, A, B, 14, 15, 0xab9423a7);
-  OP(FI, B, C, D, A,  5, 21, 0xfc93a039);
-  OP(FI, A, B, C, D, 12,  6, 0x655b59c3);
-  OP(FI, D, A, B, C,  3, 10, 0x8f0ccc92);
-  OP(FI, C, D, A, B, 10, 15, 0xffeff47d);
-  OP(FI, B, C, D, A,  1, 21, 0x85845dd1);
-  OP(FI, A, B, C, D,  8,  6, 0x6fa87e4f);
-  OP(FI, D, A, B, C, 15, 10, 0xfe2ce6e0);
-  OP(FI, C, D, A, B,  6, 15, 0xa3014314);
-  OP(FI, B, C, D, A, 13, 21, 0x4e0811a1);
-  OP(FI, A, B, C, D,  4,  6, 0xf7537e82);
-  OP(FI, D, A, B, C, 11, 10, 0xbd3af235);
-  OP(FI, C, D, A, B,  2, 15, 0x2ad7d2bb);
-  OP(FI, B, C, D, A,  9, 21, 0xeb86d391);
+    do { a += f(b, c, d) + correct_words[k] + T; a = rol(a, s); a += b; } while (0)
+
+    /* Round 2. */
+    OP(FG, A, B, C, D,  1,  5, 0xf61e2562);
+    OP(FG, D, A, B, C,  6,  9, 0xc040b340);
+    OP(FG, C, D, A, B, 11, 14, 0x265e5a51);
+    OP(FG, B, C, D, A,  0, 20, 0xe9b6c7aa);
+    OP(FG, A, B, C, D,  5,  5, 0xd62f105d);
+    OP(FG, D, A, B, C, 10,  9, 0x02441453);
+    OP(FG, C, D, A, B, 15, 14, 0xd8a1e681);
+    OP(FG, B, C, D, A,  4, 20, 0xe7d3fbc8);
+    OP(FG, A, B, C, D,  9,  5, 0x21e1cde6);
+    OP(FG, D, A, B, C, 14,  9, 0xc33707d6);
+    OP(FG, C, D, A, B,  3, 14, 0xf4d50d87);
+    OP(FG, B, C, D, A,  8, 20, 0x455a14ed);
+    OP(FG, A, B, C, D, 13,  5, 0xa9e3e905);
+    OP(FG, D, A, B, C,  2,  9, 0xfcefa3f8);
+    OP(FG, C, D, A, B,  7, 14, 0x676f02d9);
+    OP(FG, B, C, D, A, 12, 20, 0x8d2a4c8a);
+
+    /* Round 3. */
+    OP(FH, A, B, C, D,  5,  4, 0xfffa3942);
+    OP(FH, D, A, B, C,  8, 11, 0x8771f681);
+    OP(FH, C, D, A, B, 11, 16, 0x6d9d6122);
+    OP(FH, B, C, D, A, 14, 23, 0xfde5380c);
+    OP(FH, A, B, C, D,  1,  4, 0xa4beea44);
+    OP(FH, D, A, B, C,  4, 11, 0x4bdecfa9);
+    OP(FH, C, D, A, B,  7, 16, 0xf6bb4b60);
+    OP(FH, B, C, D, A, 10, 23, 0xbebfbc70);
+    OP(FH, A, B, C, D, 13,  4, 0x289b7ec6);
+    OP(FH, D, A, B, C,  0, 11, 0xeaa127fa);
+    OP(FH, C, D, A, B,  3, 16, 0xd4ef3085);
+    OP(FH, B, C, D, A,  6, 23, 0x04881d05);
+    OP(FH, A, B, C, D,  9,  4, 0xd9d4d039);
+    OP(FH, D, A, B, C, 12, 11, 0xe6db99e5);
+    OP(FH, C, D, A, B, 15, 16, 0x1fa27cf8);
+    OP(FH, B, C, D, A,  2, 23, 0xc4ac5665);
+
+    /* Round 4.  */
+    OP(FI, A, B, C, D,  0,  6, 0xf4292244);
+    OP(FI, D, A, B, C,  7, 10, 0x432aff97);
+    OP(FI, C, D, A, B, 14, 15, 0xab9423a7);
+    OP(FI, B, C, D, A,  5, 21, 0xfc93a039);
+    OP(FI, A, B, C, D, 12,  6, 0x655b59c3);
+    OP(FI, D, A, B, C,  3, 10, 0x8f0ccc92);
+    OP(FI, C, D, A, B, 10, 15, 0xffeff47d);
+    OP(FI, B, C, D, A,  1, 21, 0x85845dd1);
+    OP(FI, A, B, C, D,  8,  6, 0x6fa87e4f);
+    OP(FI, D, A, B, C, 15, 10, 0xfe2ce6e0);
+    OP(FI, C, D, A, B,  6, 15, 0xa3014314);
+    OP(FI, B, C, D, A, 13, 21, 0x4e0811a1);
+    OP(FI, A, B, C, D,  4,  6, 0xf7537e82);
+    OP(FI, D, A, B, C, 11, 10, 0xbd3af235);
+    OP(FI, C, D, A, B,  2, 15, 0x2ad7d2bb);
+    OP(FI, B, C, D, A,  9, 21, 0xeb86d391);
+
+#undef OP
+
+    A += A0;
+    B += B0;
+    C += C0;
+    D += D0;
+  }
 
   /* Put checksum in context given as argument. */
-  ctx->A += A;
-  ctx->B += B;
-  ctx->C += C;
-  ctx->D += D;
+  ctx->A = A;
+  ctx->B = B;
+  ctx->C = C;
+  ctx->D = D;
 }
 
 /* The routine updates the message-digest context to
@@ -204,30 +220,38 @@ static void transform (MD5_CONTEXT *ctx, const unsigned char *data)
  * in the message whose digest is being computed. */
 void texpdf_MD5_write (MD5_CONTEXT *hd, const unsigned char *inbuf, unsigned long inlen)
 {
+  unsigned long n;
+
   if (hd->count == 64) { /* flush the buffer */
-    transform(hd, hd->buf);
-    _gcry_burn_stack(80+6*sizeof(void*));
+    transform(hd, hd->buf, 1);
     hd->count = 0;
     hd->nblocks++;
   }
   if (!inbuf) return;
   if (hd->count) {
-    for (; inlen && hd->count < 64; inlen--)
-      hd->buf[hd->count++] = *inbuf++;
-    texpdf_MD5_write(hd, NULL, 0);
+    n = 64 - hd->count;
+    if (n > inlen)
+      n = inlen;
+    memcpy(hd->buf + hd->count, inbuf, n);
+    hd->count += n;
+    inbuf += n;
+    inlen -= n;
     if (!inlen) return;
+    texpdf_MD5_write(hd, NULL, 0);
   }
-  _gcry_burn_stack(80+6*sizeof(void*));
-
-  while (inlen >= 64) {
-    transform(hd, inbuf);
-    hd->count = 0;
-    hd->nblocks++;
-    inlen -= 64;
-    inbuf += 64;
+  /*
+   * Whole blocks are hashed straight from the input; the stack is
+   * burned once, in texpdf_MD5_final(), not on every write.
+   */
+  n = inlen / 64;
+  if (n > 0) {
+    transform(hd, inbuf, n);
+    hd->nblocks += n;
+    inbuf += n * 64;
+    inlen -= n * 64;
   }
-  for (; inlen && hd->count < 64; inlen--)
-    hd->buf[hd->count++] = *inbuf++;
+  memcpy(hd->buf, inbuf, inlen);
+  hd->count = inlen;
 }
 
 /* The routine final terminates the message-digest computation and
@@ -273,7 +297,7 @@ void texpdf_MD5_final (unsigned char *outbuf, MD5_CONTEXT *hd)
   hd->buf[61] = (msb >> 8) & 0xff;
   hd->buf[62] = (msb >> 16) & 0xff;
   hd->buf[63] = (msb >> 24) & 0xff;
-  transform(hd, hd->buf);
+  transform(hd, hd->buf, 1);
   _gcry_burn_stack(80+6*sizeof(void*));
 
   p = outbuf; /* p = hd->buf; */
@@ -365,3 +389,533 @@ void ARC4_set_key (ARC4_KEY *ctx, unsigned int keylen, const unsigned char *key)
   do_arcfour_setkey(ctx, key, keylen);
   _gcry_burn_stack(300);
 }
+
+/*
+ * SHA-256, SHA-384 and SHA-512 (FIPS 180-4). The AESV3 security
+ * handler (revision 6) derives its keys from passwords with these.
+ */
+
+#define ror32(x,n) ( ((x) >> (n)) | ((x) << (32-(n))) )
+#define ror64(x,n) ( ((x) >> (n)) | ((x) << (64-(n))) )
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U,
+  0x3956c25bU, 0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U,
+  0xd807aa98U, 0x12835b01U, 0x243185beU, 0x550c7dc3U,
+  0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U, 0xc19bf174U,
+  0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU,
+  0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU,
+  0x983e5152U, 0xa831c66dU, 0xb00327c8U, 0xbf597fc7U,
+  0xc6e00bf3U, 0xd5a79147U, 0x06ca6351U, 0x14292967U,
+  0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU, 0x53380d13U,
+  0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+  0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U,
+  0xd192e819U, 0xd6990624U, 0xf40e3585U, 0x106aa070U,
+  0x19a4c116U, 0x1e376c08U, 0x2748774cU, 0x34b0bcb5U,
+  0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU, 0x682e6ff3U,
+  0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U,
+  0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U
+};
+
+void texpdf_SHA256_init (SHA256_CONTEXT *ctx)
+{
+  static const uint32_t h0[8] = {
+    0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+    0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+  };
+
+  memcpy(ctx->h, h0, sizeof(h0));
+  ctx->nbytes = 0;
+  ctx->count  = 0;
+}
+
+static void sha256_transform (SHA256_CONTEXT *ctx, const unsigned char *data)
+{
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++, data += 4)
+    w[i] = ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) |
+           ((uint32_t) data[2] << 8)  | data[3];
+  for (; i < 64; i++)
+    w[i] = w[i-16] + w[i-7] +
+           (ror32(w[i-15], 7) ^ ror32(w[i-15], 18) ^ (w[i-15] >> 3)) +
+           (ror32(w[i-2], 17) ^ ror32(w[i-2], 19)  ^ (w[i-2] >> 10));
+
+  a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3];
+  e = ctx->h[4]; f = ctx->h[5]; g = ctx->h[6]; h = ctx->h[7];
+  for (i = 0; i < 64; i++) {
+    t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) +
+         ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+    t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d;
+  ctx->h[4] += e; ctx->h[5] += f; ctx->h[6] += g; ctx->h[7] += h;
+}
+
+void texpdf_SHA256_write (SHA256_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen)
+{
+  ctx->nbytes += inlen;
+  if (ctx->count) {
+    for (; inlen && ctx->count < 64; inlen--)
+      ctx->buf[ctx->count++] = *inbuf++;
+    if (ctx->count < 64)
+      return;
+    sha256_transform(ctx, ctx->buf);
+    ctx->count = 0;
+  }
+  for (; inlen >= 64; inlen -= 64, inbuf += 64)
+    sha256_transform(ctx, inbuf);
+  memcpy(ctx->buf, inbuf, inlen);
+  ctx->count = inlen;
+}
+
+void texpdf_SHA256_final (unsigned char *outbuf, SHA256_CONTEXT *ctx)
+{
+  uint64_t bits = ctx->nbytes << 3;
+  int      i;
+
+  ctx->buf[ctx->count++] = 0x80;
+  if (ctx->count > 56) {
+    memset(ctx->buf + ctx->count, 0, 64 - ctx->count);
+    sha256_transform(ctx, ctx->buf);
+    ctx->count = 0;
+  }
+  memset(ctx->buf + ctx->count, 0, 56 - ctx->count);
+  for (i = 0; i < 8; i++)
+    ctx->buf[56 + i] = (unsigned char) (bits >> (56 - 8 * i));
+  sha256_transform(ctx, ctx->buf);
+
+  for (i = 0; i < 32; i++)
+    outbuf[i] = (unsigned char) (ctx->h[i / 4] >> (24 - 8 * (i % 4)));
+  _gcry_burn_stack(74*4+32);
+}
+
+static const uint64_t sha512_k[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+  0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+  0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+  0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+  0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+  0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+  0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+  0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+  0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+  0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+  0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+  0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+  0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+  0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+  0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+  0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+  0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+  0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+  0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+  0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+  0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+void texpdf_SHA512_init (SHA512_CONTEXT *ctx)
+{
+  static const uint64_t h0[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+  };
+
+  memcpy(ctx->h, h0, sizeof(h0));
+  ctx->nbytes = 0;
+  ctx->count  = 0;
+}
+
+void texpdf_SHA384_init (SHA512_CONTEXT *ctx)
+{
+  static const uint64_t h0[8] = {
+    0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+    0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+    0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+    0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+  };
+
+  memcpy(ctx->h, h0, sizeof(h0));
+  ctx->nbytes = 0;
+  ctx->count  = 0;
+}
+
+static void sha512_transform (SHA512_CONTEXT *ctx, const unsigned char *data)
+{
+  uint64_t w[80], a, b, c, d, e, f, g, h, t1, t2;
+  int i, j;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = 0;
+    for (j = 0; j < 8; j++)
+      w[i] = (w[i] << 8) | *data++;
+  }
+  for (; i < 80; i++)
+    w[i] = w[i-16] + w[i-7] +
+           (ror64(w[i-15], 1) ^ ror64(w[i-15], 8) ^ (w[i-15] >> 7)) +
+           (ror64(w[i-2], 19) ^ ror64(w[i-2], 61) ^ (w[i-2] >> 6));
+
+  a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3];
+  e = ctx->h[4]; f = ctx->h[5]; g = ctx->h[6]; h = ctx->h[7];
+  for (i = 0; i < 80; i++) {
+    t1 = h + (ror64(e, 14) ^ ror64(e, 18) ^ ror64(e, 41)) +
+         ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+    t2 = (ror64(a, 28) ^ ror64(a, 34) ^ ror64(a, 39)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d;
+  ctx->h[4] += e; ctx->h[5] += f; ctx->h[6] += g; ctx->h[7] += h;
+}
+
+void texpdf_SHA512_write (SHA512_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen)
+{
+  ctx->nbytes += inlen;
+  if (ctx->count) {
+    for (; inlen && ctx->count < 128; inlen--)
+      ctx->buf[ctx->count++] = *inbuf++;
+    if (ctx->count < 128)
+      return;
+    sha512_transform(ctx, ctx->buf);
+    ctx->count = 0;
+  }
+  for (; inlen >= 128; inlen -= 128, inbuf += 128)
+    sha512_transform(ctx, inbuf);
+  memcpy(ctx->buf, inbuf, inlen);
+  ctx->count = inlen;
+}
+
+static void sha512_finish (SHA512_CONTEXT *ctx, unsigned char *outbuf, int outlen)
+{
+  uint64_t bits = ctx->nbytes << 3;
+  int      i;
+
+  ctx->buf[ctx->count++] = 0x80;
+  if (ctx->count > 112) {
+    memset(ctx->buf + ctx->count, 0, 128 - ctx->count);
+    sha512_transform(ctx, ctx->buf);
+    ctx->count = 0;
+  }
+  /* The upper 64 bits of the 128-bit length are always zero here. */
+  memset(ctx->buf + ctx->count, 0, 120 - ctx->count);
+  for (i = 0; i < 8; i++)
+    ctx->buf[120 + i] = (unsigned char) (bits >> (56 - 8 * i));
+  sha512_transform(ctx, ctx->buf);
+
+  for (i = 0; i < outlen; i++)
+    outbuf[i] = (unsigned char) (ctx->h[i / 8] >> (56 - 8 * (i % 8)));
+  _gcry_burn_stack(90*8+32);
+}
+
+void texpdf_SHA512_final (unsigned char *outbuf, SHA512_CONTEXT *ctx)
+{
+  sha512_finish(ctx, outbuf, 64);
+}
+
+void texpdf_SHA384_final (unsigned char *outbuf, SHA512_CONTEXT *ctx)
+{
+  sha512_finish(ctx, outbuf, 48);
+}
+
+/*
+ * AES (FIPS 197) encryption with 128- and 256-bit keys. Each round
+ * is four lookups per column into tables that combine SubBytes,
+ * ShiftRows and MixColumns; the tables are built from the S-box on
+ * first use.
+ */
+
+static const unsigned char aes_sbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static uint32_t aes_te[4][256];
+static int      aes_te_ready = 0;
+
+static void aes_init_tables (void)
+{
+  int i;
+
+  for (i = 0; i < 256; i++) {
+    uint32_t s  = aes_sbox[i];
+    uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0)) & 0xff;
+    uint32_t s3 = s2 ^ s;
+    uint32_t t  = (s2 << 24) | (s << 16) | (s << 8) | s3;
+
+    aes_te[0][i] = t;
+    aes_te[1][i] = ror32(t, 8);
+    aes_te[2][i] = ror32(t, 16);
+    aes_te[3][i] = ror32(t, 24);
+  }
+  aes_te_ready = 1;
+}
+
+#define GETU32(p) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | \
+                   ((uint32_t) (p)[2] << 8)  | (uint32_t) (p)[3])
+#define PUTU32(p,v) do { (p)[0] = (unsigned char) ((v) >> 24); \
+                         (p)[1] = (unsigned char) ((v) >> 16); \
+                         (p)[2] = (unsigned char) ((v) >> 8);  \
+                         (p)[3] = (unsigned char) (v); } while (0)
+#define SUBWORD(x) (((uint32_t) aes_sbox[(x) >> 24] << 24) | \
+                    ((uint32_t) aes_sbox[((x) >> 16) & 0xff] << 16) | \
+                    ((uint32_t) aes_sbox[((x) >> 8) & 0xff] << 8) | \
+                    (uint32_t) aes_sbox[(x) & 0xff])
+
+void texpdf_AES_set_key (AES_CONTEXT *ctx, unsigned int keylen, const unsigned char *key)
+{
+  uint32_t rcon = 0x01000000U, t;
+  int      nk, i;
+
+  if (!aes_te_ready)
+    aes_init_tables();
+
+  nk = (keylen == 32) ? 8 : 4;
+  ctx->nrounds = nk + 6;
+  for (i = 0; i < nk; i++)
+    ctx->rk[i] = GETU32(key + 4 * i);
+  for (; i < 4 * (ctx->nrounds + 1); i++) {
+    t = ctx->rk[i-1];
+    if (i % nk == 0) {
+      t = SUBWORD((t << 8) | (t >> 24)) ^ rcon;
+      rcon = ((rcon << 1) ^ ((rcon & 0x80000000U) ? 0x1b000000U : 0)) & 0xff000000U;
+    } else if (nk > 6 && i % nk == 4) {
+      t = SUBWORD(t);
+    }
+    ctx->rk[i] = ctx->rk[i-nk] ^ t;
+  }
+}
+
+void texpdf_AES_ecb_encrypt (AES_CONTEXT *ctx, const unsigned char *inbuf, unsigned char *outbuf)
+{
+  const uint32_t *rk = ctx->rk;
+  uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+  int      r;
+
+  s0 = GETU32(inbuf)      ^ rk[0];
+  s1 = GETU32(inbuf + 4)  ^ rk[1];
+  s2 = GETU32(inbuf + 8)  ^ rk[2];
+  s3 = GETU32(inbuf + 12) ^ rk[3];
+  for (r = 1; r < ctx->nrounds; r++) {
+    rk += 4;
+    t0 = aes_te[0][s0 >> 24] ^ aes_te[1][(s1 >> 16) & 0xff] ^
+         aes_te[2][(s2 >> 8) & 0xff] ^ aes_te[3][s3 & 0xff] ^ rk[0];
+    t1 = aes_te[0][s1 >> 24] ^ aes_te[1][(s2 >> 16) & 0xff] ^
+         aes_te[2][(s3 >> 8) & 0xff] ^ aes_te[3][s0 & 0xff] ^ rk[1];
+    t2 = aes_te[0][s2 >> 24] ^ aes_te[1][(s3 >> 16) & 0xff] ^
+         aes_te[2][(s0 >> 8) & 0xff] ^ aes_te[3][s1 & 0xff] ^ rk[2];
+    t3 = aes_te[0][s3 >> 24] ^ aes_te[1][(s0 >> 16) & 0xff] ^
+         aes_te[2][(s1 >> 8) & 0xff] ^ aes_te[3][s2 & 0xff] ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+  rk += 4;
+  t0 = ((uint32_t) aes_sbox[s0 >> 24] << 24) ^ ((uint32_t) aes_sbox[(s1 >> 16) & 0xff] << 16) ^
+       ((uint32_t) aes_sbox[(s2 >> 8) & 0xff] << 8) ^ aes_sbox[s3 & 0xff] ^ rk[0];
+  t1 = ((uint32_t) aes_sbox[s1 >> 24] << 24) ^ ((uint32_t) aes_sbox[(s2 >> 16) & 0xff] << 16) ^
+       ((uint32_t) aes_sbox[(s3 >> 8) & 0xff] << 8) ^ aes_sbox[s0 & 0xff] ^ rk[1];
+  t2 = ((uint32_t) aes_sbox[s2 >> 24] << 24) ^ ((uint32_t) aes_sbox[(s3 >> 16) & 0xff] << 16) ^
+       ((uint32_t) aes_sbox[(s0 >> 8) & 0xff] << 8) ^ aes_sbox[s1 & 0xff] ^ rk[2];
+  t3 = ((uint32_t) aes_sbox[s3 >> 24] << 24) ^ ((uint32_t) aes_sbox[(s0 >> 16) & 0xff] << 16) ^
+       ((uint32_t) aes_sbox[(s1 >> 8) & 0xff] << 8) ^ aes_sbox[s2 & 0xff] ^ rk[3];
+  PUTU32(outbuf,      t0);
+  PUTU32(outbuf + 4,  t1);
+  PUTU32(outbuf + 8,  t2);
+  PUTU32(outbuf + 12, t3);
+}
+
+void texpdf_AES_cbc_encrypt (AES_CONTEXT *ctx, unsigned char *iv,
+                             unsigned long len, const unsigned char *inbuf, unsigned char *outbuf)
+{
+  int i;
+
+  for (; len >= 16; len -= 16, inbuf += 16, outbuf += 16) {
+    for (i = 0; i < 16; i++)
+      iv[i] ^= inbuf[i];
+    texpdf_AES_ecb_encrypt(ctx, iv, iv);
+    memcpy(outbuf, iv, 16);
+  }
+}
+
+/*
+ * 64-bit non-cryptographic hash for dedup and cache keys: XXH64 by
+ * Yann Collet (BSD licence), written incrementally. It is several times
+ * faster than MD5, so it should be used wherever no digest format is
+ * mandated by the PDF specification.
+ */
+
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+
+#define rol64(x,n) ( ((x) << (n)) | ((x) >> (64-(n))) )
+
+static uint64_t xxh_read64 (const unsigned char *p)
+{
+#ifdef WORDS_BIGENDIAN
+  return (uint64_t) p[0]       | (uint64_t) p[1] << 8  |
+         (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24 |
+         (uint64_t) p[4] << 32 | (uint64_t) p[5] << 40 |
+         (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56;
+#else
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+#endif
+}
+
+static uint32_t xxh_read32 (const unsigned char *p)
+{
+  return (uint32_t) p[0]       | (uint32_t) p[1] << 8 |
+         (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint64_t xxh_round (uint64_t acc, uint64_t input)
+{
+  acc += input * XXH_P2;
+  acc  = rol64(acc, 31);
+  return acc * XXH_P1;
+}
+
+static uint64_t xxh_merge (uint64_t acc, uint64_t val)
+{
+  acc ^= xxh_round(0, val);
+  return acc * XXH_P1 + XXH_P4;
+}
+
+void texpdf_HASH64_init (HASH64_CONTEXT *ctx, uint64_t seed)
+{
+  ctx->v[0] = seed + XXH_P1 + XXH_P2;
+  ctx->v[1] = seed + XXH_P2;
+  ctx->v[2] = seed;
+  ctx->v[3] = seed - XXH_P1;
+  ctx->seed = seed;
+  ctx->nbytes = 0;
+  ctx->count  = 0;
+}
+
+void texpdf_HASH64_write (HASH64_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen)
+{
+  uint64_t v0, v1, v2, v3;
+
+  ctx->nbytes += inlen;
+  if (ctx->count + inlen < 32) {
+    memcpy(ctx->buf + ctx->count, inbuf, inlen);
+    ctx->count += inlen;
+    return;
+  }
+
+  v0 = ctx->v[0]; v1 = ctx->v[1]; v2 = ctx->v[2]; v3 = ctx->v[3];
+  if (ctx->count) {
+    unsigned long n = 32 - ctx->count;
+
+    memcpy(ctx->buf + ctx->count, inbuf, n);
+    inbuf += n;
+    inlen -= n;
+    v0 = xxh_round(v0, xxh_read64(ctx->buf));
+    v1 = xxh_round(v1, xxh_read64(ctx->buf + 8));
+    v2 = xxh_round(v2, xxh_read64(ctx->buf + 16));
+    v3 = xxh_round(v3, xxh_read64(ctx->buf + 24));
+    ctx->count = 0;
+  }
+  for (; inlen >= 32; inlen -= 32, inbuf += 32) {
+    v0 = xxh_round(v0, xxh_read64(inbuf));
+    v1 = xxh_round(v1, xxh_read64(inbuf + 8));
+    v2 = xxh_round(v2, xxh_read64(inbuf + 16));
+    v3 = xxh_round(v3, xxh_read64(inbuf + 24));
+  }
+  ctx->v[0] = v0; ctx->v[1] = v1; ctx->v[2] = v2; ctx->v[3] = v3;
+
+  memcpy(ctx->buf, inbuf, inlen);
+  ctx->count = inlen;
+}
+
+uint64_t texpdf_HASH64_final (const HASH64_CONTEXT *ctx)
+{
+  const unsigned char *p = ctx->buf, *end = ctx->buf + ctx->count;
+  uint64_t h;
+
+  if (ctx->nbytes >= 32) {
+    h = rol64(ctx->v[0], 1) + rol64(ctx->v[1], 7) +
+        rol64(ctx->v[2], 12) + rol64(ctx->v[3], 18);
+    h = xxh_merge(h, ctx->v[0]);
+    h = xxh_merge(h, ctx->v[1]);
+    h = xxh_merge(h, ctx->v[2]);
+    h = xxh_merge(h, ctx->v[3]);
+  } else {
+    h = ctx->seed + XXH_P5;
+  }
+  h += ctx->nbytes;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0, xxh_read64(p));
+    h  = rol64(h, 27) * XXH_P1 + XXH_P4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t) xxh_read32(p) * XXH_P1;
+    h  = rol64(h, 23) * XXH_P2 + XXH_P3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p) * XXH_P5;
+    h  = rol64(h, 11) * XXH_P1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_P2;
+  h ^= h >> 29;
+  h *= XXH_P3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+uint64_t texpdf_HASH64 (const unsigned char *data, unsigned long len, uint64_t seed)
+{
+  HASH64_CONTEXT ctx;
+
+  texpdf_HASH64_init(&ctx, seed);
+  texpdf_HASH64_write(&ctx, data, len);
+
+  return texpdf_HASH64_final(&ctx);
+}
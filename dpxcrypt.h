@@ -19,7 +19,7 @@
 */
 /**
 @file
-@brief MD5 functions borrowed from libgcrypt.
+@brief MD5 and ARC4 functions borrowed from libgcrypt, plus SHA-2, AES and XXH64.
 */
 
 #ifndef _DPXCRYPT_H_
@@ -66,4 +66,64 @@ typedef struct {
 void ARC4 (ARC4_KEY *ctx, unsigned long len, const unsigned char *inbuf, unsigned char *outbuf);
 void ARC4_set_key (ARC4_KEY *ctx, unsigned int keylen, const unsigned char *key);
 
+/* SHA-256, and SHA-384/SHA-512 sharing one context type */
+typedef struct {
+  uint32_t h[8];
+  uint64_t nbytes;
+  unsigned char buf[64];
+  int count;
+} SHA256_CONTEXT;
+
+typedef struct {
+  uint64_t h[8];
+  uint64_t nbytes;
+  unsigned char buf[128];
+  int count;
+} SHA512_CONTEXT;
+
+void texpdf_SHA256_init  (SHA256_CONTEXT *ctx);
+void texpdf_SHA256_write (SHA256_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen);
+/** Writes the 32-byte digest to outbuf. */
+void texpdf_SHA256_final (unsigned char *outbuf, SHA256_CONTEXT *ctx);
+
+void texpdf_SHA384_init  (SHA512_CONTEXT *ctx);
+/** Writes the 48-byte digest to outbuf. */
+void texpdf_SHA384_final (unsigned char *outbuf, SHA512_CONTEXT *ctx);
+void texpdf_SHA512_init  (SHA512_CONTEXT *ctx);
+void texpdf_SHA512_write (SHA512_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen);
+/** Writes the 64-byte digest to outbuf. */
+void texpdf_SHA512_final (unsigned char *outbuf, SHA512_CONTEXT *ctx);
+
+/* AES encryption, 128- or 256-bit keys */
+typedef struct {
+  int      nrounds;
+  uint32_t rk[60];
+} AES_CONTEXT;
+
+void texpdf_AES_set_key     (AES_CONTEXT *ctx, unsigned int keylen, const unsigned char *key);
+/** Encrypts one 16-byte block; inbuf and outbuf may be the same. */
+void texpdf_AES_ecb_encrypt (AES_CONTEXT *ctx, const unsigned char *inbuf, unsigned char *outbuf);
+/** CBC-encrypts len bytes, a multiple of 16, without padding.
+  inbuf and outbuf may be the same. iv is updated to the last
+  ciphertext block, so long data can be encrypted in pieces. */
+void texpdf_AES_cbc_encrypt (AES_CONTEXT *ctx, unsigned char *iv,
+                             unsigned long len, const unsigned char *inbuf, unsigned char *outbuf);
+
+/* XXH64, a fast 64-bit non-cryptographic hash for stream dedup */
+typedef struct {
+  uint64_t v[4];
+  uint64_t seed;
+  uint64_t nbytes;
+  unsigned char buf[32];
+  int count;
+} HASH64_CONTEXT;
+
+void     texpdf_HASH64_init  (HASH64_CONTEXT *ctx, uint64_t seed);
+void     texpdf_HASH64_write (HASH64_CONTEXT *ctx, const unsigned char *inbuf, unsigned long inlen);
+/** Returns the hash of everything written so far. The context is not
+  changed, so data may still be added afterwards. */
+uint64_t texpdf_HASH64_final (const HASH64_CONTEXT *ctx);
+/** One-shot hash of len bytes. */
+uint64_t texpdf_HASH64       (const unsigned char *data, unsigned long len, uint64_t seed);
+
 #endif /* _DPXCRYPT_H_ */
@@ -448,6 +448,51 @@ dpx_create_temp_file (void)
   return  tmp;
 }
 
+/*
+ * Opens a new, uniquely named file for writing in the same directory
+ * as filename, to be renamed over it once complete. Concurrent writers
+ * of the same file never share a temporary file.
+ */
+FILE *
+dpx_open_temp_file (const char *filename, char **tmpname)
+{
+  FILE *fp = NULL;
+  char *tmp;
+#ifdef HAVE_MKSTEMP
+  int   fd;
+
+  tmp = NEW(strlen(filename) + 8, char);
+  sprintf(tmp, "%s.XXXXXX", filename);
+  fd = mkstemp(tmp);
+  if (fd != -1) {
+    mode_t mask = umask(0);
+
+    /* mkstemp() creates the file private to the user; use the usual mode. */
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    fp = fdopen(fd, FOPEN_WBIN_MODE);
+    if (!fp) {
+      close(fd);
+      remove(tmp);
+    }
+  }
+#else
+  static unsigned long serial = 0;
+
+  tmp = NEW(strlen(filename) + 48, char);
+  sprintf(tmp, "%s.%lu.%lu", filename, (unsigned long) getpid(), serial++);
+  fp = fopen(tmp, FOPEN_WBIN_MODE);
+#endif
+
+  if (!fp) {
+    RELEASE(tmp);
+    tmp = NULL;
+  }
+  *tmpname = tmp;
+
+  return fp;
+}
+
 char *
 dpx_create_fix_temp_file (const char *filename)
 {
@@ -63,6 +63,7 @@ extern int   dpx_file_apply_filter (const char *cmdtmpl,
                                    unsigned char version);
 extern char *dpx_create_temp_file  (void);
 extern char *dpx_create_fix_temp_file (const char *filename);
+extern FILE *dpx_open_temp_file    (const char *filename, char **tmpname);
 extern void  dpx_delete_old_cache  (int life);
 extern void  dpx_delete_temp_file  (char *tmp, int force); /* tmp freed here */
 
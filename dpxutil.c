@@ -161,48 +161,49 @@ texpdf_skip_white_spaces (unsigned char **s, unsigned char *endptr)
       (*s)++;
 }
 
+#define HT_EMPTY    -1
+#define HT_REMOVED  -2
+#define HT_MIN_SLOTS 16
+
 void
 texpdf_ht_init_table (struct ht_table *ht, hval_free_func hval_free_fn)
 {
-  int  i;
-
   ASSERT(ht);
 
-  for (i = 0; i < HASH_TABLE_SIZE; i++) {
-    ht->table[i] = NULL;
-  }
-  ht->count = 0;
+  ht->count        = 0;
   ht->hval_free_fn = hval_free_fn;
+  ht->entries      = NULL;
+  ht->num_entries  = 0;
+  ht->max_entries  = 0;
+  ht->slots        = NULL;
+  ht->num_slots    = 0;
+  ht->used_slots   = 0;
 }
 
 void
 texpdf_ht_clear_table (struct ht_table *ht)
 {
-  int   i;
+  long  i;
 
   ASSERT(ht);
 
-  for (i = 0; i < HASH_TABLE_SIZE; i++) {
-    struct ht_entry *hent, *next;
+  for (i = 0; i < ht->num_entries; i++) {
+    struct ht_entry *hent = &ht->entries[i];
 
-    hent = ht->table[i];
-    while (hent) {
-      if (hent->value && ht->hval_free_fn) {
-	ht->hval_free_fn(hent->value);
-      }
-      hent->value  = NULL;
-      if (hent->key) {
-	RELEASE(hent->key);
-      }
-      hent->key = NULL;
-      next = hent->next;
-      RELEASE(hent);
-      hent = next;
+    if (!hent->key)
+      continue;
+    if (hent->value && ht->hval_free_fn) {
+      ht->hval_free_fn(hent->value);
     }
-    ht->table[i] = NULL;
+    hent->value = NULL;
+    RELEASE(hent->key);
+    hent->key = NULL;
   }
-  ht->count = 0;
-  ht->hval_free_fn = NULL;
+  if (ht->entries)
+    RELEASE(ht->entries);
+  if (ht->slots)
+    RELEASE(ht->slots);
+  texpdf_ht_init_table(ht, NULL);
 }
 
 long ht_table_size (struct ht_table *ht)
@@ -212,38 +213,121 @@ long ht_table_size (struct ht_table *ht)
   return ht->count;
 }
 
+/* FNV-1a */
 static unsigned int
 get_hash (const void *key, int keylen)
 {
-  unsigned int hkey = 0;
+  const unsigned char *p = key;
+  unsigned int hkey = 2166136261u;
   int      i;
 
   for (i = 0; i < keylen; i++) {
-    hkey = (hkey << 5) + hkey + ((const char *)key)[i];
+    hkey ^= p[i];
+    hkey *= 16777619u;
   }
 
-  return (hkey % HASH_TABLE_SIZE);
+  return hkey;
 }
 
-void *
-texpdf_ht_lookup_table (struct ht_table *ht, const void *key, int keylen)
+/* Returns the slot holding key, or -1. */
+static long
+find_slot (struct ht_table *ht, const void *key, int keylen, unsigned int hval)
 {
-  struct ht_entry *hent;
-  unsigned int     hkey;
+  long  mask, i, e;
 
-  ASSERT(ht && key);
+  if (ht->num_slots == 0)
+    return -1;
 
-  hkey = get_hash(key, keylen);
-  hent = ht->table[hkey];
-  while (hent) {
-    if (hent->keylen == keylen &&
+  mask = ht->num_slots - 1;
+  for (i = hval & mask; (e = ht->slots[i]) != HT_EMPTY; i = (i + 1) & mask) {
+    struct ht_entry *hent;
+
+    if (e == HT_REMOVED)
+      continue;
+    hent = &ht->entries[e];
+    if (hent->hval == hval && hent->keylen == keylen &&
 	!memcmp(hent->key, key, keylen)) {
-      return hent->value;
+      return i;
     }
-    hent = hent->next;
   }
 
-  return NULL;
+  return -1;
+}
+
+/* Entries later in insertion order always probe further along, so a
+ * lookup of a key appended twice finds the first one.
+ */
+static void
+place_entry (struct ht_table *ht, long e)
+{
+  long  mask, i;
+
+  mask = ht->num_slots - 1;
+  for (i = ht->entries[e].hval & mask;
+       ht->slots[i] != HT_EMPTY; i = (i + 1) & mask);
+  ht->slots[i] = e;
+  ht->used_slots++;
+}
+
+/* Drop removed entries and rehash into a table sized for count + 1. */
+static void
+rehash_table (struct ht_table *ht)
+{
+  long  num_slots, i, j;
+
+  for (i = 0, j = 0; i < ht->num_entries; i++) {
+    if (ht->entries[i].key)
+      ht->entries[j++] = ht->entries[i];
+  }
+  ht->num_entries = j;
+
+  for (num_slots = HT_MIN_SLOTS;
+       num_slots < 2 * (ht->count + 1); num_slots <<= 1);
+  if (num_slots != ht->num_slots) {
+    ht->num_slots = num_slots;
+    ht->slots     = RENEW(ht->slots, num_slots, long);
+  }
+  for (i = 0; i < num_slots; i++)
+    ht->slots[i] = HT_EMPTY;
+  ht->used_slots = 0;
+  for (i = 0; i < ht->num_entries; i++)
+    place_entry(ht, i);
+}
+
+static void
+add_entry (struct ht_table *ht,
+	   const void *key, int keylen, unsigned int hval, void *value)
+{
+  struct ht_entry *hent;
+
+  if (2 * (ht->used_slots + 1) > ht->num_slots)
+    rehash_table(ht);
+  if (ht->num_entries >= ht->max_entries) {
+    ht->max_entries += MAX(HT_MIN_SLOTS, ht->max_entries);
+    ht->entries = RENEW(ht->entries, ht->max_entries, struct ht_entry);
+  }
+
+  hent = &ht->entries[ht->num_entries];
+  hent->key = NEW(keylen, char);
+  memcpy(hent->key, key, keylen);
+  hent->keylen = keylen;
+  hent->hval   = hval;
+  hent->value  = value;
+  place_entry(ht, ht->num_entries++);
+
+  ht->count++;
+}
+
+void *
+texpdf_ht_lookup_table (struct ht_table *ht, const void *key, int keylen)
+{
+  long  slot;
+
+  ASSERT(ht && key);
+
+  slot = find_slot(ht, key, keylen, get_hash(key, keylen));
+
+  return slot < 0 ? NULL : ht->entries[ht->slots[slot]].value;
 }
 
 int
@@ -251,41 +335,27 @@ ht_remove_table (struct ht_table *ht,
 		 const void *key, int keylen)
 /* returns 1 if the element was found and removed and 0 otherwise */
 {
-  struct ht_entry *hent, *prev;
-  unsigned int     hkey;
+  struct ht_entry *hent;
+  long   slot;
 
   ASSERT(ht && key);
 
-  hkey = get_hash(key, keylen);
-  hent = ht->table[hkey];
-  prev = NULL;
-  while (hent) {
-    if (hent->keylen == keylen &&
-	!memcmp(hent->key, key, keylen)) {
-      break;
-    }
-    prev = hent;
-    hent = hent->next;
-  }
-  if (hent) {
-    if (hent->key)
-      RELEASE(hent->key);
-    hent->key    = NULL;
-    hent->keylen = 0;
-    if (hent->value && ht->hval_free_fn) {
-      ht->hval_free_fn(hent->value);
-    }
-    hent->value  = NULL;
-    if (prev) {
-      prev->next = hent->next;
-    } else {
-      ht->table[hkey] = hent->next;
-    }
-    RELEASE(hent);
-    ht->count--;
-    return 1;
-  } else
+  slot = find_slot(ht, key, keylen, get_hash(key, keylen));
+  if (slot < 0)
     return 0;
+
+  hent = &ht->entries[ht->slots[slot]];
+  RELEASE(hent->key);
+  hent->key    = NULL;
+  hent->keylen = 0;
+  if (hent->value && ht->hval_free_fn) {
+    ht->hval_free_fn(hent->value);
+  }
+  hent->value  = NULL;
+  ht->slots[slot] = HT_REMOVED;
+  ht->count--;
+
+  return 1;
 }
 
 /* replace... */
@@ -293,39 +363,21 @@ void
 ht_insert_table (struct ht_table *ht,
 		 const void *key, int keylen, void *value)
 {
-  struct ht_entry *hent, *prev;
-  unsigned int     hkey;
+  unsigned int hval;
+  long   slot;
 
   ASSERT(ht && key);
 
-  hkey = get_hash(key, keylen);
-  hent = ht->table[hkey];
-  prev = NULL;
-  while (hent) {
-    if (hent->keylen == keylen &&
-	!memcmp(hent->key, key, keylen)) {
-      break;
-    }
-    prev = hent;
-    hent = hent->next;
-  }
-  if (hent) {
-      if (hent->value && ht->hval_free_fn)
-	ht->hval_free_fn(hent->value);
-      hent->value  = value;
+  hval = get_hash(key, keylen);
+  slot = find_slot(ht, key, keylen, hval);
+  if (slot >= 0) {
+    struct ht_entry *hent = &ht->entries[ht->slots[slot]];
+
+    if (hent->value && ht->hval_free_fn)
+      ht->hval_free_fn(hent->value);
+    hent->value = value;
   } else {
-    hent = NEW(1, struct ht_entry);
-    hent->key = NEW(keylen, char);
-    memcpy(hent->key, key, keylen);
-    hent->keylen = keylen;
-    hent->value  = value;
-    hent->next   = NULL;
-    if (prev) {
-      prev->next      = hent;
-    } else {
-      ht->table[hkey] = hent;
-    }
-    ht->count++;
+    add_entry(ht, key, keylen, hval, value);
   }
 }
 
@@ -333,42 +385,21 @@ void
 texpdf_ht_append_table (struct ht_table *ht,
 		 const void *key, int keylen, void *value) 
 {
-  struct ht_entry *hent, *last;
-  unsigned int hkey;
-
-  hkey = get_hash(key, keylen);
-  hent = ht->table[hkey];
-  if (!hent) {
-    hent = NEW(1, struct ht_entry);
-    ht->table[hkey] = hent;
-  } else {
-    while (hent) {
-      last = hent;
-      hent = hent->next;
-    }
-    hent = NEW(1, struct ht_entry);
-    last->next = hent;
-  }
-  hent->key = NEW(keylen, char);
-  memcpy(hent->key, key, keylen);
-  hent->keylen = keylen;
-  hent->value  = value;
-  hent->next   = NULL;
+  ASSERT(ht && key);
 
-  ht->count++;
+  add_entry(ht, key, keylen, get_hash(key, keylen), value);
 }
 
 int
 ht_set_iter (struct ht_table *ht, struct ht_iter *iter)
 {
-  int    i;
+  long   i;
 
-  ASSERT(ht && ht->table && iter);
+  ASSERT(ht && iter);
 
-  for (i = 0; i < HASH_TABLE_SIZE; i++) {
-    if (ht->table[i]) {
+  for (i = 0; i < ht->num_entries; i++) {
+    if (ht->entries[i].key) {
       iter->index = i;
-      iter->curr  = ht->table[i];
       iter->hash  = ht;
       return 0;
     }
@@ -381,19 +412,28 @@ void
 ht_clear_iter (struct ht_iter *iter)
 {
   if (iter) {
-    iter->index = HASH_TABLE_SIZE;
-    iter->curr  = NULL;
+    iter->index = -1;
     iter->hash  = NULL;
   }
 }
 
+static struct ht_entry *
+iter_entry (struct ht_iter *iter)
+{
+  if (!iter || !iter->hash ||
+      iter->index < 0 || iter->index >= iter->hash->num_entries)
+    return NULL;
+
+  return &iter->hash->entries[iter->index];
+}
+
 char *
 ht_iter_getkey (struct ht_iter *iter, int *keylen)
 {
   struct ht_entry *hent;
 
-  hent = (struct ht_entry *) iter->curr;
-  if (iter && hent) {
+  hent = iter_entry(iter);
+  if (hent) {
     *keylen = hent->keylen;
     return hent->key;
   } else {
@@ -407,32 +447,25 @@ ht_iter_getval (struct ht_iter *iter)
 {
   struct ht_entry *hent;
 
-  hent = (struct ht_entry *) iter->curr;
-  if (iter && hent) {
-    return hent->value;
-  } else {
-    return NULL;
-  }
+  hent = iter_entry(iter);
+
+  return hent ? hent->value : NULL;
 }
 
 int
 ht_iter_next (struct ht_iter *iter)
 {
-  struct ht_entry *hent;
   struct ht_table *ht;
 
-  ASSERT(iter);
+  ASSERT(iter && iter->hash);
 
-  ht   = iter->hash;
-  hent = (struct ht_entry *) iter->curr;
-  hent = hent->next;
-  while (!hent &&
-         ++iter->index < HASH_TABLE_SIZE) {
-    hent = ht->table[iter->index];
+  ht = iter->hash;
+  while (++iter->index < ht->num_entries) {
+    if (ht->entries[iter->index].key)
+      return 0;
   }
-  iter->curr = hent;
 
-  return (hent ? 0 : -1);
+  return -1;
 }
 
 
@@ -54,15 +54,18 @@ extern unsigned char ostrtouc (unsigned char **inbuf,
 extern unsigned char esctouc  (unsigned char **inbuf,
 			       unsigned char *inbufend, unsigned char *valid);
 
-#define HASH_TABLE_SIZE 503
-
+/*
+ * Open-addressing hash table. Entries are kept in insertion order and
+ * iterated in that order; slots index into them and are probed
+ * linearly. The slot array doubles to keep the load below one half.
+ * A zero-filled table is a valid empty table.
+ */
 struct ht_entry {
-  char  *key;
+  char  *key;    /* NULL if the entry was removed */
   int    keylen;
+  unsigned int hval;
 
   void  *value;
-
-  struct ht_entry *next;
 };
 
 typedef void (*hval_free_func) (void *);
@@ -70,7 +73,12 @@ typedef void (*hval_free_func) (void *);
 struct ht_table {
   long   count;
   hval_free_func hval_free_fn;
-  struct ht_entry *table[HASH_TABLE_SIZE];
+
+  struct ht_entry *entries;
+  long   num_entries, max_entries;
+
+  long  *slots;
+  long   num_slots, used_slots;
 };
 
 extern void  texpdf_ht_init_table   (struct ht_table *ht,
@@ -87,8 +95,7 @@ extern void  ht_insert_table (struct ht_table *ht,
 			      const void *key, int keylen, void *value);
 
 struct ht_iter {
-  int    index;
-  void  *curr;
+  long   index;
   struct ht_table *hash;
 };
 
@@ -111,14 +111,13 @@ static pdf_obj*
 texpdf_get_page_obj (pdf_file *pf, long page_no,
                   pdf_obj **ret_bbox, pdf_obj **ret_resources)
 {
-  pdf_obj *page_tree;
+  pdf_obj *page_tree, *page_index;
   pdf_obj *bbox = NULL, *resources = NULL, *rotate = NULL;
   long page_idx;
 
   /*
    * Get Page Tree.
    */
-  page_tree = NULL;
   {
     pdf_obj *trailer, *catalog;
     pdf_obj *markinfo, *tmp;
@@ -130,17 +129,9 @@ texpdf_get_page_obj (pdf_file *pf, long page_no,
       texpdf_release_obj(trailer);
       return NULL;
     }
-
-    catalog = pdf_deref_obj(texpdf_lookup_dict(trailer, "Root"));
-    if (!PDF_OBJ_DICTTYPE(catalog)) {
-      WARN("Can't read document catalog.");
-      texpdf_release_obj(trailer);
-      if (catalog)
-	texpdf_release_obj(catalog);
-      return NULL;
-    }
     texpdf_release_obj(trailer);
 
+    catalog = pdf_file_get_catalog(pf);
     markinfo = pdf_deref_obj(texpdf_lookup_dict(catalog, "MarkInfo"));
     if (markinfo) {
       tmp = texpdf_lookup_dict(markinfo, "Marked");
@@ -148,11 +139,13 @@ texpdf_get_page_obj (pdf_file *pf, long page_no,
 	WARN("File contains tagged PDF. Ignoring tags.");
       texpdf_release_obj(markinfo);
     }
-
-    page_tree = pdf_deref_obj(texpdf_lookup_dict(catalog, "Pages"));
-    texpdf_release_obj(catalog);
   }
-  if (!page_tree) {
+
+  /*
+   * Get the flattened page tree.
+   */
+  page_index = texpdf_doc_get_page_index(pf);
+  if (!page_index) {
     WARN("Page tree not found.");
     return NULL;
   }
@@ -161,124 +154,60 @@ texpdf_get_page_obj (pdf_file *pf, long page_no,
    * Negative page numbers are counted from the back.
    */
   {
-    long count = texpdf_number_value(texpdf_lookup_dict(page_tree, "Count"));
+    long count = texpdf_array_length(page_index);
     page_idx = page_no + (page_no >= 0 ? -1 : count);
     if (page_idx < 0 || page_idx >= count) {
 	WARN("Page %ld does not exist.", page_no);
-	texpdf_release_obj(page_tree);
 	return NULL;
       }
     page_no = page_idx+1;
   }
 
   /*
-   * Seek correct page. Get Media/Crop Box.
-   * Media box and resources can be inherited.
+   * Get Media/Crop Box.
+   * Media box and resources are inherited.
    */
   {
-    pdf_obj *kids_ref, *kids;
-    pdf_obj *crop_box = NULL;
-    pdf_obj *tmp;
+    pdf_obj *entry, *tmp;
 
-    tmp = texpdf_lookup_dict(page_tree, "Resources");
-    resources = tmp ? pdf_deref_obj(tmp) : texpdf_new_dict();
+    entry     = texpdf_get_array(page_index, page_idx);
+    page_tree = texpdf_link_obj(texpdf_lookup_dict(entry, "Page"));
 
-    while (1) {
-      long kids_length, i;
- 
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "MediaBox")))) {
+    tmp = texpdf_lookup_dict(entry, "Resources");
+    resources = tmp ? texpdf_link_obj(tmp) : texpdf_new_dict();
+    if ((tmp = texpdf_lookup_dict(entry, "Rotate")))
+      rotate = texpdf_link_obj(tmp);
+    if ((tmp = texpdf_lookup_dict(entry, "MediaBox")))
+      bbox = texpdf_link_obj(tmp);
+
+    if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "BleedBox")))) {
+      if (!rect_equal(tmp, bbox)) {
 	if (bbox)
 	  texpdf_release_obj(bbox);
 	bbox = tmp;
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "BleedBox")))) {
-        if (!rect_equal(tmp, bbox)) {
-	  if (bbox)
-	    texpdf_release_obj(bbox);
-	  bbox = tmp;
-        } else
-          texpdf_release_obj(tmp);
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "TrimBox")))) {
-        if (!rect_equal(tmp, bbox)) {
-	  if (bbox)
-	    texpdf_release_obj(bbox);
-	  bbox = tmp;
-        } else
-          texpdf_release_obj(tmp);
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "ArtBox")))) {
-        if (!rect_equal(tmp, bbox)) {
-	  if (bbox)
-	    texpdf_release_obj(bbox);
-	  bbox = tmp;
-        } else
-          texpdf_release_obj(tmp);
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "CropBox")))) {
-	if (crop_box)
-	  texpdf_release_obj(crop_box);
-	crop_box = tmp;
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Rotate")))) {
-	if (rotate)
-	  texpdf_release_obj(rotate);
-	rotate = tmp;
-      }
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Resources")))) {
-#if 0
-	texpdf_merge_dict(tmp, resources);
-#endif
-	if (resources)
-	  texpdf_release_obj(resources);
-	resources = tmp;
-      }
-
-      kids_ref = texpdf_lookup_dict(page_tree, "Kids");
-      if (!kids_ref)
-	break;
-      kids = pdf_deref_obj(kids_ref);
-      kids_length = texpdf_array_length(kids);
-
-      for (i = 0; i < kids_length; i++) {
-	long count;
-
-	texpdf_release_obj(page_tree);
-	page_tree = pdf_deref_obj(texpdf_get_array(kids, i));
-
-	tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Count"));
-	if (tmp) {
-	  /* Pages object */
-	  count = texpdf_number_value(tmp);
-	  texpdf_release_obj(tmp);
-	} else
-	  /* Page object */
-	  count = 1;
-
-	if (page_idx < count)
-	  break;
-
-	page_idx -= count;
-      }
-      
-      texpdf_release_obj(kids);
-
-      if (i == kids_length) {
-	WARN("Page %ld not found! Broken PDF file?", page_no);
+      } else
+	texpdf_release_obj(tmp);
+    }
+    if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "TrimBox")))) {
+      if (!rect_equal(tmp, bbox)) {
 	if (bbox)
 	  texpdf_release_obj(bbox);
-	if (crop_box)
-	  texpdf_release_obj(crop_box);
-	if (rotate)
-	  texpdf_release_obj(rotate);
-	texpdf_release_obj(resources);
-	texpdf_release_obj(page_tree);
-	return NULL;
-      }
+	bbox = tmp;
+      } else
+	texpdf_release_obj(tmp);
+    }
+    if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "ArtBox")))) {
+      if (!rect_equal(tmp, bbox)) {
+	if (bbox)
+	  texpdf_release_obj(bbox);
+	bbox = tmp;
+      } else
+	texpdf_release_obj(tmp);
     }
-    if (crop_box) {
-      texpdf_release_obj(bbox);
-      bbox = crop_box;
+    if ((tmp = texpdf_lookup_dict(entry, "CropBox"))) {
+      if (bbox)
+	texpdf_release_obj(bbox);
+      bbox = texpdf_link_obj(tmp);
     }
   }
 
@@ -300,8 +229,12 @@ texpdf_get_page_obj (pdf_file *pf, long page_no,
   
   if (ret_bbox != NULL)
     *ret_bbox = bbox;
+  else
+    texpdf_release_obj(bbox);
   if (ret_resources != NULL)
     *ret_resources = resources;
+  else
+    texpdf_release_obj(resources);
 
   return page_tree;
 }
@@ -25,6 +25,10 @@
 
 #include "libtexpdf.h"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
 static int verbose = 0;
 void
 texpdf_color_set_verbose (void)
@@ -1106,6 +1110,86 @@ iccp_devClass_allowed (int dev_class)
   return 1;
 }
 
+/*
+ * Compressed ICC profile streams are kept across documents, keyed by
+ * the profile checksum, so that an output intent embedded in every
+ * document is compressed only once per process.
+ */
+struct iccp_stream
+{
+  long           proflen;
+  int            level;  /* compression level of data */
+  unsigned char *data;
+  unsigned long  length;
+};
+
+static struct {
+  int             enabled;
+  struct ht_table index; /* checksum -> struct iccp_stream */
+} iccp_cache;
+
+static void
+iccp_stream_free (void *hval)
+{
+  struct iccp_stream *s = hval;
+
+  RELEASE(s->data);
+  RELEASE(s);
+}
+
+void
+texpdf_color_set_iccp_cache (int enable)
+{
+  if (enable && !iccp_cache.enabled)
+    texpdf_ht_init_table(&iccp_cache.index, iccp_stream_free);
+  else if (!enable && iccp_cache.enabled)
+    texpdf_ht_clear_table(&iccp_cache.index);
+  iccp_cache.enabled = enable ? 1 : 0;
+}
+
+/* Returns the profile compressed at the current level, or NULL if
+ * the cache is off or the stream should be left to write_stream().
+ */
+static struct iccp_stream *
+iccp_cache_get (const unsigned char *checksum,
+		const void *profile, long proflen)
+{
+#ifdef HAVE_ZLIB_COMPRESS2
+  struct iccp_stream *s;
+  unsigned char *data;
+  uLongf length;
+  int    level = texpdf_get_compression();
+
+  if (!iccp_cache.enabled || level <= 0 || proflen <= 0)
+    return NULL;
+
+  s = texpdf_ht_lookup_table(&iccp_cache.index, checksum, 16);
+  if (s && s->proflen == proflen && s->level == level)
+    return s;
+
+  length = compressBound(proflen);
+  data   = NEW(length, unsigned char);
+  if (compress2(data, &length, profile, proflen, level) != Z_OK) {
+    RELEASE(data);
+    return NULL;
+  }
+  if (!s) {
+    s = NEW(1, struct iccp_stream);
+    texpdf_ht_append_table(&iccp_cache.index, checksum, 16, s);
+  } else {
+    RELEASE(s->data);
+  }
+  s->proflen = proflen;
+  s->level   = level;
+  s->data    = data;
+  s->length  = length;
+
+  return s;
+#else
+  return NULL;
+#endif /* HAVE_ZLIB_COMPRESS2 */
+}
+
 int
 iccp_load_profile (const char *ident,
 		   const void *profile, long proflen)
@@ -1118,6 +1202,7 @@ iccp_load_profile (const char *ident,
   int       colorspace;
   unsigned char checksum[16];
   struct iccbased_cdata *cdata;
+  struct iccp_stream    *cached;
 
   iccp_init_iccHeader(&icch);
   if (iccp_unpack_header(&icch, profile, proflen, 1) < 0) { /* check size */
@@ -1183,7 +1268,8 @@ iccp_load_profile (const char *ident,
 
   resource = texpdf_new_array();
 
-  stream = texpdf_new_stream(STREAM_COMPRESS);
+  cached = iccp_cache_get(checksum, profile, proflen);
+  stream = texpdf_new_stream(cached ? 0 : STREAM_COMPRESS);
   texpdf_add_array(resource, texpdf_new_name("ICCBased"));
   texpdf_add_array(resource, texpdf_ref_obj (stream));
 
@@ -1191,7 +1277,13 @@ iccp_load_profile (const char *ident,
   texpdf_add_dict(stream_dict, texpdf_new_name("N"),
 	       texpdf_new_number(get_num_components_iccbased(cdata)));
 
-  texpdf_add_stream (stream, profile, proflen);
+  if (cached) {
+    texpdf_add_dict(stream_dict,
+		    texpdf_new_name("Filter"), texpdf_new_name("FlateDecode"));
+    texpdf_add_stream(stream, cached->data, cached->length);
+  } else {
+    texpdf_add_stream(stream, profile, proflen);
+  }
   texpdf_release_obj(stream);
 
   cspc_id = pdf_colorspace_defineresource(ident,
@@ -1386,9 +1478,14 @@ static struct {
   int  count;
   int  capacity;
   pdf_colorspace *colorspaces;
-} cspc_cache = {
-  0, 0, NULL
-};
+  struct ht_table iccp_index; /* ICC checksum -> first colorspace id */
+} cspc_cache;
+
+static void
+hval_free (void *hval)
+{
+  RELEASE(hval);
+}
 
 int
 pdf_colorspace_findresource (const char *ident,
@@ -1397,6 +1494,16 @@ pdf_colorspace_findresource (const char *ident,
   pdf_colorspace *colorspace;
   int  cspc_id, cmp = -1;
 
+  if (type == PDF_COLORSPACE_TYPE_ICCBASED && cdata &&
+      memcmp(((const struct iccbased_cdata *) cdata)->checksum,
+	     nullbytes16, 16)) {
+    int *id;
+
+    id = texpdf_ht_lookup_table(&cspc_cache.iccp_index,
+				((const struct iccbased_cdata *) cdata)->checksum, 16);
+    return id ? *id : -1;
+  }
+
   for (cspc_id = 0;
        cmp && cspc_id < cspc_cache.count; cspc_id++) {
     colorspace = &cspc_cache.colorspaces[cspc_id];
@@ -1496,6 +1603,18 @@ pdf_colorspace_defineresource (const char *ident,
   colorspace->cdata    = cdata;
   colorspace->resource = resource;
 
+  if (subtype == PDF_COLORSPACE_TYPE_ICCBASED && cdata) {
+    struct iccbased_cdata *icc = cdata;
+
+    if (memcmp(icc->checksum, nullbytes16, 16) &&
+	!texpdf_ht_lookup_table(&cspc_cache.iccp_index, icc->checksum, 16)) {
+      int *value = NEW(1, int);
+
+      *value = cspc_id;
+      texpdf_ht_append_table(&cspc_cache.iccp_index, icc->checksum, 16, value);
+    }
+  }
+
   if (verbose) {
     MESG("(ColorSpace:%s", ident);
     if (verbose > 1) {
@@ -1587,6 +1706,7 @@ texpdf_init_colors (void)
   cspc_cache.count    = 0;
   cspc_cache.capacity = 0;
   cspc_cache.colorspaces = NULL;
+  texpdf_ht_init_table(&cspc_cache.iccp_index, hval_free);
 }
 
 void
@@ -1604,6 +1724,7 @@ texpdf_close_colors (void)
   RELEASE(cspc_cache.colorspaces);
   cspc_cache.colorspaces = NULL;
   cspc_cache.count = cspc_cache.capacity = 0;
+  texpdf_ht_clear_table(&cspc_cache.iccp_index);
 
 }
 
@@ -128,6 +128,10 @@ extern int      iccp_check_colorspace     (int colortype,
 extern int      iccp_load_profile (const char *ident,
 				   const void *profile, long proflen);
 
+/** Keep compressed ICC profile streams in memory across documents.
+Passing 0 disables the cache and frees it. */
+extern void     texpdf_color_set_iccp_cache (int enable);
+
 extern void     texpdf_init_colors  (void);
 extern void     texpdf_close_colors (void);
 
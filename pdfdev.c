@@ -485,6 +485,11 @@ static int num_dev_fonts   = 0;
 static int max_dev_fonts   = 0;
 static int num_phys_fonts  = 0;
 
+/* Indices into dev_fonts. Values are NEW'd ints. */
+static struct ht_table dev_font_names;  /* tex_name -> first dev_font of that name */
+static struct ht_table dev_font_sizes;  /* (tex_name, sptsize) -> dev_font */
+static struct ht_table native_fonts;    /* native font request -> dev_font */
+
 #define CURRENTFONT() ((text_state.font_id < 0) ? NULL : &(dev_fonts[text_state.font_id]))
 #define GET_FONT(n)   (&(dev_fonts[(n)]))
 
@@ -1234,14 +1239,8 @@ texpdf_dev_set_string (pdf_doc *p, spt_t xpos, spt_t ypos,
   if (text_state.is_mb) {
     if (FORMAT_BUF_SIZE - len < 2 * length)
       ERROR("Buffer overflow...");
-    for (i = 0; i < length; i++) {
-      int first, second;
-
-      first  = (str_ptr[i] >> 4) & 0x0f;
-      second = str_ptr[i] & 0x0f;
-      format_buffer[len++] = ((first >= 10)  ? first  + 'W' : first  + '0');
-      format_buffer[len++] = ((second >= 10) ? second + 'W' : second + '0');
-    }
+    len += pdfobj_hexencode_str(format_buffer + len,
+                                FORMAT_BUF_SIZE - len, str_ptr, length);
   } else {
     len += pdfobj_escape_str(format_buffer + len,
                              FORMAT_BUF_SIZE - len, str_ptr, length);
@@ -1252,6 +1251,55 @@ texpdf_dev_set_string (pdf_doc *p, spt_t xpos, spt_t ypos,
   text_state.offset += width;
 }
 
+static void
+dev_font_free_id (void *id)
+{
+  RELEASE(id);
+}
+
+static int
+dev_font_lookup (struct ht_table *ht, const void *key, int keylen)
+{
+  int *id;
+
+  id = texpdf_ht_lookup_table(ht, key, keylen);
+
+  return id ? *id : -1;
+}
+
+static void
+dev_font_register (struct ht_table *ht, const void *key, int keylen, int font_id)
+{
+  int *id;
+
+  if (dev_font_lookup(ht, key, keylen) >= 0)
+    return;
+
+  id  = NEW(1, int);
+  *id = font_id;
+  texpdf_ht_append_table(ht, key, keylen, id);
+}
+
+/* A font name followed by its NUL and a binary field, built in buf if
+ * it fits there; otherwise allocated, to be released by the caller.
+ */
+#define DEV_FONT_KEY_SIZE 256
+static char *
+dev_font_key (char *buf, int *keylen,
+	      const char *name, const void *field, int fieldlen)
+{
+  int   len = strlen(name) + 1;
+  char *key = buf;
+
+  *keylen = len + fieldlen;
+  if (*keylen > DEV_FONT_KEY_SIZE)
+    key = NEW(*keylen, char);
+  memcpy(key, name, len);
+  memcpy(key + len, field, fieldlen);
+
+  return key;
+}
+
 void
 texpdf_init_device (pdf_doc *p, double dvi2pts, int precision, int black_and_white)
 {
@@ -1280,6 +1328,9 @@ texpdf_init_device (pdf_doc *p, double dvi2pts, int precision, int black_and_whi
 
   num_dev_fonts  = max_dev_fonts = 0;
   dev_fonts      = NULL;
+  texpdf_ht_init_table(&dev_font_names, dev_font_free_id);
+  texpdf_ht_init_table(&dev_font_sizes, dev_font_free_id);
+  texpdf_ht_init_table(&native_fonts,   dev_font_free_id);
   num_dev_coords = max_dev_coords = 0;
   dev_coords     = NULL;
 }
@@ -1301,6 +1352,9 @@ texpdf_close_device (void)
     }
     RELEASE(dev_fonts);
   }
+  texpdf_ht_clear_table(&dev_font_names);
+  texpdf_ht_clear_table(&dev_font_sizes);
+  texpdf_ht_clear_table(&native_fonts);
   if (dev_coords) RELEASE(dev_coords);
   texpdf_dev_clear_gstates();
 }
@@ -1429,22 +1483,46 @@ print_fontmap (const char *font_name, fontmap_rec *mrec)
 
 }
 
+/* Everything but the file name that identifies a native font request. */
+struct native_font_req
+{
+  spt_t    ptsize;
+  uint32_t index;
+  int      layout_dir, extend, slant, embolden;
+};
+
 int texpdf_dev_load_native_font(const char *filename, uint32_t index,
                         spt_t ptsize, int layout_dir, int extend, int slant, int embolden) {
-  fontmap_rec  *mrec;
-  char         *fontmap_key = malloc(strlen(filename) + 40); // CHECK this is enough
-
-  sprintf(fontmap_key, "%s/%u/%c/%d/%d/%d", filename, index, layout_dir == 0 ? 'H' : 'V', extend, slant, embolden);
-  mrec = texpdf_lookup_fontmap_record(native_fontmap, fontmap_key);
-  if (mrec == NULL) {
-    if (texpdf_insert_native_fontmap_record(filename, index, layout_dir, extend, slant, embolden) == -1) {
+  struct native_font_req req;
+  char  buf[DEV_FONT_KEY_SIZE], *key, *fontmap_key;
+  int   keylen, font_id;
+
+  memset(&req, 0, sizeof(req)); /* no stray padding in the key */
+  req.ptsize     = ptsize;
+  req.index      = index;
+  req.layout_dir = layout_dir == 0 ? 0 : 1;
+  req.extend     = extend;
+  req.slant      = slant;
+  req.embolden   = embolden;
+
+  key = dev_font_key(buf, &keylen, filename, &req, sizeof(req));
+  font_id = dev_font_lookup(&native_fonts, key, keylen);
+  if (font_id < 0) {
+    fontmap_key = NEW(strlen(filename) + 40, char);
+    sprintf(fontmap_key, "%s/%u/%c/%d/%d/%d", filename, index, layout_dir == 0 ? 'H' : 'V', extend, slant, embolden);
+    if (!texpdf_lookup_fontmap_record(native_fontmap, fontmap_key) &&
+        texpdf_insert_native_fontmap_record(filename, index, layout_dir, extend, slant, embolden) == -1) {
       ERROR("Cannot proceed without the \"native\" font: %s", filename);
     }
-    mrec = texpdf_lookup_fontmap_record(native_fontmap, fontmap_key);
-    /* FIXME: would be more efficient if pdf_load_native_font returned the mrec ptr (or NULL for error)
-              so we could avoid doing a second lookup for the item we just inserted */
+    font_id = texpdf_dev_locate_font(native_fontmap, fontmap_key, ptsize);
+    RELEASE(fontmap_key);
+    if (font_id >= 0)
+      dev_font_register(&native_fonts, key, keylen, font_id);
   }
-  return texpdf_dev_locate_font(native_fontmap, fontmap_key, ptsize);
+  if (key != buf)
+    RELEASE(key);
+
+  return font_id;
 }
 
 /* _FIXME_
@@ -1459,6 +1537,8 @@ texpdf_dev_locate_font (fontmap_t* map, const char *font_name, spt_t ptsize)
   int              i;
   fontmap_rec     *mrec;
   struct dev_font *font;
+  char             buf[DEV_FONT_KEY_SIZE], *key;
+  int              keylen;
 
   if (!font_name)
     return  -1;
@@ -1468,14 +1548,17 @@ texpdf_dev_locate_font (fontmap_t* map, const char *font_name, spt_t ptsize)
     return -1;
   }
 
-  for (i = 0; i < num_dev_fonts; i++) {
-    if (strcmp(font_name, dev_fonts[i].tex_name) == 0) {
-      if (ptsize == dev_fonts[i].sptsize)
-        return i; /* found a dev_font that matches the request */
-      if (dev_fonts[i].format != PDF_FONTTYPE_BITMAP)
-        break; /* new dev_font will share pdf resource with /i/ */
-    }
-  }
+  key = dev_font_key(buf, &keylen, font_name, &ptsize, sizeof(spt_t));
+  i = dev_font_lookup(&dev_font_sizes, key, keylen);
+  if (key != buf)
+    RELEASE(key);
+  if (i >= 0)
+    return i; /* found a dev_font that matches the request */
+
+  i = dev_font_lookup(&dev_font_names, font_name, strlen(font_name));
+  if (i < 0 || dev_fonts[i].format == PDF_FONTTYPE_BITMAP)
+    i = num_dev_fonts;
+  /* else new dev_font will share pdf resource with /i/ */
 
   /*
    * Make sure we have room for a new one, even though we may not
@@ -1569,6 +1652,12 @@ texpdf_dev_locate_font (fontmap_t* map, const char *font_name, spt_t ptsize)
     }
   }
 
+  dev_font_register(&dev_font_names, font_name, strlen(font_name), num_dev_fonts);
+  key = dev_font_key(buf, &keylen, font_name, &ptsize, sizeof(spt_t));
+  dev_font_register(&dev_font_sizes, key, keylen, num_dev_fonts);
+  if (key != buf)
+    RELEASE(key);
+
   return  num_dev_fonts++;
 }
 
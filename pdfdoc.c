@@ -111,6 +111,7 @@ struct form_list_node
 };
 
 #define USE_MY_MEDIABOX (1 << 0)
+#define PAGE_HAS_BEADS  (1 << 1)
 
 
 struct name_dict
@@ -238,6 +239,26 @@ doc_get_page_entry (pdf_doc *p, unsigned long page_no)
   return page;
 }
 
+void
+texpdf_doc_set_page_cluster (pdf_doc *p, int cluster)
+{
+  if (cluster < 2) {
+    WARN("Page tree fan-out must be at least 2.");
+    return;
+  }
+  p->opt.page_cluster = cluster;
+}
+
+void
+texpdf_doc_enable_streaming_pages (pdf_doc *p)
+{
+  if (PAGECOUNT(p) > 0) {
+    WARN("Streaming page tree must be enabled before the first page is finished.");
+    return;
+  }
+  p->pages.streaming = 1;
+}
+
 static void pdf_doc_init_page_tree  (pdf_doc *p, double media_width, double media_height);
 static void pdf_doc_close_page_tree (pdf_doc *p);
 
@@ -573,8 +594,8 @@ doc_flush_page (pdf_doc *p, pdf_page *page, pdf_obj *parent_ref)
   return;
 }
 
-/* B-tree? */
-#define PAGE_CLUSTER 4
+/* Default fan-out of the page tree, see texpdf_doc_set_page_cluster(). */
+#define PAGE_CLUSTER 32
 static pdf_obj *
 build_page_tree (pdf_doc  *p,
                  pdf_page *firstpage, long num_pages,
@@ -599,7 +620,7 @@ build_page_tree (pdf_doc  *p,
     texpdf_add_dict(self, texpdf_new_name("Parent"), parent_ref);
 
   kids = texpdf_new_array();
-  if (num_pages > 0 && num_pages <= PAGE_CLUSTER) {
+  if (num_pages > 0 && num_pages <= p->opt.page_cluster) {
     for (i = 0; i < num_pages; i++) {
       pdf_page *page;
 
@@ -610,11 +631,21 @@ build_page_tree (pdf_doc  *p,
       doc_flush_page(p, page, texpdf_link_obj(self_ref));
     }
   } else if (num_pages > 0) {
-    for (i = 0; i < PAGE_CLUSTER; i++) {
+    long span, num_kids;
+
+    /*
+     * Use as few kids as a tree of minimal depth needs and split
+     * pages evenly among them, so that all leaves are about as full.
+     */
+    span = p->opt.page_cluster;
+    while (span * p->opt.page_cluster < num_pages)
+      span *= p->opt.page_cluster;
+    num_kids = (num_pages + span - 1) / span;
+    for (i = 0; i < num_kids; i++) {
       long start, end;
 
-      start = (i*num_pages)/PAGE_CLUSTER;
-      end   = ((i+1)*num_pages)/PAGE_CLUSTER;
+      start = (i*num_pages)/num_kids;
+      end   = ((i+1)*num_pages)/num_kids;
       if (end - start > 1) {
         pdf_obj *subtree;
 
@@ -639,6 +670,172 @@ build_page_tree (pdf_doc  *p,
   return self;
 }
 
+/*
+ * Streaming page tree.
+ *
+ * The tree is grown bottom-up with one open Pages node per level.
+ * Each page dict is written at the end of the page with the open
+ * level-0 node as its Parent; a node is written as soon as it has
+ * p->opt.page_cluster kids, and only the open nodes are kept until the
+ * document is closed.
+ */
+static int
+doc_page_node (pdf_doc *p, int level)
+{
+  pdf_page_node *node;
+
+  if (level >= p->pages.num_levels) {
+    p->pages.levels = RENEW(p->pages.levels, level + 1, pdf_page_node);
+    for (; p->pages.num_levels <= level; p->pages.num_levels++) {
+      node = &(p->pages.levels[p->pages.num_levels]);
+      node->dict  = NULL;
+      node->ref   = NULL;
+      node->kids  = NULL;
+      node->count = 0;
+    }
+  }
+
+  node = &(p->pages.levels[level]);
+  if (!node->dict) {
+    node->dict  = texpdf_new_dict();
+    node->ref   = texpdf_ref_obj(node->dict);
+    node->kids  = texpdf_new_array();
+    node->count = 0;
+    texpdf_add_dict(node->dict,
+                 texpdf_new_name("Type"), texpdf_new_name("Pages"));
+  }
+
+  return level;
+}
+
+static void
+doc_close_page_node (pdf_doc *p, int level, pdf_obj *parent_ref)
+{
+  pdf_page_node *node = &(p->pages.levels[level]);
+
+  texpdf_add_dict(node->dict,
+               texpdf_new_name("Count"), texpdf_new_number((double) node->count));
+  texpdf_add_dict(node->dict, texpdf_new_name("Kids"), node->kids);
+  texpdf_add_dict(node->dict, texpdf_new_name("Parent"), parent_ref);
+  texpdf_release_obj(node->dict);
+  texpdf_release_obj(node->ref);
+
+  node->dict  = NULL;
+  node->ref   = NULL;
+  node->kids  = NULL;
+  node->count = 0;
+}
+
+/* Close the node at level and hand it to the open node above it. */
+static void
+doc_push_page_node (pdf_doc *p, int level)
+{
+  pdf_obj *node_ref;
+  long     count;
+  int      parent;
+
+  parent   = doc_page_node(p, level + 1);
+  node_ref = texpdf_link_obj(p->pages.levels[level].ref);
+  count    = p->pages.levels[level].count;
+  doc_close_page_node(p, level,
+                      texpdf_link_obj(p->pages.levels[parent].ref));
+
+  texpdf_add_array(p->pages.levels[parent].kids, node_ref);
+  p->pages.levels[parent].count += count;
+}
+
+static void
+doc_stream_page (pdf_doc *p, pdf_page *page)
+{
+  pdf_obj *page_ref, *beads = NULL;
+  int      level;
+
+  if (!page->page_ref)
+    page->page_ref = texpdf_ref_obj(page->page_obj);
+  /* Kept for references to this page made after it is written. */
+  page_ref = texpdf_link_obj(page->page_ref);
+  /* Beads are realized at close; reserve the array now. */
+  if (page->flags & PAGE_HAS_BEADS) {
+    if (!page->beads)
+      page->beads = texpdf_new_array();
+    beads = texpdf_link_obj(page->beads);
+  }
+
+  level = doc_page_node(p, 0);
+  texpdf_add_array(p->pages.levels[level].kids, texpdf_link_obj(page_ref));
+  p->pages.levels[level].count++;
+  doc_flush_page(p, page,
+                 texpdf_link_obj(p->pages.levels[level].ref));
+  page->page_ref = page_ref;
+  page->beads    = beads;
+
+  while (level < p->pages.num_levels &&
+         p->pages.levels[level].dict &&
+         texpdf_array_length(p->pages.levels[level].kids) >= p->opt.page_cluster) {
+    doc_push_page_node(p, level);
+    level++;
+  }
+}
+
+/* Returns the dictionary to be merged into the root Pages node. */
+static pdf_obj *
+doc_finish_page_tree (pdf_doc *p)
+{
+  pdf_obj *root;
+  int      level, top;
+
+  root = texpdf_new_dict();
+  texpdf_add_dict(root, texpdf_new_name("Type"), texpdf_new_name("Pages"));
+
+  for (top = p->pages.num_levels - 1; top >= 0; top--) {
+    if (p->pages.levels[top].dict)
+      break;
+  }
+  if (top < 0) {
+    texpdf_add_dict(root, texpdf_new_name("Count"), texpdf_new_number(0.0));
+    texpdf_add_dict(root, texpdf_new_name("Kids"), texpdf_new_array());
+  } else {
+    pdf_page_node *node;
+
+    for (level = 0; level < top; level++) {
+      if (p->pages.levels[level].dict)
+        doc_push_page_node(p, level);
+    }
+    node = &(p->pages.levels[top]);
+    texpdf_add_dict(root, texpdf_new_name("Count"),
+                 texpdf_new_number((double) node->count));
+    if (pdf_obj_has_label(p->root.pages)) {
+      /* The root has been referenced already: keep the node as its kid. */
+      pdf_obj *kids = texpdf_new_array();
+
+      texpdf_add_array(kids, texpdf_link_obj(node->ref));
+      texpdf_add_dict(root, texpdf_new_name("Kids"), kids);
+      doc_close_page_node(p, top, texpdf_ref_obj(p->root.pages));
+    } else {
+      /*
+       * The top node becomes the root: its kids already point to it as
+       * their /Parent, so the root Pages dictionary takes over its label
+       * and the node itself is never written.
+       */
+      texpdf_add_dict(root, texpdf_new_name("Kids"), node->kids);
+      pdf_transfer_label(p->root.pages, node->dict);
+      texpdf_release_obj(node->dict);
+      texpdf_release_obj(node->ref);
+      node->dict  = NULL;
+      node->ref   = NULL;
+      node->kids  = NULL;
+      node->count = 0;
+    }
+  }
+
+  if (p->pages.levels)
+    RELEASE(p->pages.levels);
+  p->pages.levels     = NULL;
+  p->pages.num_levels = 0;
+
+  return root;
+}
+
 static void
 pdf_doc_init_page_tree (pdf_doc *p, double media_width, double media_height)
 {
@@ -707,7 +904,24 @@ pdf_doc_close_page_tree (pdf_doc *p)
   /*
    * Connect page tree to root node.
    */
-  page_tree_root = build_page_tree(p, FIRSTPAGE(p), PAGECOUNT(p), NULL);
+  if (p->pages.streaming) {
+    page_tree_root = doc_finish_page_tree(p);
+    for (page_no = 1; page_no <= PAGECOUNT(p); page_no++) {
+      pdf_page  *page;
+
+      page = doc_get_page_entry(p, page_no);
+      if (page->beads) {
+        texpdf_release_obj(page->beads);
+        page->beads = NULL;
+      }
+      if (page->page_ref) {
+        texpdf_release_obj(page->page_ref);
+        page->page_ref = NULL;
+      }
+    }
+  } else {
+    page_tree_root = build_page_tree(p, FIRSTPAGE(p), PAGECOUNT(p), NULL);
+  }
   texpdf_merge_dict (p->root.pages, page_tree_root);
   texpdf_release_obj(page_tree_root);
 
@@ -797,12 +1011,105 @@ pdf_doc_close_page_tree (pdf_doc *p)
  * displayed or printed. The value must be a multiple of 90. Default value: 0.
  */
 
+/*
+ * Flattened page tree of an imported PDF file. Each entry is a
+ * dictionary holding the Page object together with the inheritable
+ * MediaBox, CropBox, Rotate and Resources already resolved. It is
+ * built on first use and kept with the pdf_file.
+ */
+static const char *page_inheritable[] = {
+  "MediaBox", "CropBox", "Rotate", "Resources", NULL
+};
+
+static int
+doc_index_page_tree (pdf_obj *index, pdf_obj *node, pdf_obj *inherited,
+                     int depth)
+{
+  pdf_obj *attrs, *kids, *tmp;
+  long     i, kids_length;
+  int      j;
+
+  if (!depth)
+    return -1;
+
+  attrs = texpdf_new_dict();
+  for (j = 0; page_inheritable[j]; j++) {
+    tmp = pdf_deref_obj(texpdf_lookup_dict(node, page_inheritable[j]));
+    if (!tmp && inherited) {
+      tmp = texpdf_lookup_dict(inherited, page_inheritable[j]);
+      if (tmp)
+        tmp = texpdf_link_obj(tmp);
+    }
+    if (tmp)
+      texpdf_add_dict(attrs, texpdf_new_name(page_inheritable[j]), tmp);
+  }
+
+  kids = pdf_deref_obj(texpdf_lookup_dict(node, "Kids"));
+  if (!kids) {
+    /* Page object */
+    texpdf_add_dict(attrs, texpdf_new_name("Page"), texpdf_link_obj(node));
+    texpdf_add_array(index, attrs);
+    return 0;
+  } else if (!PDF_OBJ_ARRAYTYPE(kids)) {
+    texpdf_release_obj(kids);
+    texpdf_release_obj(attrs);
+    return -1;
+  }
+
+  kids_length = texpdf_array_length(kids);
+  for (i = 0; i < kids_length; i++) {
+    pdf_obj *kid;
+
+    kid = pdf_deref_obj(texpdf_get_array(kids, i));
+    if (!PDF_OBJ_DICTTYPE(kid) ||
+        doc_index_page_tree(index, kid, attrs, depth - 1) < 0) {
+      if (kid)
+        texpdf_release_obj(kid);
+      texpdf_release_obj(kids);
+      texpdf_release_obj(attrs);
+      return -1;
+    }
+    texpdf_release_obj(kid);
+  }
+  texpdf_release_obj(kids);
+  texpdf_release_obj(attrs);
+
+  return 0;
+}
+
+/* Returns NULL for a broken page tree. The index is owned by pf. */
+pdf_obj *
+texpdf_doc_get_page_index (pdf_file *pf)
+{
+  pdf_obj *index, *page_tree;
+
+  index = pdf_file_get_page_index(pf);
+  if (index)
+    return PDF_OBJ_ARRAYTYPE(index) ? index : NULL;
+
+  page_tree = pdf_deref_obj(texpdf_lookup_dict(pdf_file_get_catalog(pf), "Pages"));
+  if (PDF_OBJ_DICTTYPE(page_tree)) {
+    index = texpdf_new_array();
+    if (doc_index_page_tree(index, page_tree, NULL, PDF_OBJ_MAX_DEPTH) < 0) {
+      texpdf_release_obj(index);
+      index = NULL;
+    }
+  }
+  if (page_tree)
+    texpdf_release_obj(page_tree);
+
+  /* Remember failures too, so broken files are not walked again. */
+  pdf_file_set_page_index(pf, index ? index : texpdf_new_null());
+
+  return index;
+}
+
 pdf_obj *
 texpdf_doc_get_page (pdf_file *pf, long page_no, long *count_p,
 		  pdf_rect *bbox, pdf_obj **resources_p) {
   pdf_obj *page_tree = NULL;
   pdf_obj *resources = NULL, *box = NULL, *rotate = NULL;
-  pdf_obj *catalog;
+  pdf_obj *catalog, *index;
 
   catalog = pdf_file_get_catalog(pf);
 
@@ -828,100 +1135,38 @@ texpdf_doc_get_page (pdf_file *pf, long page_no, long *count_p,
 	goto error_silent;
       }
   }
+  texpdf_release_obj(page_tree);
+  page_tree = NULL;
 
   /*
-   * Seek correct page. Get MediaBox, CropBox and Resources.
+   * Get the page with its MediaBox, CropBox and Resources.
    * (Note that these entries can be inherited.)
    */
-  {
-    pdf_obj *media_box = NULL, *crop_box = NULL, *kids, *tmp;
-    int depth = PDF_OBJ_MAX_DEPTH;
-    long page_idx = page_no-1, kids_length = 1, i = 0;
-
-    while (--depth && i != kids_length) {
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "MediaBox")))) {
-	if (media_box)
-	  texpdf_release_obj(media_box);
-	media_box = tmp;
-      }
-
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "CropBox")))) {
-	if (crop_box)
-	  texpdf_release_obj(crop_box);
-	crop_box = tmp;
-      }
-
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Rotate")))) {
-	if (rotate)
-	  texpdf_release_obj(rotate);
-	rotate = tmp;
-      }
-
-      if ((tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Resources")))) {
-	if (resources)
-	  texpdf_release_obj(resources);
-	resources = tmp;
-      }
+  index = texpdf_doc_get_page_index(pf);
+  if (!index || page_no > texpdf_array_length(index))
+    goto error;
 
-      kids = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Kids"));
-      if (!kids)
-	break;
-      else if (!PDF_OBJ_ARRAYTYPE(kids)) {
-	texpdf_release_obj(kids);
-	goto error;
-      }
-      kids_length = texpdf_array_length(kids);
-
-      for (i = 0; i < kids_length; i++) {
-	long count;
-
-	texpdf_release_obj(page_tree);
-	page_tree = pdf_deref_obj(texpdf_get_array(kids, i));
-	if (!PDF_OBJ_DICTTYPE(page_tree))
-	  goto error;
-
-	tmp = pdf_deref_obj(texpdf_lookup_dict(page_tree, "Count"));
-	if (PDF_OBJ_NUMBERTYPE(tmp)) {
-	  /* Pages object */
-	  count = texpdf_number_value(tmp);
-	  texpdf_release_obj(tmp);
-	} else if (!tmp)
-	  /* Page object */
-	  count = 1;
-	else {
-	  texpdf_release_obj(tmp);
-	  goto error;
-	}
-
-	if (page_idx < count)
-	  break;
-
-	page_idx -= count;
-      }
-      
-      texpdf_release_obj(kids);
-    }
+  {
+    pdf_obj *entry, *media_box, *crop_box, *tmp;
 
-    if (!depth || kids_length == i) {
-      if (media_box)
-	texpdf_release_obj(media_box);
-     if (crop_box)
-	texpdf_release_obj(crop_box);
-      goto error;
-    }
+    entry     = texpdf_get_array(index, page_no - 1);
+    page_tree = texpdf_link_obj(texpdf_lookup_dict(entry, "Page"));
+    if ((tmp = texpdf_lookup_dict(entry, "Resources")))
+      resources = texpdf_link_obj(tmp);
+    if ((tmp = texpdf_lookup_dict(entry, "Rotate")))
+      rotate = texpdf_link_obj(tmp);
+    media_box = texpdf_lookup_dict(entry, "MediaBox");
+    crop_box  = texpdf_lookup_dict(entry, "CropBox");
 
     if (crop_box)
-      box = crop_box;
+      box = texpdf_link_obj(crop_box);
     else
       if (!(box = pdf_deref_obj(texpdf_lookup_dict(page_tree, "ArtBox"))) &&
 	  !(box = pdf_deref_obj(texpdf_lookup_dict(page_tree, "TrimBox"))) &&
 	  !(box = pdf_deref_obj(texpdf_lookup_dict(page_tree, "BleedBox"))) &&
 	  media_box) {
-	  box = media_box;
-	  media_box = NULL;
+	  box = texpdf_link_obj(media_box);
       }
-    if (media_box)
-      texpdf_release_obj(media_box);
   }
 
   if (!PDF_OBJ_ARRAYTYPE(box) || texpdf_array_length(box) != 4 ||
@@ -1516,6 +1761,11 @@ texpdf_doc_add_annot (pdf_doc *p, unsigned page_no, const pdf_rect *rect,
   double    xpos, ypos;
   pdf_rect  annbox;
 
+  if (p->pages.streaming && page_no <= PAGECOUNT(p)) {
+    WARN("Annotation attached to page #%u after it was written; ignored.", page_no);
+    return;
+  }
+
   page = doc_get_page_entry(p, page_no);
   if (!page->annots)
     page->annots = texpdf_new_array();
@@ -1650,6 +1900,14 @@ texpdf_doc_add_bead (pdf_doc* p, const char *article_id,
     return;
   }
 
+  if (p->pages.streaming) {
+    if (page_no <= PAGECOUNT(p)) {
+      WARN("Article bead on page #%ld after it was written; ignored.", page_no);
+      return;
+    }
+    doc_get_page_entry(p, page_no)->flags |= PAGE_HAS_BEADS;
+  }
+
   bead = bead_id ? find_bead(article, bead_id) : NULL;
   if (!bead) {
     if (article->num_beads >= article->max_beads) {
@@ -1961,8 +2219,9 @@ texpdf_doc_ref_page (pdf_doc *p, unsigned long page_no)
   pdf_page *page;
 
   page = doc_get_page_entry(p, page_no);
-  if (!page->page_obj) {
-    page->page_obj = texpdf_new_dict();
+  if (!page->page_ref) {
+    if (!page->page_obj)
+      page->page_obj = texpdf_new_dict();
     page->page_ref = texpdf_ref_obj(page->page_obj);
   }
 
@@ -2123,6 +2382,9 @@ pdf_doc_finish_page (pdf_doc *p)
       texpdf_add_dict(currentpage->page_obj, texpdf_new_name("Thumb"), thumb_ref);
   }
 
+  if (p->pages.streaming)
+    doc_stream_page(p, currentpage);
+
   p->pages.num_entries++;
 
   return;
@@ -2244,6 +2506,7 @@ texpdf_open_document (const char *filename,
 
   p->opt.annot_grow = annot_grow_amount;
   p->opt.outline_open_depth = bookmark_open_depth;
+  p->opt.page_cluster = PAGE_CLUSTER;
 
   texpdf_init_resources();
   texpdf_init_colors();
@@ -2262,8 +2525,11 @@ texpdf_open_document (const char *filename,
 
   if (do_encryption) {
     pdf_obj *encrypt = pdf_encrypt_obj();
+    pdf_obj *extensions = pdf_encrypt_extensions();
     texpdf_set_encrypt(encrypt);
     texpdf_release_obj(encrypt);
+    if (extensions)
+      texpdf_add_dict(p->root.dict, texpdf_new_name("Extensions"), extensions);
   }
   texpdf_set_id(texpdf_enc_id_array());
 
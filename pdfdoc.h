@@ -61,6 +61,7 @@ extern pdf_obj *texpdf_doc_get_reference  (pdf_doc *p, const char *category);
 
 extern pdf_obj *texpdf_doc_get_page (pdf_file *pf, long page_no, long *count_p,
 				  pdf_rect *bbox, pdf_obj **resources_p);
+extern pdf_obj *texpdf_doc_get_page_index (pdf_file *pf);
 
 extern long     texpdf_doc_current_page_number    (pdf_doc *p);
 extern pdf_obj *texpdf_doc_current_page_resources (pdf_doc *p);
@@ -131,6 +132,14 @@ extern void     texpdf_doc_expand_box  (pdf_doc *p, const pdf_rect *rect);
 /* Manual thumbnail */
 extern void     texpdf_doc_enable_manual_thumbnails (pdf_doc *p);
 
+/* Maximum number of kids of a Pages node. */
+extern void     texpdf_doc_set_page_cluster (pdf_doc *p, int cluster);
+
+/* Write each page dictionary as soon as the page ends.
+ * Must be called before the first page is finished.
+ */
+extern void     texpdf_doc_enable_streaming_pages (pdf_doc *p);
+
 #if 0
 /* PageLabels - */
 extern void     pdf_doc_set_pagelabel (long  page_start,
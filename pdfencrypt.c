@@ -18,6 +18,11 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA.
 */
 
+#if defined(WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#endif
+
 #include "libtexpdf.h"
 
 #include <stdio.h>
@@ -30,22 +35,46 @@
 #define getch _getch
 #else  /* !WIN32 */
 #include <unistd.h>
+#ifdef HAVE_SYS_RANDOM_H
+#include <sys/random.h>
+#endif
 #endif /* WIN32 */
 
-#define MAX_KEY_LEN 16
+#define MAX_KEY_LEN 32
 #define MAX_STR_LEN 32
+#define MAX_OU_LEN  48 /* O and U of revision 6: hash, validation and key salt */
+#define ID_STR_LEN  16
 
 static char* my_name = "libtexpdf";
 
 static unsigned char algorithm, revision, key_size;
 static long permission;
+static int  use_aes = 0;
 
-static unsigned char key_data[MAX_KEY_LEN], id_string[MAX_KEY_LEN];
-static unsigned char opwd_string[MAX_STR_LEN], upwd_string[MAX_STR_LEN];
+static unsigned char key_data[MAX_KEY_LEN], id_string[ID_STR_LEN];
+static unsigned char opwd_string[MAX_OU_LEN], upwd_string[MAX_OU_LEN];
+static unsigned char oe_string[32], ue_string[32], perms_string[16];
 
 static unsigned long current_label = 0;
 static unsigned current_generation = 0;
 
+/*
+ * Per-object key, derived once for each (label, generation), and its
+ * key schedule: every string and stream of the object starts from a
+ * copy of obj_arc4 instead of running ARC4_set_key() again.
+ */
+static int           obj_key_valid = 0;
+static unsigned long obj_key_label;
+static unsigned      obj_key_generation;
+static unsigned char obj_key[MAX_KEY_LEN];
+static unsigned int  obj_key_len;
+static AES_CONTEXT   obj_aes;
+static ARC4_KEY      obj_arc4;
+
+/* Initialization vectors are AES encryptions of a counter under a random key. */
+static AES_CONTEXT   iv_aes;
+static unsigned char iv_counter[16];
+
 static ARC4_KEY key;
 static MD5_CONTEXT md5_ctx;
 
@@ -68,6 +97,47 @@ void texpdf_enc_set_verbose (void)
   if (verbose < 255) verbose++;
 }
 
+void texpdf_enc_set_aes (int aes)
+{
+  use_aes = aes;
+}
+
+/*
+ * Keys, salts and IVs come from the system's cryptographic random
+ * number generator. There is no weaker fallback.
+ */
+static void enc_random_bytes (unsigned char *buf, int len)
+{
+#ifdef WIN32
+  if (BCRYPT_SUCCESS(BCryptGenRandom(NULL, buf, (ULONG) len,
+				     BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+    return;
+#else
+  FILE *fp;
+  int   n = 0;
+
+#if defined(HAVE_GETRANDOM) && defined(HAVE_SYS_RANDOM_H)
+  while (n < len) {
+    ssize_t r = getrandom(buf + n, len - n, 0);
+
+    if (r <= 0)
+      break;
+    n += r;
+  }
+  if (n == len)
+    return;
+#endif
+  fp = fopen("/dev/urandom", "rb");
+  if (fp) {
+    n = fread(buf, 1, len, fp);
+    fclose(fp);
+    if (n == len)
+      return;
+  }
+#endif
+  ERROR("No secure random number source available for encryption.");
+}
+
 #define PRODUCER "%s-%s, Copyright 2002-2014 by Jin-Hwan Cho, Matthias Franz, and Shunsaku Hirata"
 void texpdf_enc_compute_id_string (char *dviname, char *pdfname)
 {
@@ -133,7 +203,7 @@ static void compute_owner_password (void)
    *    from the previous MD5 hash and pass it as input into a new
    *    MD5 hash.
    */
-  if (revision == 3)
+  if (revision >= 3)
     for (i = 0; i < 50; i++) {
       /*
        * NOTE: We truncate each MD5 hash as in the following step.
@@ -169,7 +239,7 @@ static void compute_owner_password (void)
    *    that byte and the single-byte value of the iteration counter
    *    (from 1 to 19).
    */
-  if (revision == 3)
+  if (revision >= 3)
     for (i = 1; i <= 19; i++) {
       memcpy(in_buf, out_buf, MAX_STR_LEN);
       for (j = 0; j < key_size; j++)
@@ -234,13 +304,13 @@ static void compute_encryption_key (unsigned char *pwd)
    *    see Table 3.12 on page 68) to the MD5 hash function and
    *    finish the hash.
    */
-  texpdf_MD5_write(&md5_ctx, id_string, MAX_KEY_LEN);
+  texpdf_MD5_write(&md5_ctx, id_string, ID_STR_LEN);
   texpdf_MD5_final(md5_buf, &md5_ctx);
   /*
    * 6. (Revision 3 only) Do the following 50 times; Take the output from
    *    the previous MD5 hash and pass it as input into a new MD5 hash.
    */
-  if (revision == 3)
+  if (revision >= 3)
     for (i = 0; i < 50; i++) {
       /*
        * NOTE: We truncate each MD5 hash as in the following step.
@@ -313,10 +383,11 @@ static void compute_user_password (void)
     ARC4(&key, MAX_STR_LEN, padding_string, out_buf);
     break;
   case 3:
+  case 4:
     texpdf_MD5_init(&md5_ctx);
     texpdf_MD5_write(&md5_ctx, padding_string, MAX_STR_LEN);
 
-    texpdf_MD5_write(&md5_ctx, id_string, MAX_KEY_LEN);
+    texpdf_MD5_write(&md5_ctx, id_string, ID_STR_LEN);
     texpdf_MD5_final(md5_buf, &md5_ctx);
 
     ARC4_set_key(&key, key_size, key_data);
@@ -337,6 +408,130 @@ static void compute_user_password (void)
   memcpy(upwd_string, out_buf, MAX_STR_LEN);
 }
 
+/*
+ * Algorithm 2.B (ISO 32000-2) Computing a hash (revision 6)
+ *
+ * The password (at most 127 bytes), the 8-byte salt and, for the
+ * owner password, the 48-byte U string are hashed with SHA-256. The
+ * hash is then repeatedly used as an AES-128 key and IV to encrypt 64
+ * copies of password, hash and U; the sum of the first 16 bytes of the
+ * result modulo 3 selects SHA-256, -384 or -512 for the next hash.
+ * This continues for at least 64 rounds, until the last byte of the
+ * encrypted data is not greater than the round number minus 32.
+ */
+static void compute_hash_r6 (unsigned char *hash, const char *passwd,
+			     const unsigned char *salt, const unsigned char *udata)
+{
+  SHA256_CONTEXT sha256;
+  SHA512_CONTEXT sha512;
+  AES_CONTEXT    aes;
+  unsigned char  K[64], iv[16], *K1;
+  int  pwlen, udlen, Klen, seqlen, round, i, sum;
+
+  for (pwlen = 0; pwlen < 127 && passwd[pwlen]; pwlen++);
+  udlen = udata ? MAX_OU_LEN : 0;
+
+  texpdf_SHA256_init(&sha256);
+  texpdf_SHA256_write(&sha256, (const unsigned char *) passwd, pwlen);
+  texpdf_SHA256_write(&sha256, salt, 8);
+  if (udata)
+    texpdf_SHA256_write(&sha256, udata, udlen);
+  texpdf_SHA256_final(K, &sha256);
+  Klen = 32;
+
+  K1 = NEW(64 * (127 + 64 + MAX_OU_LEN), unsigned char);
+  for (round = 0; ; ) {
+    seqlen = pwlen + Klen + udlen;
+    memcpy(K1, passwd, pwlen);
+    memcpy(K1 + pwlen, K, Klen);
+    if (udata)
+      memcpy(K1 + pwlen + Klen, udata, udlen);
+    for (i = 1; i < 64; i++)
+      memcpy(K1 + i * seqlen, K1, seqlen);
+
+    texpdf_AES_set_key(&aes, 16, K);
+    memcpy(iv, K + 16, 16);
+    texpdf_AES_cbc_encrypt(&aes, iv, 64 * seqlen, K1, K1);
+
+    for (sum = 0, i = 0; i < 16; i++)
+      sum += K1[i];
+    switch (sum % 3) {
+    case 0:
+      texpdf_SHA256_init(&sha256);
+      texpdf_SHA256_write(&sha256, K1, 64 * seqlen);
+      texpdf_SHA256_final(K, &sha256);
+      Klen = 32;
+      break;
+    case 1:
+      texpdf_SHA384_init(&sha512);
+      texpdf_SHA512_write(&sha512, K1, 64 * seqlen);
+      texpdf_SHA384_final(K, &sha512);
+      Klen = 48;
+      break;
+    default:
+      texpdf_SHA512_init(&sha512);
+      texpdf_SHA512_write(&sha512, K1, 64 * seqlen);
+      texpdf_SHA512_final(K, &sha512);
+      Klen = 64;
+      break;
+    }
+    round++;
+    if (round >= 64 && K1[64 * seqlen - 1] <= round - 32)
+      break;
+  }
+  RELEASE(K1);
+
+  memcpy(hash, K, 32);
+}
+
+static void compute_passwords_r6 (void)
+{
+  AES_CONTEXT   aes;
+  unsigned char hash[32], iv[16];
+  const char   *opwd;
+
+  /* The file encryption key is random in revision 6. */
+  enc_random_bytes(key_data, key_size);
+  /*
+   * Algorithm 8: U is the hash of the user password and a random
+   * validation salt, followed by that salt and a random key salt. UE
+   * is the file key encrypted with the hash of the password and key salt.
+   */
+  enc_random_bytes(upwd_string + 32, 16);
+  compute_hash_r6(upwd_string, user_passwd, upwd_string + 32, NULL);
+  compute_hash_r6(hash, user_passwd, upwd_string + 40, NULL);
+  texpdf_AES_set_key(&aes, 32, hash);
+  memset(iv, 0, 16);
+  texpdf_AES_cbc_encrypt(&aes, iv, 32, key_data, ue_string);
+  /*
+   * Algorithm 9: O and OE, the same with the owner password and the
+   * U string appended to each hash input.
+   */
+  opwd = strlen(owner_passwd) > 0 ? owner_passwd : user_passwd;
+  enc_random_bytes(opwd_string + 32, 16);
+  compute_hash_r6(opwd_string, opwd, opwd_string + 32, upwd_string);
+  compute_hash_r6(hash, opwd, opwd_string + 40, upwd_string);
+  texpdf_AES_set_key(&aes, 32, hash);
+  memset(iv, 0, 16);
+  texpdf_AES_cbc_encrypt(&aes, iv, 32, key_data, oe_string);
+  /*
+   * Algorithm 10: Perms is P (low-order byte first, extended to
+   * 8 bytes), 'T' for EncryptMetadata, "adb" and 4 random bytes,
+   * encrypted with the file key.
+   */
+  perms_string[0] = (unsigned char)(permission) & 0xFF;
+  perms_string[1] = (unsigned char)(permission >> 8) & 0xFF;
+  perms_string[2] = (unsigned char)(permission >> 16) & 0xFF;
+  perms_string[3] = (unsigned char)(permission >> 24) & 0xFF;
+  memset(perms_string + 4, 0xFF, 4);
+  memcpy(perms_string + 8, "Tadb", 4);
+  enc_random_bytes(perms_string + 12, 4);
+  texpdf_AES_set_key(&aes, 32, key_data);
+  texpdf_AES_ecb_encrypt(&aes, perms_string, perms_string);
+
+  memset(hash, 0, 32);
+}
+
 #ifdef WIN32
 static char *getpass (const char *prompt)
 {
@@ -387,36 +582,126 @@ void texpdf_enc_set_passwd (unsigned bits, unsigned perm, const char *owner_pw,
     }
 
   key_size = (unsigned char)(bits / 8);
-  algorithm = (key_size == 5 ? 1 : 2);
   permission = (long) (perm | 0xC0U);
-  revision = ((algorithm == 1 && permission < 0x100L) ? 2 : 3);
-  if (revision == 3)
+  if (key_size == 32) {
+    /* AESV3 */
+    algorithm = 5;
+    revision  = 6;
+  } else if (use_aes) {
+    /* AESV2 */
+    key_size  = 16;
+    algorithm = 4;
+    revision  = 4;
+  } else {
+    algorithm = (key_size == 5 ? 1 : 2);
+    revision = ((algorithm == 1 && permission < 0x100L) ? 2 : 3);
+  }
+  if (revision >= 3)
     permission |= ~0xFFFL;
 
-  compute_owner_password();
-  compute_user_password();
+  if (algorithm >= 4) {
+    unsigned char seed[32];
+    unsigned version = (revision >= 5) ? 7 : 6;
+
+    if (texpdf_get_version() < version) {
+      WARN("PDF version raised to 1.%u for %s encryption.",
+	   version, revision >= 5 ? "AESV3" : "AESV2");
+      texpdf_set_version(version);
+    }
+    enc_random_bytes(seed, 32);
+    texpdf_AES_set_key(&iv_aes, 16, seed);
+    memcpy(iv_counter, seed + 16, 16);
+    memset(seed, 0, 32);
+  }
+
+  if (revision >= 5) {
+    compute_passwords_r6();
+  } else {
+    compute_owner_password();
+    compute_user_password();
+  }
+  obj_key_valid = 0;
 }
 
-void pdf_encrypt_data (unsigned char *data, unsigned long len)
+/*
+ * Algorithm 3.1 (and 3.1a for AESV2): the object key is the MD5 hash
+ * of the file key, the low-order 3 bytes of the object number and the
+ * 2 bytes of the generation number (and "sAlT" for AES), truncated to
+ * n+5 bytes but at most 16. Revision 6 uses the file key directly.
+ */
+static void compute_object_key (void)
 {
-  unsigned char *result;
+  if (obj_key_valid &&
+      obj_key_label == current_label &&
+      obj_key_generation == current_generation)
+    return;
+
+  if (revision >= 5) {
+    memcpy(obj_key, key_data, key_size);
+    obj_key_len = key_size;
+  } else {
+    int len = key_size + 5;
+
+    memcpy(in_buf, key_data, key_size);
+    in_buf[key_size]   = (unsigned char)(current_label) & 0xFF;
+    in_buf[key_size+1] = (unsigned char)(current_label >> 8) & 0xFF;
+    in_buf[key_size+2] = (unsigned char)(current_label >> 16) & 0xFF;
+    in_buf[key_size+3] = (unsigned char)(current_generation) & 0xFF;
+    in_buf[key_size+4] = (unsigned char)(current_generation >> 8) & 0xFF;
+    if (algorithm == 4) {
+      memcpy(in_buf + len, "sAlT", 4);
+      len += 4;
+    }
 
-  memcpy(in_buf, key_data, key_size);
-  in_buf[key_size]   = (unsigned char)(current_label) & 0xFF;
-  in_buf[key_size+1] = (unsigned char)(current_label >> 8) & 0xFF;
-  in_buf[key_size+2] = (unsigned char)(current_label >> 16) & 0xFF;
-  in_buf[key_size+3] = (unsigned char)(current_generation) & 0xFF;
-  in_buf[key_size+4] = (unsigned char)(current_generation >> 8) & 0xFF;
+    texpdf_MD5_init(&md5_ctx);
+    texpdf_MD5_write(&md5_ctx, in_buf, len);
+    texpdf_MD5_final(md5_buf, &md5_ctx);
 
-  texpdf_MD5_init(&md5_ctx);
-  texpdf_MD5_write(&md5_ctx, in_buf, key_size+5);
-  texpdf_MD5_final(md5_buf, &md5_ctx);
-  
-  result = NEW (len, unsigned char);
-  ARC4_set_key(&key, (key_size > 10 ? MAX_KEY_LEN : key_size+5), md5_buf);
-  ARC4(&key, len, data, result);
-  memcpy(data, result, len);
-  RELEASE (result);
+    obj_key_len = (key_size > 10 ? 16 : key_size+5);
+    memcpy(obj_key, md5_buf, obj_key_len);
+  }
+  if (algorithm >= 4)
+    texpdf_AES_set_key(&obj_aes, obj_key_len, obj_key);
+  else
+    ARC4_set_key(&obj_arc4, obj_key_len, obj_key);
+
+  obj_key_label      = current_label;
+  obj_key_generation = current_generation;
+  obj_key_valid      = 1;
+}
+
+unsigned long pdf_encrypt_length (unsigned long len)
+{
+  /* AES: 16-byte IV, data padded to a whole number of blocks. */
+  return (algorithm >= 4) ? 16 + (len / 16 + 1) * 16 : len;
+}
+
+unsigned long pdf_encrypt_data (unsigned char *data, unsigned long len)
+{
+  compute_object_key();
+
+  if (algorithm >= 4) {
+    unsigned char iv[16];
+    int pad = 16 - len % 16, i;
+
+    /* Fresh IV: next counter value encrypted under the IV key. */
+    for (i = 15; i >= 0 && ++iv_counter[i] == 0; i--);
+    texpdf_AES_ecb_encrypt(&iv_aes, iv_counter, iv);
+
+    /* Encrypted in place behind the IV, with PKCS#5 padding. */
+    memmove(data + 16, data, len);
+    memset(data + 16 + len, pad, pad);
+    memcpy(data, iv, 16);
+    texpdf_AES_cbc_encrypt(&obj_aes, iv, len + pad, data + 16, data + 16);
+
+    return 16 + len + pad;
+  }
+
+  /* RC4 works a byte at a time, so it can encrypt in place. */
+  key = obj_arc4;
+  ARC4(&key, len, data, data);
+
+  return len;
 }
 
 pdf_obj *pdf_encrypt_obj (void)
@@ -452,6 +737,9 @@ pdf_obj *pdf_encrypt_obj (void)
    *           lengths ranging from 40 to 128 bits. (This algorithm is
    *           unpublished as an export requirement of the U.S. Department
    *           of Commerce.)
+   *        4  (PDF 1.5) The security handler defines the use of
+   *           encryption and decryption in the crypt filters (CF).
+   *        5  (PDF 2.0) As 4, with 256-bit AES (AESV3).
    *        The default value if this entry is omitted is 0, but a value
    *        of 1 or greater is strongly recommended.
    */
@@ -468,6 +756,29 @@ pdf_obj *pdf_encrypt_obj (void)
     texpdf_add_dict (doc_encrypt, 
 		  texpdf_new_name ("Length"),
 		  texpdf_new_number (key_size * 8));
+  /* KEY  : CF, StmF, StrF
+   * TYPE : dictionary, name, name
+   * VALUE: (V 4 or 5) Crypt filters: a single StdCF with method AESV2
+   *        (128 bits) or AESV3 (256 bits), used for streams and strings.
+   */
+  if (algorithm >= 4) {
+    pdf_obj *CF, *StdCF;
+
+    StdCF = texpdf_new_dict();
+    texpdf_add_dict(StdCF, texpdf_new_name("CFM"),
+		    texpdf_new_name(algorithm == 5 ? "AESV3" : "AESV2"));
+    texpdf_add_dict(StdCF, texpdf_new_name("AuthEvent"),
+		    texpdf_new_name("DocOpen"));
+    texpdf_add_dict(StdCF, texpdf_new_name("Length"),
+		    texpdf_new_number(key_size));
+    CF = texpdf_new_dict();
+    texpdf_add_dict(CF, texpdf_new_name("StdCF"), StdCF);
+    texpdf_add_dict(doc_encrypt, texpdf_new_name("CF"), CF);
+    texpdf_add_dict(doc_encrypt, texpdf_new_name("StmF"),
+		    texpdf_new_name("StdCF"));
+    texpdf_add_dict(doc_encrypt, texpdf_new_name("StrF"),
+		    texpdf_new_name("StdCF"));
+  }
   /* KEY  : R
    * TYPE : number
    * VALUE: (Required) A number specifying which revision of the standard
@@ -487,7 +798,7 @@ pdf_obj *pdf_encrypt_obj (void)
    */
   texpdf_add_dict (doc_encrypt, 
 		texpdf_new_name ("O"),
-		texpdf_new_string (opwd_string, 32));
+		texpdf_new_string (opwd_string, revision >= 5 ? 48 : 32));
   /* KEY  : U
    * TYPE : string
    * VALUE: (Required) A 32-byte string, based on the user password,
@@ -497,7 +808,20 @@ pdf_obj *pdf_encrypt_obj (void)
    */
   texpdf_add_dict (doc_encrypt, 
 		texpdf_new_name ("U"),
-		texpdf_new_string (upwd_string, 32));
+		texpdf_new_string (upwd_string, revision >= 5 ? 48 : 32));
+  /* KEY  : OE, UE, Perms
+   * TYPE : string
+   * VALUE: (R 6) The file key encrypted with the owner and user
+   *        password hashes, and the encrypted permissions.
+   */
+  if (revision >= 5) {
+    texpdf_add_dict (doc_encrypt,
+		  texpdf_new_name ("OE"),
+		  texpdf_new_string (oe_string, 32));
+    texpdf_add_dict (doc_encrypt,
+		  texpdf_new_name ("UE"),
+		  texpdf_new_string (ue_string, 32));
+  }
   /* KEY  : P
    * TYPE : (signed 32 bit) integer
    * VALUE: (Required) A set of flags specifying which operations are
@@ -506,15 +830,36 @@ pdf_obj *pdf_encrypt_obj (void)
   texpdf_add_dict (doc_encrypt, 
 		texpdf_new_name ("P"),
 		texpdf_new_number (permission));
+  if (revision >= 5)
+    texpdf_add_dict (doc_encrypt,
+		  texpdf_new_name ("Perms"),
+		  texpdf_new_string (perms_string, 16));
 
   return doc_encrypt;
 }
 
+/* Catalog /Extensions entry needed for AESV3 in a PDF 1.7 file, or NULL. */
+pdf_obj *pdf_encrypt_extensions (void)
+{
+  pdf_obj *ext, *adbe;
+
+  if (revision < 5 || texpdf_get_version() > 7)
+    return NULL;
+
+  adbe = texpdf_new_dict();
+  texpdf_add_dict(adbe, texpdf_new_name("BaseVersion"), texpdf_new_name("1.7"));
+  texpdf_add_dict(adbe, texpdf_new_name("ExtensionLevel"), texpdf_new_number(8));
+  ext = texpdf_new_dict();
+  texpdf_add_dict(ext, texpdf_new_name("ADBE"), adbe);
+
+  return ext;
+}
+
 pdf_obj *texpdf_enc_id_array (void)
 {
   pdf_obj *id = texpdf_new_array();
-  texpdf_add_array(id, texpdf_new_string(id_string, MAX_KEY_LEN));
-  texpdf_add_array(id, texpdf_new_string(id_string, MAX_KEY_LEN));
+  texpdf_add_array(id, texpdf_new_string(id_string, ID_STR_LEN));
+  texpdf_add_array(id, texpdf_new_string(id_string, ID_STR_LEN));
   return id;
 }
 
@@ -33,7 +33,11 @@ extern void texpdf_enc_compute_id_string (char *dviname, char *pdfname);
 extern void texpdf_enc_set_label (unsigned long label);
 extern void texpdf_enc_set_generation (unsigned generation);
 extern void texpdf_enc_set_passwd (unsigned size, unsigned perm, const char *owner, const char *user);
-extern void pdf_encrypt_data (unsigned char *data, unsigned long len);
+extern void texpdf_enc_set_aes (int aes);
+/* AES output is longer: data buffers must hold pdf_encrypt_length(len) bytes. */
+extern unsigned long pdf_encrypt_length (unsigned long len);
+extern unsigned long pdf_encrypt_data (unsigned char *data, unsigned long len);
 extern pdf_obj *pdf_encrypt_obj (void);
+extern pdf_obj *pdf_encrypt_extensions (void);
 
 #endif /* _PDFENCRYPT_H_ */
@@ -253,7 +253,20 @@ cmp_key (const void *d1, const void *d2)
   return cmp;
 }
 
-#define NAME_CLUSTER 4
+/* Default fan-out; leaf nodes hold up to twice as many names. */
+#define NAME_CLUSTER 32
+static int name_cluster = NAME_CLUSTER;
+
+void
+texpdf_names_set_cluster (int cluster)
+{
+  if (cluster < 2) {
+    WARN("Name tree fan-out must be at least 2.");
+    return;
+  }
+  name_cluster = cluster;
+}
+
 static pdf_obj *
 build_name_tree (struct named_object *first, long num_leaves, int is_root)
 {
@@ -282,7 +295,7 @@ build_name_tree (struct named_object *first, long num_leaves, int is_root)
   }
 
   if (num_leaves > 0 &&
-      num_leaves <= 2 * NAME_CLUSTER) {
+      num_leaves <= 2 * name_cluster) {
     pdf_obj *names;
 
     /* Create leaf nodes. */
@@ -311,15 +324,21 @@ build_name_tree (struct named_object *first, long num_leaves, int is_root)
     texpdf_add_dict(result, texpdf_new_name("Names"), names);
   } else if (num_leaves > 0) {
     pdf_obj *kids;
+    long     span, num_kids;
+
+    /* Intermediate node: as few kids as minimal depth allows, evenly filled. */
+    span = 2 * name_cluster;
+    while (span * name_cluster < num_leaves)
+      span *= name_cluster;
+    num_kids = (num_leaves + span - 1) / span;
 
-    /* Intermediate node */
     kids = texpdf_new_array();
-    for (i = 0; i < NAME_CLUSTER; i++) {
+    for (i = 0; i < num_kids; i++) {
       pdf_obj *subtree;
       long     start, end;
 
-      start = (i*num_leaves) / NAME_CLUSTER;
-      end   = ((i+1)*num_leaves) / NAME_CLUSTER;
+      start = (i*num_leaves) / num_kids;
+      end   = ((i+1)*num_leaves) / num_kids;
       subtree = build_name_tree(&first[start], (end - start), 0);
       texpdf_add_array  (kids, texpdf_ref_obj(subtree));
       texpdf_release_obj(subtree);
@@ -340,6 +359,7 @@ flat_table (struct ht_table *ht_tab, long *num_entries,
 
   ASSERT(ht_tab);
 
+  /* Hash tables iterate in insertion order, which keeps ascending runs. */
   objects = NEW(ht_tab->count, struct named_object);
   count = 0;
   if (ht_set_iter(ht_tab, &iter) >= 0) {
@@ -384,6 +404,67 @@ flat_table (struct ht_table *ht_tab, long *num_entries,
   return objects;
 }
 
+/*
+ * Natural merge sort: the ascending runs already present in the input
+ * are merged pairwise until one run is left. Names are mostly defined
+ * in ascending order, so there are few runs compared to the number of
+ * keys.
+ */
+static void
+sort_named_objects (struct named_object *objects, long count)
+{
+  struct named_object *buf, *src, *dst, *tmp;
+  long  *runs, num_runs, i, j;
+
+  if (count < 2)
+    return;
+
+  runs = NEW(count + 1, long);
+  num_runs = 0;
+  runs[num_runs++] = 0;
+  for (i = 1; i < count; i++) {
+    if (cmp_key(&objects[i-1], &objects[i]) > 0)
+      runs[num_runs++] = i;
+  }
+  runs[num_runs] = count;
+  if (num_runs == 1) {
+    RELEASE(runs);
+    return;
+  }
+
+  buf = NEW(count, struct named_object);
+  src = objects;
+  dst = buf;
+  while (num_runs > 1) {
+    for (i = 0, j = 0; i < num_runs; i += 2, j++) {
+      long  lo, hi, end, l, r, k;
+
+      lo  = runs[i];
+      hi  = runs[MIN(i+1, num_runs)];
+      end = runs[MIN(i+2, num_runs)];
+      for (l = lo, r = hi, k = lo; l < hi && r < end; ) {
+	if (cmp_key(&src[r], &src[l]) < 0)
+	  dst[k++] = src[r++];
+	else
+	  dst[k++] = src[l++];
+      }
+      while (l < hi)
+	dst[k++] = src[l++];
+      while (r < end)
+	dst[k++] = src[r++];
+      runs[j] = lo;
+    }
+    runs[j] = count;
+    num_runs = j;
+    tmp = src; src = dst; dst = tmp;
+  }
+  if (src != objects)
+    memcpy(objects, src, count * sizeof(struct named_object));
+
+  RELEASE(buf);
+  RELEASE(runs);
+}
+
 pdf_obj *
 texpdf_names_create_tree (struct ht_table *names, long *count,
 		       struct ht_table *filter)
@@ -395,7 +476,7 @@ texpdf_names_create_tree (struct ht_table *names, long *count,
   if (!flat)
     name_tree = NULL;
   else {
-    qsort(flat, *count, sizeof(struct named_object), cmp_key);
+    sort_named_objects(flat, *count);
     name_tree = build_name_tree(flat, *count, 1);
     RELEASE(flat);
   }
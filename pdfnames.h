@@ -40,6 +40,9 @@ extern pdf_obj *texpdf_names_lookup_object    (struct ht_table *names,
 extern int      texpdf_names_close_object     (struct ht_table *names,
 					    const void *key, int keylen);
 
+/* Maximum number of kids of an intermediate node. */
+extern void     texpdf_names_set_cluster      (int cluster);
+
 /* Really create name tree... */
 extern pdf_obj *texpdf_names_create_tree      (struct ht_table *names,
 					    long *count,
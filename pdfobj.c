@@ -97,6 +97,7 @@ struct pdf_stream
   unsigned long   stream_length;
   unsigned long   max_length;
   unsigned char   _flags;
+  HASH64_CONTEXT  hash;           /* of the data, fed by texpdf_add_stream() */
 };
 
 struct pdf_indirect
@@ -148,6 +149,7 @@ struct pdf_file
   pdf_obj    *trailer;
   xref_entry *xref_table;
   pdf_obj    *catalog;
+  pdf_obj    *page_index; /* See texpdf_doc_get_page_index(). */
   long        num_obj;
   long        file_size;
   int         version;
@@ -164,6 +166,34 @@ static int doc_enc_mode;
 static pdf_obj *trailer_dict; /* XXX needs to be re-entrant */
 static pdf_obj *xref_stream; /* XXX needs to be re-entrant */
 
+/*
+ * Duplicate object elimination. When a stream, array or dictionary is
+ * flushed, its serialized form (and for streams the data and flags) is
+ * hashed; if an identical object was already written and no reference
+ * to the new one has been output yet, its label is freed and later
+ * references are redirected to the first copy. Objects referred to
+ * before they are complete (forward references) are therefore always
+ * written as they are. A hash match is confirmed by a SHA-256 digest
+ * of the same bytes before anything is collapsed. Freed labels are
+ * chained into the xref free list with generation 1.
+ */
+static struct {
+  int             requested;  /* texpdf_set_dedup(), for the next file */
+  int             enabled;    /* fixed for the whole file at pdf_out_init() */
+  int             hashing;    /* serializing a dictionary for its hash */
+  struct ht_table index;      /* hash key -> struct dedup_entry        */
+  unsigned long  *alias;      /* label -> label of the first copy or 0 */
+  unsigned char  *referenced; /* label -> reference already written    */
+  unsigned long   size;
+  long            saved;
+} dedup = {0};
+
+struct dedup_entry {
+  unsigned long label;
+  long          size;         /* bytes written for the first copy */
+  unsigned char digest[32];   /* SHA-256 of dictionary and data */
+};
+
 /* Internal static routines */
 
 static int texpdf_check_for_pdf_version (FILE *file);
@@ -229,6 +259,22 @@ texpdf_set_compression (int level)
   return;
 }
 
+int
+texpdf_get_compression (void)
+{
+  return compression_level;
+}
+
+/*
+ * Takes effect at the next pdf_out_init(): every reference written to
+ * a file must be tracked for objects to be collapsed safely.
+ */
+void
+texpdf_set_dedup (int enabled)
+{
+  dedup.requested = enabled;
+}
+
 static unsigned pdf_version = PDF_VERSION_DEFAULT;
 
 void
@@ -276,6 +322,12 @@ add_xref_entry (unsigned long label, unsigned char type, unsigned long field2, u
   output_xref[label].indirect = NULL;
 }
 
+static void
+hval_free (void *hval)
+{
+  RELEASE(hval);
+}
+
 #define BINARY_MARKER "%\344\360\355\370\n"
 void
 pdf_out_init (const char *filename, int do_encryption)
@@ -287,6 +339,13 @@ pdf_out_init (const char *filename, int do_encryption)
   add_xref_entry(0, 0, 0, 0xffff);
   next_label = 1;
 
+  texpdf_ht_init_table(&dedup.index, hval_free);
+  dedup.enabled    = dedup.requested;
+  dedup.alias      = NULL;
+  dedup.referenced = NULL;
+  dedup.size  = 0;
+  dedup.saved = 0;
+
   if (pdf_version >= 5) {
     xref_stream = texpdf_new_stream(STREAM_COMPRESS);
     xref_stream->flags |= OBJ_NO_ENCRYPT;
@@ -325,12 +384,29 @@ pdf_out_init (const char *filename, int do_encryption)
   doc_enc_mode = do_encryption;
 }
 
+/* Link the free entries (labels collapsed by dedup) from entry 0 on. */
+static void
+link_free_entries (void)
+{
+  unsigned long i, next = 0;
+
+  for (i = next_label; i-- > 1; ) {
+    if (output_xref[i].type == 0) {
+      output_xref[i].field2 = next;
+      next = i;
+    }
+  }
+  output_xref[0].field2 = next;
+}
+
 static void
 texpdf_dump_xref_table (void)
 {
   long length;
   unsigned long i;
 
+  link_free_entries();
+
   pdf_out(pdf_output_file, "xref\n", 5);
 
   length = sprintf(format_buffer, "%d %lu\n", 0, next_label);
@@ -389,6 +465,7 @@ texpdf_dump_xref_stream (void)
 
   /* We need the xref entry for the xref stream right now */
   add_xref_entry(next_label-1, 1, startxref, 0);
+  link_free_entries();
 
   for (i = 0; i < next_label; i++) {
     unsigned j;
@@ -443,6 +520,14 @@ pdf_out_flush (void)
 
     /* Done with xref table */
     RELEASE(output_xref);
+    texpdf_ht_clear_table(&dedup.index);
+    if (dedup.alias)
+      RELEASE(dedup.alias);
+    if (dedup.referenced)
+      RELEASE(dedup.referenced);
+    dedup.alias      = NULL;
+    dedup.referenced = NULL;
+    dedup.size = 0;
 
     pdf_out(pdf_output_file, "startxref\n", 10);
     length = sprintf(format_buffer, "%lu\n", startxref);
@@ -455,7 +540,10 @@ pdf_out_flush (void)
 	MESG("Compression saved %ld bytes%s\n", compression_saved,
 	     pdf_version < 5 ? ". Try \"-V 5\" for better compression" : "");
       }
+      if (dedup.enabled)
+	MESG("Duplicate objects saved %ld bytes\n", dedup.saved);
     }
+    dedup.enabled = 0;
     MESG("%ld bytes written", pdf_output_file_position);
 
     MFCLOSE(pdf_output_file);
@@ -644,6 +732,14 @@ pdf_transfer_label (pdf_obj *dst, pdf_obj *src)
   src->generation = 0;
 }
 
+int
+pdf_obj_has_label (pdf_obj *object)
+{
+  ASSERT(object);
+
+  return object->label != 0;
+}
+
 /*
  * This doesn't really copy the object, but allows it to be used without
  * fear that somebody else will free it.
@@ -685,14 +781,38 @@ release_indirect (pdf_indirect *data)
   RELEASE(data);
 }
 
+static void
+dedup_grow (unsigned long label)
+{
+  if (label >= dedup.size) {
+    unsigned long size = (label/IND_OBJECTS_ALLOC_SIZE+1)*IND_OBJECTS_ALLOC_SIZE;
+
+    dedup.alias      = RENEW(dedup.alias, size, unsigned long);
+    dedup.referenced = RENEW(dedup.referenced, size, unsigned char);
+    memset(dedup.alias + dedup.size, 0,
+	   (size - dedup.size) * sizeof(unsigned long));
+    memset(dedup.referenced + dedup.size, 0, size - dedup.size);
+    dedup.size = size;
+  }
+}
+
 static void
 write_indirect (pdf_indirect *indirect, FILE *file)
 {
   long length;
+  unsigned long label = indirect->label;
 
   ASSERT(!indirect->pf);
 
-  length = sprintf(format_buffer, "%lu %hu R", indirect->label, indirect->generation);
+  if (dedup.enabled && file == pdf_output_file) {
+    dedup_grow(label);
+    if (dedup.alias[label])
+      label = dedup.alias[label];
+    else if (!dedup.hashing)
+      dedup.referenced[label] = 1;
+  }
+
+  length = sprintf(format_buffer, "%lu %hu R", label, indirect->generation);
   pdf_out(file, format_buffer, length);
 }
 
@@ -875,16 +995,35 @@ texpdf_string_length (pdf_obj *object)
  * This routine escapes non printable characters and control
  * characters in an output string.
  */
+/*
+ * Characters that may be copied verbatim into a literal string.
+ * Runs of these are copied with a single memcpy().
+ */
+#define is_plain_strchar(c) ((c) >= 32 && (c) <= 126 && \
+                             (c) != '(' && (c) != ')' && (c) != '\\')
+
 int
 pdfobj_escape_str (char *buffer, int bufsize, const unsigned char *s, int len)
 {
   int result = 0;
-  int i;
+  int i = 0;
 
-  for (i = 0; i < len; i++) {
+  while (i < len) {
     unsigned char ch;
+    int start = i;
+
+    while (i < len && is_plain_strchar(s[i]))
+      i++;
+    if (i > start) {
+      if (result + (i - start) > bufsize - 3)
+        ERROR("pdfobj_escape_str: Buffer overflow");
+      memcpy(buffer + result, s + start, i - start);
+      result += i - start;
+      if (i == len)
+        break;
+    }
 
-    ch = s[i];
+    ch = s[i++];
     if (result > bufsize - 4)
       ERROR("pdfobj_escape_str: Buffer overflow");
 
@@ -892,55 +1031,75 @@ pdfobj_escape_str (char *buffer, int bufsize, const unsigned char *s, int len)
      * We always write three octal digits. Optimization only gives few Kb
      * smaller size for most documents when zlib compressed.
      */
+    buffer[result++] = '\\';
     if (ch < 32 || ch > 126) {
-      buffer[result++] = '\\';
-#if 0
-      if (i < len - 1 && !isdigit(s[i+1]))
-	result += sprintf(buffer+result, "%o", ch);
-      else
-	result += sprintf(buffer+result, "%03o", ch);
-#endif
-      result += sprintf(buffer+result, "%03o", ch);
+      buffer[result++] = '0' + ((ch >> 6) & 0x07);
+      buffer[result++] = '0' + ((ch >> 3) & 0x07);
+      buffer[result++] = '0' + (ch & 0x07);
     } else {
-      switch (ch) {
-      case '(':
-	buffer[result++] = '\\';
-	buffer[result++] = '(';
-	break;
-      case ')':
-	buffer[result++] = '\\';
-	buffer[result++] = ')';
-	break;
-      case '\\':
-	buffer[result++] = '\\';
-	buffer[result++] = '\\';
-	break;
-      default:
-	buffer[result++] = ch;
-	break;
-      }
+      /* One of '(', ')' or '\\'. */
+      buffer[result++] = ch;
     }
   }
 
   return result;
 }
 
+/*
+ * Write len bytes of s as (lowercase) ASCII hex digits. Returns the
+ * number of characters written, always 2 * len.
+ */
+int
+pdfobj_hexencode_str (char *buffer, int bufsize, const unsigned char *s, int len)
+{
+  const unsigned char *end = s + len;
+  char *p = buffer;
+
+  if (bufsize < 2 * len)
+    ERROR("pdfobj_hexencode_str: Buffer overflow");
+
+  /* Unrolled so that the table lookups are independent of each other. */
+  while (end - s >= 4) {
+    p[0] = xchar[s[0] >> 4]; p[1] = xchar[s[0] & 0x0f];
+    p[2] = xchar[s[1] >> 4]; p[3] = xchar[s[1] & 0x0f];
+    p[4] = xchar[s[2] >> 4]; p[5] = xchar[s[2] & 0x0f];
+    p[6] = xchar[s[3] >> 4]; p[7] = xchar[s[3] & 0x0f];
+    p += 8; s += 4;
+  }
+  while (s < end) {
+    p[0] = xchar[s[0] >> 4]; p[1] = xchar[s[0] & 0x0f];
+    p += 2; s++;
+  }
+
+  return p - buffer;
+}
+
 static void
 write_string (pdf_string *str, FILE *file)
 {
   unsigned char *s;
   char wbuf[FORMAT_BUF_SIZE]; /* Shouldn't use format_buffer[]. */
-  int  nescc = 0, i, count;
+  int  nescc = 0, i, count, chunk;
+  long length;
 
   s = str->string;
+  length = str->length;
+
+  if (enc_mode) {
+    unsigned long enc_length = pdf_encrypt_length(length);
 
-  if (enc_mode)
-    pdf_encrypt_data(s, str->length);
+    if (enc_length > (unsigned long) length) {
+      /* AES: IV and padding make the result longer than the string. */
+      s = NEW(enc_length, unsigned char);
+      memcpy(s, str->string, length);
+    }
+    length = pdf_encrypt_data(s, length);
+  }
 
   /*
    * Count all ASCII non-printable characters.
    */
-  for (i = 0; i < str->length; i++) {
+  for (i = 0; i < length; i++) {
     if (!isprint(s[i]))
       nescc++;
   }
@@ -948,28 +1107,31 @@ write_string (pdf_string *str, FILE *file)
    * If the string contains much escaped chars, then we write it as
    * ASCII hex string.
    */
-  if (nescc > str->length / 3) {
+  if (nescc > length / 3) {
     pdf_out_char(file, '<');
-    for (i = 0; i < str->length; i++) {
-      pdf_out_xchar(file, s[i]);
+    for (i = 0; i < length; i += chunk) {
+      chunk = MIN(length - i, FORMAT_BUF_SIZE / 2);
+      count = pdfobj_hexencode_str(wbuf, FORMAT_BUF_SIZE, &(s[i]), chunk);
+      pdf_out(file, wbuf, count);
     }
     pdf_out_char(file, '>');
   } else {
     pdf_out_char(file, '(');
     /*
-     * This section of code probably isn't speed critical.  Escaping the
-     * characters in the string one at a time may seem slow, but it's
-     * safe if the formatted string length exceeds FORMAT_BUF_SIZE.
-     * Occasionally you see some long strings in PDF.  pdfobj_escape_str
-     * is also used for strings of text with no kerning.  These must be
-     * handled as quickly as possible since there are so many of them.
-     */ 
-    for (i = 0; i < str->length; i++) {
-      count = pdfobj_escape_str(wbuf, FORMAT_BUF_SIZE, &(s[i]), 1);
+     * Long strings are escaped a chunk at a time: each input byte
+     * expands to at most four output bytes, so a chunk of a quarter of
+     * wbuf can never overflow it.
+     */
+    for (i = 0; i < length; i += chunk) {
+      chunk = MIN(length - i, FORMAT_BUF_SIZE / 4 - 1);
+      count = pdfobj_escape_str(wbuf, FORMAT_BUF_SIZE, &(s[i]), chunk);
       pdf_out(file, wbuf, count);
     }
     pdf_out_char(file, ')');
   }
+
+  if (s != str->string)
+    RELEASE(s);
 }
 
 static void
@@ -1552,6 +1714,7 @@ texpdf_new_stream (int flags)
   data->stream_length = 0;
   data->max_length    = 0;
   data->objstm_data = NULL;
+  texpdf_HASH64_init(&data->hash, 0);
 
   result->data = data;
   result->flags |= OBJ_NO_OBJSTM;
@@ -1641,6 +1804,15 @@ write_stream (pdf_stream *stream, FILE *file)
     filtered_length++;
   }
 #endif
+
+  if (enc_mode) {
+    unsigned long enc_length = pdf_encrypt_length(filtered_length);
+
+    if (enc_length > filtered_length)
+      filtered = RENEW(filtered, enc_length, unsigned char);
+    filtered_length = pdf_encrypt_data(filtered, filtered_length);
+  }
+
   texpdf_add_dict(stream->dict,
 	       texpdf_new_name("Length"), texpdf_new_number(filtered_length));
 
@@ -1648,9 +1820,6 @@ write_stream (pdf_stream *stream, FILE *file)
 
   pdf_out(file, "\nstream\n", 8);
 
-  if (enc_mode)
-    pdf_encrypt_data(filtered, filtered_length);
-
   if (filtered_length > 0) {
     pdf_out(file, filtered, filtered_length);
   }
@@ -1722,6 +1891,19 @@ pdf_stream_length (pdf_obj *stream)
   return (long) data->stream_length;
 }
 
+/* Hash of the stream data, computed as it was added: no extra pass. */
+uint64_t
+texpdf_stream_hash (pdf_obj *stream)
+{
+  pdf_stream *data;
+
+  TYPECHECK(stream, PDF_STREAM);
+
+  data = stream->data;
+
+  return texpdf_HASH64_final(&data->hash);
+}
+
 static void
 set_objstm_data (pdf_obj *objstm, long *data) {
   TYPECHECK(objstm, PDF_STREAM);
@@ -1752,6 +1934,7 @@ texpdf_add_stream (pdf_obj *stream, const void *stream_data, long length)
   }
   memcpy(data->stream + data->stream_length, stream_data, length);
   data->stream_length += length;
+  texpdf_HASH64_write(&data->hash, stream_data, length);
 }
 
 #if HAVE_ZLIB
@@ -2265,6 +2448,123 @@ pdf_flush_obj (pdf_obj *object, FILE *file)
   pdf_out(file, "\nendobj\n", 8);
 }
 
+/*
+ * Dictionaries that stand for something in their own right (pages,
+ * annotations, outline items, ...) must not be shared even when equal.
+ */
+static int
+dedup_shareable (pdf_obj *object)
+{
+  switch (object->type) {
+  case PDF_STREAM:
+    return object != xref_stream && !get_objstm_data(object);
+  case PDF_ARRAY:
+    return 1;
+  case PDF_DICT:
+    return !texpdf_lookup_dict(object, "Type")   &&
+           !texpdf_lookup_dict(object, "Parent") &&
+           !texpdf_lookup_dict(object, "Kids")   &&
+           !texpdf_lookup_dict(object, "P")      &&
+           !texpdf_lookup_dict(object, "Rect");
+  }
+  return 0;
+}
+
+static void
+dedup_digest (pdf_obj *object, pdf_obj *serialized, unsigned char *digest)
+{
+  SHA256_CONTEXT sha;
+  pdf_stream    *data;
+
+  texpdf_SHA256_init(&sha);
+  data = serialized->data;
+  texpdf_SHA256_write(&sha, data->stream, data->stream_length);
+  if (object->type == PDF_STREAM) {
+    data = object->data;
+    texpdf_SHA256_write(&sha, data->stream, data->stream_length);
+  }
+  texpdf_SHA256_final(digest, &sha);
+}
+
+/*
+ * Look the object up by its contents: for streams the incremental hash
+ * of the data and the hash of the dictionary as it stands before
+ * /Length and /Filter are added, otherwise the hash of the serialized
+ * object. If an identical object was written before, as confirmed by
+ * the digest, and no reference to this one has been output, the object
+ * is collapsed into it and that entry is returned. A new object is
+ * recorded and its own entry returned; NULL means it is written as it
+ * is.
+ */
+static struct dedup_entry *
+dedup_object (pdf_obj *object)
+{
+  struct dedup_entry *entry;
+  pdf_obj *serialized, *saved_output_stream;
+  unsigned char key[35], digest[32];
+  uint64_t h;
+  int  saved_enc_mode;
+
+  if (object->generation || !dedup_shareable(object))
+    return NULL;
+
+  /* Strings are encrypted in place, so never with enc_mode set here. */
+  saved_output_stream = output_stream;
+  saved_enc_mode      = enc_mode;
+  serialized    = texpdf_new_stream(0);
+  output_stream = serialized;
+  enc_mode      = 0;
+  dedup.hashing = 1;
+  if (object->type == PDF_STREAM)
+    pdf_write_obj(((pdf_stream *) object->data)->dict, pdf_output_file);
+  else
+    pdf_write_obj(object, pdf_output_file);
+  dedup.hashing = 0;
+  enc_mode      = saved_enc_mode;
+  output_stream = saved_output_stream;
+
+  key[0] = object->type;
+  key[1] = (object->flags & OBJ_NO_ENCRYPT) ? 1 : 0;
+  key[2] = 0;
+  h = texpdf_stream_hash(serialized);
+  memcpy(key + 3, &h, 8);
+  h = pdf_stream_length(serialized);
+  memcpy(key + 11, &h, 8);
+  memset(key + 19, 0, 16);
+  if (object->type == PDF_STREAM) {
+    key[2] = ((pdf_stream *) object->data)->_flags;
+    h = texpdf_stream_hash(object);
+    memcpy(key + 19, &h, 8);
+    h = pdf_stream_length(object);
+    memcpy(key + 27, &h, 8);
+  }
+
+  dedup_grow(object->label);
+  entry = texpdf_ht_lookup_table(&dedup.index, key, sizeof(key));
+  if (!entry || !dedup.referenced[object->label])
+    dedup_digest(object, serialized, digest);
+  if (entry) {
+    if (dedup.referenced[object->label] ||
+	memcmp(entry->digest, digest, 32))
+      entry = NULL;
+    else {
+      dedup.alias[object->label] = entry->label;
+      add_xref_entry(object->label, 0, 0, 1);
+      dedup.saved += entry->size;
+    }
+  } else {
+    entry = NEW(1, struct dedup_entry);
+    entry->label = object->label;
+    /* As written into an object stream; flushed objects are measured. */
+    entry->size  = pdf_stream_length(serialized) + 1;
+    memcpy(entry->digest, digest, 32);
+    texpdf_ht_append_table(&dedup.index, key, sizeof(key), entry);
+  }
+  texpdf_release_obj(serialized);
+
+  return entry;
+}
+
 static long
 pdf_add_objstm (pdf_obj *objstm, pdf_obj *object)
 {
@@ -2307,6 +2607,7 @@ release_objstm (pdf_obj *objstm)
   /* Reserve 22 bytes for each entry (two 10 digit numbers plus two spaces) */
   stream->stream = NEW(old_length + 22*pos, unsigned char);
   stream->stream_length = 0;
+  texpdf_HASH64_init(&stream->hash, 0);
 
   {
     long i = 2*pos, *val = data+2;
@@ -2344,11 +2645,21 @@ texpdf_release_obj (pdf_obj *object)
      * Nonzero "label" means object needs to be written before it's destroyed.
      */
     if (object->label && pdf_output_file != NULL) {
-      if (!do_objstm || object->flags & OBJ_NO_OBJSTM
+      struct dedup_entry *entry = NULL;
+
+      if (dedup.enabled)
+	entry = dedup_object(object);
+      if (entry && entry->label != object->label) {
+	/* Collapsed into an identical object written earlier */
+      } else if (!do_objstm || object->flags & OBJ_NO_OBJSTM
 	  || (doc_enc_mode && object->flags & OBJ_NO_ENCRYPT)
-	  || object->generation)
+	  || object->generation) {
+	long position = pdf_output_file_position;
+
 	pdf_flush_obj(object, pdf_output_file);
-      else {
+	if (entry)
+	  entry->size = pdf_output_file_position - position;
+      } else {
         if (!current_objstm) {
 	  long *data = NEW(2*OBJSTM_MAX_OBJS+2, long);
 	  data[0] = data[1] = 0;
@@ -3134,6 +3445,7 @@ pdf_file_new (FILE *file)
   pf->trailer = NULL;
   pf->xref_table = NULL;
   pf->catalog = NULL;
+  pf->page_index = NULL;
   pf->num_obj = 0;
   pf->version = 0;
 
@@ -3152,6 +3464,9 @@ pdf_file_free (pdf_file *pf)
     return;
   }
 
+  if (pf->page_index)
+    texpdf_release_obj(pf->page_index);
+
   for (i = 0; i < pf->num_obj; i++) {
     if (pf->xref_table[i].direct)
       texpdf_release_obj(pf->xref_table[i].direct);
@@ -3196,6 +3511,22 @@ pdf_file_get_catalog (pdf_file *pf)
   return pf->catalog;
 }
 
+pdf_obj *
+pdf_file_get_page_index (pdf_file *pf)
+{
+  ASSERT(pf);
+  return pf->page_index;
+}
+
+void
+pdf_file_set_page_index (pdf_file *pf, pdf_obj *page_index)
+{
+  ASSERT(pf);
+  if (pf->page_index)
+    texpdf_release_obj(pf->page_index);
+  pf->page_index = page_index;
+}
+
 pdf_file *
 texpdf_open (const char *ident, FILE *file)
 {
@@ -24,6 +24,7 @@
 #define _PDFOBJ_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 /* Here is the complete list of PDF object types */
 
@@ -79,6 +80,7 @@ extern pdf_obj *texpdf_ref_obj        (pdf_obj *object);
 extern pdf_obj *texpdf_link_obj       (pdf_obj *object);
 
 extern void     pdf_transfer_label (pdf_obj *dst, pdf_obj *src);
+extern int      pdf_obj_has_label  (pdf_obj *object);
 extern pdf_obj *texpdf_new_undefined  (void);
 
 extern pdf_obj *texpdf_new_null       (void);
@@ -155,6 +157,7 @@ extern int         texpdf_add_stream_flate  (pdf_obj *stream,
 extern int         pdf_concat_stream     (pdf_obj *dst, pdf_obj *src);
 extern pdf_obj    *texpdf_stream_dict       (pdf_obj *stream);
 extern long        pdf_stream_length     (pdf_obj *stream);
+extern uint64_t    texpdf_stream_hash    (pdf_obj *stream);
 #if 0
 extern void        pdf_stream_set_flags  (pdf_obj *stream, int flags);
 extern int         pdf_stream_get_flags  (pdf_obj *stream);
@@ -173,6 +176,10 @@ extern int         pdf_compare_reference (pdf_obj *ref1, pdf_obj *ref2);
  */
 
 extern void      texpdf_set_compression (int level);
+extern int       texpdf_get_compression (void);
+/* Collapse identical streams, arrays and dictionaries into one object
+ * (off by default). Applies to files opened after the call. */
+extern void      texpdf_set_dedup       (int enabled);
 
 extern void      texpdf_set_info     (pdf_obj *obj);
 extern void      texpdf_set_root     (pdf_obj *obj);
@@ -187,11 +194,14 @@ extern void      texpdf_close         (pdf_file *pf);
 extern pdf_obj  *pdf_file_get_trailer (pdf_file *pf);
 extern int       texpdf_file_get_version (pdf_file *pf);
 extern pdf_obj  *pdf_file_get_catalog (pdf_file *pf);
+extern pdf_obj  *pdf_file_get_page_index (pdf_file *pf);
+extern void      pdf_file_set_page_index (pdf_file *pf, pdf_obj *page_index);
 
 extern pdf_obj *pdf_deref_obj     (pdf_obj *object);
 extern pdf_obj *pdf_import_object (pdf_obj *object);
 
 extern int      pdfobj_escape_str (char *buffer, int size, const unsigned char *s, int len);
+extern int      pdfobj_hexencode_str (char *buffer, int size, const unsigned char *s, int len);
 
 extern pdf_obj *texpdf_new_indirect  (pdf_file *pf, unsigned long label, unsigned short generation);
 
@@ -29,16 +29,6 @@
 #define PDF_RESOURCE_DEBUG_STR "PDF"
 #define PDF_RESOURCE_DEBUG     3
 
-#define PDF_RESOURCE_FONT       0
-#define PDF_RESOURCE_CIDFONT    1
-#define PDF_RESOURCE_ENCODING   2
-#define PDF_RESOURCE_CMAP       3
-#define PDF_RESOURCE_XOBJECT    4
-#define PDF_RESOURCE_COLORSPACE 5
-#define PDF_RESOURCE_SHADING    6
-#define PDF_RESOURCE_PATTERN    7
-#define PDF_RESOURCE_GSTATE     8
-
 typedef struct pdf_res
 {
   char    *ident;
@@ -69,12 +59,20 @@ static struct {
 
 #define PDF_NUM_RESOURCE_CATEGORIES (sizeof(pdf_resource_categories)/sizeof(pdf_resource_categories[0]))
 
+/* Resource IDs pack the category above a 24-bit index. */
+#define RESOURCE_ID(c,r) ((long) (((c) << 24)|(r)))
+#define RESOURCE_CAT(i)  ((int) (((i) >> 24) & 0xff))
+#define RESOURCE_IDX(i)  ((int) ((i) & 0xffffff))
+#define RESOURCE_MAX     0xffffff
+
 #define CACHE_ALLOC_SIZE 16u
 struct res_cache
 {
   int      count;
   int      capacity;
   pdf_res *resources;
+
+  struct ht_table index; /* resname -> index into resources */
 };
 
 static struct res_cache resources[PDF_NUM_RESOURCE_CATEGORIES];
@@ -126,6 +124,22 @@ pdf_clean_resource (pdf_res *res)
   }
 }
 
+static void
+hval_free (void *hval)
+{
+  RELEASE(hval);
+}
+
+static int
+lookup_resource (struct res_cache *rc, const char *resname)
+{
+  int *res_id;
+
+  res_id = texpdf_ht_lookup_table(&rc->index, resname, strlen(resname));
+
+  return res_id ? *res_id : -1;
+}
+
 void
 texpdf_init_resources (void)
 {
@@ -136,6 +150,7 @@ texpdf_init_resources (void)
     resources[i].count     = 0;
     resources[i].capacity  = 0;
     resources[i].resources = NULL;
+    texpdf_ht_init_table(&resources[i].index, hval_free);
   }
 }
 
@@ -155,6 +170,7 @@ texpdf_close_resources (void)
       pdf_clean_resource(&rc->resources[j]);
     }
     RELEASE(rc->resources);
+    texpdf_ht_clear_table(&rc->index);
 
     rc->count     = 0;
     rc->capacity  = 0;
@@ -162,29 +178,40 @@ texpdf_close_resources (void)
   }
 }
 
+/* Category names are distinct in their first two characters. */
 static int
 get_category (const char *category)
 {
-  int  i;
-
-  for (i = 0;
-       i < PDF_NUM_RESOURCE_CATEGORIES; i++) {
-    if (!strcmp(category, pdf_resource_categories[i].name)) {
-      return pdf_resource_categories[i].cat_id;
+  int  cat_id;
+
+  switch (category[0]) {
+  case 'F': cat_id = PDF_RESOURCE_FONT;     break;
+  case 'E':
+    cat_id = category[1] == 'x' ? PDF_RESOURCE_GSTATE : PDF_RESOURCE_ENCODING;
+    break;
+  case 'X': cat_id = PDF_RESOURCE_XOBJECT;  break;
+  case 'S': cat_id = PDF_RESOURCE_SHADING;  break;
+  case 'P': cat_id = PDF_RESOURCE_PATTERN;  break;
+  case 'C':
+    switch (category[1]) {
+    case 'I': cat_id = PDF_RESOURCE_CIDFONT;    break;
+    case 'M': cat_id = PDF_RESOURCE_CMAP;       break;
+    case 'o': cat_id = PDF_RESOURCE_COLORSPACE; break;
+    default:  return -1;
     }
+    break;
+  default:
+    return -1;
   }
 
-  return -1;
+  return strcmp(category, pdf_resource_categories[cat_id].name) ? -1 : cat_id;
 }
 
 long
 pdf_defineresource (const char *category,
 		    const char *resname, pdf_obj *object, int flags)
 {
-  int      res_id;
-  struct res_cache *rc;
-  int      cat_id;
-  pdf_res *res = NULL;
+  int  cat_id;
 
   ASSERT(category && object);
 
@@ -194,41 +221,27 @@ pdf_defineresource (const char *category,
     return -1;
   }
 
-  rc = &resources[cat_id];
-  if (resname) {
-    for (res_id = 0; res_id < rc->count; res_id++) {
-      res = &rc->resources[res_id];
-      if (!strcmp(resname, res->ident)) {
-	WARN("Resource %s (category: %s) already defined...",
-	     resname, category);
-	pdf_flush_resource(res);
-	res->flags    = flags;
-	if (flags & PDF_RES_FLUSH_IMMEDIATE) {
-	  res->reference = texpdf_ref_obj(object);
-	  texpdf_release_obj(object);
-	} else {
-	  res->object = object;
-	}
-	return (long) ((cat_id << 16)|(res_id));
-      }
-    }
-  } else {
-    res_id = rc->count;
-  }
+  return pdf_defineresource_id(cat_id, resname, object, flags);
+}
 
-  if (res_id == rc->count) {
-    if (rc->count >= rc->capacity) {
-      rc->capacity += CACHE_ALLOC_SIZE;
-      rc->resources = RENEW(rc->resources, rc->capacity, pdf_res);
-    }
-    res = &rc->resources[res_id];
+long
+pdf_defineresource_id (int cat_id,
+		       const char *resname, pdf_obj *object, int flags)
+{
+  int      res_id;
+  struct res_cache *rc;
+  pdf_res *res = NULL;
 
-    texpdf_init_resource(res);
-    if (resname && resname[0] != '\0') {
-      res->ident = NEW(strlen(resname) + 1, char);
-      strcpy(res->ident, resname);
-    }
-    res->category = cat_id;
+  ASSERT(object);
+  ASSERT(cat_id >= 0 && cat_id < PDF_NUM_RESOURCE_CATEGORIES);
+
+  rc = &resources[cat_id];
+  if (resname && resname[0] != '\0' &&
+      (res_id = lookup_resource(rc, resname)) >= 0) {
+    res = &rc->resources[res_id];
+    WARN("Resource %s (category: %s) already defined...",
+	 resname, pdf_resource_categories[cat_id].name);
+    pdf_flush_resource(res);
     res->flags    = flags;
     if (flags & PDF_RES_FLUSH_IMMEDIATE) {
       res->reference = texpdf_ref_obj(object);
@@ -236,10 +249,44 @@ pdf_defineresource (const char *category,
     } else {
       res->object = object;
     }
-    rc->count++;
+    return RESOURCE_ID(cat_id, res_id);
+  }
+
+  res_id = rc->count;
+  if (res_id > RESOURCE_MAX) {
+    ERROR("Too many resources (category: %s)",
+	  pdf_resource_categories[cat_id].name);
+    return -1;
   }
 
-  return (long) ((cat_id << 16)|(res_id));
+  if (rc->count >= rc->capacity) {
+    rc->capacity += MAX(CACHE_ALLOC_SIZE, rc->capacity);
+    rc->resources = RENEW(rc->resources, rc->capacity, pdf_res);
+  }
+  res = &rc->resources[res_id];
+
+  texpdf_init_resource(res);
+  if (resname && resname[0] != '\0') {
+    int *value;
+
+    res->ident = NEW(strlen(resname) + 1, char);
+    strcpy(res->ident, resname);
+
+    value  = NEW(1, int);
+    *value = res_id;
+    texpdf_ht_append_table(&rc->index, resname, strlen(resname), value);
+  }
+  res->category = cat_id;
+  res->flags    = flags;
+  if (flags & PDF_RES_FLUSH_IMMEDIATE) {
+    res->reference = texpdf_ref_obj(object);
+    texpdf_release_obj(object);
+  } else {
+    res->object = object;
+  }
+  rc->count++;
+
+  return RESOURCE_ID(cat_id, res_id);
 }
 
 #if 0
@@ -273,9 +320,7 @@ pdf_resource_exist (const char *category, const char *resname)
 long
 pdf_findresource (const char *category, const char *resname)
 {
-  pdf_res *res;
-  int      res_id, cat_id;
-  struct res_cache *rc;
+  int  cat_id;
 
   ASSERT(resname && category);
 
@@ -285,15 +330,20 @@ pdf_findresource (const char *category, const char *resname)
     return -1;
   }
 
-  rc = &resources[cat_id];
-  for (res_id = 0; res_id < rc->count; res_id++) {
-    res = &rc->resources[res_id];
-    if (!strcmp(resname, res->ident)) {
-      return (long) (cat_id << 16|res_id);
-    }
-  }
+  return pdf_findresource_id(cat_id, resname);
+}
+
+long
+pdf_findresource_id (int cat_id, const char *resname)
+{
+  int  res_id;
+
+  ASSERT(resname);
+  ASSERT(cat_id >= 0 && cat_id < PDF_NUM_RESOURCE_CATEGORIES);
+
+  res_id = lookup_resource(&resources[cat_id], resname);
 
-  return -1;
+  return res_id < 0 ? -1 : RESOURCE_ID(cat_id, res_id);
 }
 
 pdf_obj *
@@ -303,8 +353,8 @@ texpdf_get_resource_reference (long rc_id)
   struct res_cache *rc;
   pdf_res *res;
 
-  cat_id = (rc_id >> 16) & 0xffff;
-  res_id = rc_id & 0xffff;
+  cat_id = RESOURCE_CAT(rc_id);
+  res_id = RESOURCE_IDX(rc_id);
 
   if (cat_id < 0 ||
       cat_id >= PDF_NUM_RESOURCE_CATEGORIES) {
@@ -338,8 +388,8 @@ texpdf_get_resource (long rc_id)
   struct res_cache *rc;
   pdf_res *res;
 
-  cat_id = (rc_id >> 16) & 0xffff;
-  res_id = rc_id & 0xffff;
+  cat_id = RESOURCE_CAT(rc_id);
+  res_id = RESOURCE_IDX(rc_id);
 
   if (cat_id < 0 ||
       cat_id >= PDF_NUM_RESOURCE_CATEGORIES) {
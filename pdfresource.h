@@ -27,12 +27,27 @@
 
 #define PDF_RES_FLUSH_IMMEDIATE 1
 
+#define PDF_RESOURCE_FONT       0
+#define PDF_RESOURCE_CIDFONT    1
+#define PDF_RESOURCE_ENCODING   2
+#define PDF_RESOURCE_CMAP       3
+#define PDF_RESOURCE_XOBJECT    4
+#define PDF_RESOURCE_COLORSPACE 5
+#define PDF_RESOURCE_SHADING    6
+#define PDF_RESOURCE_PATTERN    7
+#define PDF_RESOURCE_GSTATE     8
+
 extern void     texpdf_init_resources  (void);
 extern void     texpdf_close_resources (void);
 
 extern long     pdf_defineresource (const char *category,
 				    const char *resname,  pdf_obj *object, int flags);
 extern long     pdf_findresource   (const char *category, const char *resname);
+
+/* Same as above, with the category given as a PDF_RESOURCE_* constant. */
+extern long     pdf_defineresource_id (int cat_id,
+				       const char *resname, pdf_obj *object, int flags);
+extern long     pdf_findresource_id   (int cat_id, const char *resname);
 #if 0
 extern int      pdf_resource_exist (const char *category, const char *resname);
 #endif
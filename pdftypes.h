@@ -73,6 +73,15 @@ typedef struct pdf_page
   pdf_obj  *beads;
 } pdf_page;
 
+/* Open (not yet written) Pages node of a streamed page tree. */
+typedef struct pdf_page_node
+{
+  pdf_obj  *dict;
+  pdf_obj  *ref;
+  pdf_obj  *kids;
+  long      count;
+} pdf_page_node;
+
 typedef struct pdf_olitem
 {
   pdf_obj *dict;
@@ -122,6 +131,11 @@ typedef struct pdf_doc
     long      num_entries; /* This is not actually total number of pages. */
     long      max_entries;
     pdf_page *entries;
+
+    /* Page dicts are written at end of page, see doc_stream_page(). */
+    int            streaming;
+    int            num_levels;
+    pdf_page_node *levels;
   } pages;
 
   struct {
@@ -144,6 +158,7 @@ typedef struct pdf_doc
   struct {
     int    outline_open_depth;
     double annot_grow;
+    int    page_cluster;
   } opt;
 
   struct form_list_node *pending_forms;
@@ -95,12 +95,13 @@ struct ic_
 {
   int         count, capacity;
   pdf_ximage *ximages;
-};
 
-static struct ic_  _ic = {
-  0, 0, NULL
+  struct ht_table idents; /* ident -> last image loaded from it */
+  struct ht_table keys;   /* (ident, page_no, attr_dict) -> image */
 };
 
+static struct ic_  _ic;
+
 void
 texpdf_set_metapost_handler(metapost_handler_t handler) {
   metapost_handler = handler;
@@ -164,6 +165,72 @@ pdf_clean_ximage_struct (pdf_ximage *I)
 }
 
 
+static void
+hval_free (void *hval)
+{
+  RELEASE(hval);
+}
+
+/* Lookup key for an image: ident, its NUL, then page_no and the
+ * identity of the attribute dictionary. The key is built in buf if it
+ * fits there; otherwise it is allocated and must be released.
+ */
+#define XIMAGE_KEY_SIZE 128
+static char *
+ximage_key (char *buf, int *keylen,
+	    const char *ident, long page_no, pdf_obj *dict)
+{
+  int   len = strlen(ident) + 1;
+  char *key = buf;
+
+  *keylen = len + sizeof(long) + sizeof(pdf_obj *);
+  if (*keylen > XIMAGE_KEY_SIZE)
+    key = NEW(*keylen, char);
+  memcpy(key, ident, len);
+  memcpy(key + len, &page_no, sizeof(long));
+  memcpy(key + len + sizeof(long), &dict, sizeof(pdf_obj *));
+
+  return key;
+}
+
+static int
+ximage_lookup (struct ht_table *ht, const char *key, int keylen)
+{
+  int *id;
+
+  id = texpdf_ht_lookup_table(ht, key, keylen);
+
+  return id ? *id : -1;
+}
+
+static void
+ximage_register (struct ic_ *ic, int id)
+{
+  pdf_ximage *I = &ic->ximages[id];
+  int        *value;
+  char        buf[XIMAGE_KEY_SIZE], *key;
+  int         keylen;
+
+  if (!I->ident)
+    return;
+
+  value = texpdf_ht_lookup_table(&ic->idents, I->ident, strlen(I->ident));
+  if (!value) {
+    value = NEW(1, int);
+    texpdf_ht_append_table(&ic->idents, I->ident, strlen(I->ident), value);
+  }
+  *value = id;
+
+  key = ximage_key(buf, &keylen, I->ident, I->page_no, I->attr_dict);
+  if (ximage_lookup(&ic->keys, key, keylen) < 0) {
+    value  = NEW(1, int);
+    *value = id;
+    texpdf_ht_append_table(&ic->keys, key, keylen, value);
+  }
+  if (key != buf)
+    RELEASE(key);
+}
+
 void
 texpdf_init_images (void)
 {
@@ -171,6 +238,8 @@ texpdf_init_images (void)
   ic->count    = 0;
   ic->capacity = 0;
   ic->ximages  = NULL;
+  texpdf_ht_init_table(&ic->idents, hval_free);
+  texpdf_ht_init_table(&ic->keys, hval_free);
 }
 
 void
@@ -201,6 +270,8 @@ texpdf_close_images (void)
     ic->ximages = NULL;
     ic->count = ic->capacity = 0;
   }
+  texpdf_ht_clear_table(&ic->idents);
+  texpdf_ht_clear_table(&ic->keys);
 
   if (_opts.cmdtmpl)
     RELEASE(_opts.cmdtmpl);
@@ -335,6 +406,7 @@ load_image (const char *ident, const char *fullname, int format, FILE  *fp,
   }
 
   ic->count++;
+  ximage_register(ic, id);
 
   return  id;
 
@@ -357,16 +429,22 @@ texpdf_ximage_findresource (pdf_doc *p, const char *ident, long page_no, pdf_obj
   char       *fullname, *f = NULL;
   int         format;
   FILE       *fp;
-
-  for (id = 0; id < ic->count; id++) {
-    I = &ic->ximages[id];
-    if (I->ident && !strcmp(ident, I->ident)) {
-      f = I->filename;
-      if (I->page_no == page_no + (page_no < 0 ? I->page_count+1 : 0) &&
-          I->attr_dict == dict) {
-	return  id;
-      }
-    }
+  int        *last;
+
+  last = texpdf_ht_lookup_table(&ic->idents, ident, strlen(ident));
+  if (last) {
+    char  buf[XIMAGE_KEY_SIZE], *key;
+    int   keylen;
+
+    I = &ic->ximages[*last];
+    f = I->filename;
+    key = ximage_key(buf, &keylen, ident,
+		     page_no + (page_no < 0 ? I->page_count+1 : 0), dict);
+    id = ximage_lookup(&ic->keys, key, keylen);
+    if (key != buf)
+      RELEASE(key);
+    if (id >= 0)
+      return  id;
   }
 
   if (f) {
@@ -608,6 +686,7 @@ texpdf_ximage_defineresource (const char *ident,
     ERROR("Unknown XObject subtype: %d", subtype);
   }
   ic->count++;
+  ximage_register(ic, id);
 
   return  id;
 }
@@ -22,6 +22,10 @@
 
 #include "libtexpdf.h"
 
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
 /*
  * type:
  *  `true' (0x74727565): TrueType (Mac)
@@ -36,6 +40,78 @@
 #define SFNT_POSTSCRIPT 0x4f54544fUL
 #define SFNT_TTC        0x74746366UL
 
+/*
+ * The whole font file is mapped (or, where mmap() is unavailable, read)
+ * into memory once, and all field accesses are served from there.
+ * sfont->stream stays open for the CFF reader in cff.c.
+ */
+static void
+sfnt_load_stream (sfnt *sfont)
+{
+  long size;
+
+  size = file_size(sfont->stream);
+
+  sfont->buffer = NULL;
+  sfont->size   = 0;
+  sfont->pos    = 0;
+  sfont->mapped = 0;
+
+  if (size <= 0)
+    return;
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  {
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(sfont->stream), 0);
+    if (p != MAP_FAILED) {
+      sfont->buffer = p;
+      sfont->size   = size;
+      sfont->mapped = 1;
+      return;
+    }
+  }
+#endif
+
+  sfont->buffer = NEW(size, unsigned char);
+  if (fread(sfont->buffer, 1, size, sfont->stream) != (size_t) size)
+    ERROR("sfnt: Reading font file failed...");
+  rewind(sfont->stream);
+  sfont->size = size;
+}
+
+ULONG
+sfnt_get_bigendian (sfnt *sfont, int n)
+{
+  const unsigned char *p;
+  ULONG  val = 0;
+
+  if (sfont->pos > sfont->size || n > sfont->size - sfont->pos)
+    ERROR("File ended prematurely\n");
+
+  p = sfont->buffer + sfont->pos;
+  sfont->pos += n;
+  while (n-- > 0)
+    val = (val << 8) | *p++;
+
+  return val;
+}
+
+ULONG
+sfnt_read_bytes (void *buf, ULONG len, sfnt *sfont)
+{
+  if (sfont->pos >= sfont->size)
+    return 0;
+  if (len > sfont->size - sfont->pos)
+    len = sfont->size - sfont->pos;
+
+  memcpy(buf, sfont->buffer + sfont->pos, len);
+  sfont->pos += len;
+
+  return len;
+}
+
 sfnt *
 sfnt_open (FILE *fp)
 {
@@ -49,6 +125,7 @@ sfnt_open (FILE *fp)
   sfont = NEW(1, sfnt);
 
   sfont->stream = fp;
+  sfnt_load_stream(sfont);
 
   type = sfnt_get_ulong(sfont);
 
@@ -62,7 +139,7 @@ sfnt_open (FILE *fp)
     sfont->type = SFNT_TYPE_TTC;
   }
 
-  rewind(sfont->stream);
+  sfnt_seek_set(sfont, 0);
 
   sfont->directory = NULL;
   sfont->offset = 0UL;
@@ -84,6 +161,7 @@ dfont_open (FILE *fp, int index)
   sfont = NEW(1, sfnt);
 
   sfont->stream = fp;
+  sfnt_load_stream(sfont);
 
   rdata_pos = sfnt_get_ulong(sfont);
   map_pos   = sfnt_get_ulong(sfont);
@@ -101,7 +179,7 @@ dfont_open (FILE *fp, int index)
   }
 
   if (i > tags_num) {
-    RELEASE(sfont);
+    sfnt_close(sfont);
     return NULL;
   }
 
@@ -118,7 +196,7 @@ dfont_open (FILE *fp, int index)
     if (i == index) break;
   }
 
-  rewind(sfont->stream);
+  sfnt_seek_set(sfont, 0);
 
   sfont->type = SFNT_TYPE_DFONT;
   sfont->directory = NULL;
@@ -155,6 +233,14 @@ sfnt_close (sfnt *sfont)
   if (sfont) {
     if (sfont->directory)
       release_directory(sfont->directory);
+    if (sfont->buffer) {
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+      if (sfont->mapped)
+        munmap(sfont->buffer, sfont->size);
+      else
+#endif
+        RELEASE(sfont->buffer);
+    }
     RELEASE(sfont);
   }
 
@@ -426,7 +512,7 @@ sfnt_create_FontFile_stream (sfnt *sfont)
   pdf_obj *stream;
   pdf_obj *stream_dict;
   struct sfnt_table_directory *td;
-  long     offset, nb_read, length;
+  long     offset, length;
   int      i, sr;
   char    *p;
 
@@ -486,19 +572,14 @@ sfnt_create_FontFile_stream (sfnt *sfont)
 	  return NULL;
 	}
 
-	length = td->tables[i].length;
-	sfnt_seek_set(sfont, td->tables[i].offset); 
-	while (length > 0) {
-	  nb_read = sfnt_read(wbuf, MIN(length, 1024), sfont);
-	  if (nb_read < 0) {
-	    texpdf_release_obj(stream);
-	    ERROR("Reading file failed...");
-	    return NULL;
-	  } else if (nb_read > 0) {
-	    texpdf_add_stream(stream, wbuf, nb_read);
-	  }
-	  length -= nb_read;
+	if (td->tables[i].offset > sfont->size ||
+	    td->tables[i].length > sfont->size - td->tables[i].offset) {
+	  texpdf_release_obj(stream);
+	  ERROR("Reading file failed...");
+	  return NULL;
 	}
+	texpdf_add_stream(stream,
+		       sfont->buffer + td->tables[i].offset, td->tables[i].length);
       } else {
 	texpdf_add_stream(stream,
 		       td->tables[i].data, td->tables[i].length);
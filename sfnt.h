@@ -78,22 +78,31 @@ typedef struct
   struct sfnt_table_directory *directory;
   FILE  *stream;
   ULONG  offset;
+  /* Whole font file, mapped or read into memory by sfnt_open(). */
+  unsigned char *buffer;
+  ULONG  size;
+  ULONG  pos;
+  int    mapped;
 } sfnt;
 
 /* Convert sfnt "fixed" type to double */
 #define fixed(a) ((double)((a)%0x10000L)/(double)(0x10000L) + \
  (a)/0x10000L - (((a)/0x10000L > 0x7fffL) ? 0x10000L : 0))
 
-/* get_***_*** from numbers.h */
-#define sfnt_get_byte(s)   ((BYTE)   get_unsigned_byte((s)->stream))
-#define sfnt_get_char(s)   ((CHAR)   get_signed_byte  ((s)->stream))
-#define sfnt_get_ushort(s) ((USHORT) get_unsigned_pair((s)->stream))
-#define sfnt_get_short(s)  ((SHORT)  get_signed_pair  ((s)->stream))
-#define sfnt_get_ulong(s)  ((ULONG)  get_unsigned_quad((s)->stream))
-#define sfnt_get_long(s)   ((LONG)   get_signed_quad  ((s)->stream))
+/* Big-endian fields are decoded from the in-memory copy of the font. */
+extern ULONG sfnt_get_bigendian (sfnt *sfont, int n);
+extern ULONG sfnt_read_bytes    (void *buf, ULONG len, sfnt *sfont);
 
-#define sfnt_seek_set(s,o)   seek_absolute((s)->stream, (o))
-#define sfnt_read(b,l,s)     fread((b), 1, (l), (s)->stream)
+#define sfnt_get_byte(s)   ((BYTE)   sfnt_get_bigendian((s), 1))
+#define sfnt_get_char(s)   ((CHAR)   sfnt_get_bigendian((s), 1))
+#define sfnt_get_ushort(s) ((USHORT) sfnt_get_bigendian((s), 2))
+#define sfnt_get_short(s)  ((SHORT)  sfnt_get_bigendian((s), 2))
+#define sfnt_get_ulong(s)  ((ULONG)  sfnt_get_bigendian((s), 4))
+#define sfnt_get_long(s)   ((LONG)   (int32_t) sfnt_get_bigendian((s), 4))
+
+#define sfnt_seek_set(s,o)   ((s)->pos = (o))
+#define sfnt_tell(s)         ((s)->pos)
+#define sfnt_read(b,l,s)     sfnt_read_bytes((b), (l), (s))
 
 extern  int  put_big_endian (void *s, LONG q, int n);
 
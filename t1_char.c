@@ -36,20 +36,15 @@
 #define CS_SUBR_RETURN   2
 #define CS_CHAR_END      3
 
-static int status = CS_PARSE_ERROR;
-
-#define DST_NEED(a,b) {if ((a) < (b)) { status = CS_BUFFER_ERROR ; return ; }}
-#define SRC_NEED(a,b) {if ((a) < (b)) { status = CS_PARSE_ERROR  ; return ; }}
-#define NEED(a,b)     {if ((a) < (b)) { status = CS_STACK_ERROR  ; return ; }}
+#define DST_NEED(a,b) {if ((a) < (b)) { cd->status = CS_BUFFER_ERROR ; return ; }}
+#define SRC_NEED(a,b) {if ((a) < (b)) { cd->status = CS_PARSE_ERROR  ; return ; }}
+#define NEED(a,b)     {if ((a) < (b)) { cd->status = CS_STACK_ERROR  ; return ; }}
 
 #define T1_CS_PHASE_INIT 0
 #define T1_CS_PHASE_HINT 1
 #define T1_CS_PHASE_PATH 2
 #define T1_CS_PHASE_FLEX 3
 
-static int phase = -1;
-static int nest  = -1;
-
 #ifndef CS_STEM_ZONE_MAX
 #define CS_STEM_ZONE_MAX 96
 #endif
@@ -91,6 +86,10 @@ typedef struct {
 #define T1_CS_FLAG_USE_CNTRMASK (1 << 1)
 #define T1_CS_FLAG_USE_SEAC     (1 << 2)
 
+/*
+ * Charstring context: the decoded glyph description together with the
+ * interpreter state, one per conversion so that conversions are reentrant.
+ */
 typedef struct {
   int flags;
   struct {
@@ -107,14 +106,18 @@ typedef struct {
   t1_stem   stems[CS_STEM_ZONE_MAX];
   t1_cpath *charpath;
   t1_cpath *lastpath;
-} t1_chardesc;
-
-static int cs_stack_top = 0;
-static int ps_stack_top = 0;
 
-/* [vh]stem support require one more stack size. */
-static double cs_arg_stack[CS_ARG_STACK_MAX+1];
-static double ps_arg_stack[PS_ARG_STACK_MAX];
+  /* Interpreter state */
+  int        status;
+  int        phase;
+  int        nest;
+  cff_index *subrs;
+  int        cs_stack_top;
+  int        ps_stack_top;
+  /* [vh]stem support require one more stack size. */
+  double     cs_arg_stack[CS_ARG_STACK_MAX+1];
+  double     ps_arg_stack[PS_ARG_STACK_MAX];
+} t1_chardesc;
 
 #define CS_HINT_DECL -1
 #define CS_FLEX_CTRL -2
@@ -311,19 +314,19 @@ copy_args (double *args1, double *args2, int count)
  * Stack:
  */
 #define LIMITCHECK(n) do {\
-                           if (cs_stack_top+(n) > CS_ARG_STACK_MAX) {\
-                             status = CS_STACK_ERROR;\
+                           if (cd->cs_stack_top+(n) > CS_ARG_STACK_MAX) {\
+                             cd->status = CS_STACK_ERROR;\
                              return;\
                            }\
                       } while (0)
 #define CHECKSTACK(n) do {\
-                           if (cs_stack_top < (n)) {\
-                             status = CS_STACK_ERROR;\
+                           if (cd->cs_stack_top < (n)) {\
+                             cd->status = CS_STACK_ERROR;\
                              return;\
                            }\
                       } while (0)
 #define CLEARSTACK()  do {\
-                           cs_stack_top = 0;\
+                           cd->cs_stack_top = 0;\
                       } while (0)
 
 /*
@@ -353,8 +356,8 @@ add_charpath (t1_chardesc *cd, int type, double *argv, int argn)
   cd->lastpath = p;
 
   if (type >= 0 &&
-      phase != T1_CS_PHASE_FLEX && IS_PATH_OPERATOR(type))
-    phase = T1_CS_PHASE_PATH;
+      cd->phase != T1_CS_PHASE_FLEX && IS_PATH_OPERATOR(type))
+    cd->phase = T1_CS_PHASE_PATH;
 }
 
 static void
@@ -388,13 +391,13 @@ release_charpath (t1_chardesc *cd)
 /*
  * Type 1 charstring operators:
  */
-#define ADD_PATH(p,t,n) add_charpath((p),(t),&(cs_arg_stack[cs_stack_top-(n)]),(n))
+#define ADD_PATH(p,t,n) add_charpath((p),(t),&(cd->cs_arg_stack[cd->cs_stack_top-(n)]),(n))
 
 /*
  * Single byte operators:
  */
 static void
-do_operator1 (t1_chardesc *cd, card8 **data)
+do_operator1 (t1_chardesc *cd, card8 **data, card8 *endptr)
 {
   card8 op = **data;
 
@@ -414,9 +417,9 @@ do_operator1 (t1_chardesc *cd, card8 **data)
     break;
   case cs_hsbw:
     CHECKSTACK(2);
-    cd->sbw.wx  = cs_arg_stack[--cs_stack_top];
+    cd->sbw.wx  = cd->cs_arg_stack[--cd->cs_stack_top];
     cd->sbw.wy  = 0;
-    cd->sbw.sbx = cs_arg_stack[--cs_stack_top];
+    cd->sbw.sbx = cd->cs_arg_stack[--cd->cs_stack_top];
     cd->sbw.sby = 0;
     CLEARSTACK();
     /* hsbw does NOT set currentpoint. */
@@ -427,16 +430,16 @@ do_operator1 (t1_chardesc *cd, card8 **data)
     {
       int stem_id;
       stem_id = add_stem(cd,
-			 cs_arg_stack[cs_stack_top-2],
-			 cs_arg_stack[cs_stack_top-1],
+			 cd->cs_arg_stack[cd->cs_stack_top-2],
+			 cd->cs_arg_stack[cd->cs_stack_top-1],
 			 ((op == cs_hstem) ? HSTEM : VSTEM));
       if (stem_id < 0) {
 	WARN("Too many hints...");
-	status = CS_PARSE_ERROR;
+	cd->status = CS_PARSE_ERROR;
 	return;
       }
       /* Put stem_id onto the stack... */
-      cs_arg_stack[cs_stack_top++] = stem_id;
+      cd->cs_arg_stack[cd->cs_stack_top++] = stem_id;
       ADD_PATH(cd, CS_HINT_DECL, 1);
     }
     CLEARSTACK();
@@ -447,9 +450,9 @@ do_operator1 (t1_chardesc *cd, card8 **data)
      */
     CHECKSTACK(2);
     {
-      if (phase < T1_CS_PHASE_PATH) {
-	cs_arg_stack[cs_stack_top-2] += cd->sbw.sbx;
-	cs_arg_stack[cs_stack_top-1] += cd->sbw.sby;
+      if (cd->phase < T1_CS_PHASE_PATH) {
+	cd->cs_arg_stack[cd->cs_stack_top-2] += cd->sbw.sbx;
+	cd->cs_arg_stack[cd->cs_stack_top-1] += cd->sbw.sby;
       }
       ADD_PATH(cd, op, 2);
     }
@@ -460,24 +463,24 @@ do_operator1 (t1_chardesc *cd, card8 **data)
     CHECKSTACK(1);
     {
       int argn = 1;
-      if (phase < T1_CS_PHASE_PATH) {
+      if (cd->phase < T1_CS_PHASE_PATH) {
 	/*
 	 * The reference point for the first moveto operator is diferrent
 	 * between Type 1 charstring and Type 2 charstring. We compensate it.
 	 */
 	if (op == cs_hmoveto) {
-	  cs_arg_stack[cs_stack_top-1] += cd->sbw.sbx;
+	  cd->cs_arg_stack[cd->cs_stack_top-1] += cd->sbw.sbx;
 	  if (cd->sbw.sby != 0.0) {
-	    cs_arg_stack[cs_stack_top++] = cd->sbw.sby;
+	    cd->cs_arg_stack[cd->cs_stack_top++] = cd->sbw.sby;
 	    argn = 2;
 	    op = cs_rmoveto;
 	  }
 	} else {
-	  cs_arg_stack[cs_stack_top-1] += cd->sbw.sby;
+	  cd->cs_arg_stack[cd->cs_stack_top-1] += cd->sbw.sby;
 	  if (cd->sbw.sbx != 0.0) {
-	    cs_arg_stack[cs_stack_top]   = cs_arg_stack[cs_stack_top-1];
-	    cs_arg_stack[cs_stack_top-1] = cd->sbw.sbx;
-	    cs_stack_top++;
+	    cd->cs_arg_stack[cd->cs_stack_top]   = cd->cs_arg_stack[cd->cs_stack_top-1];
+	    cd->cs_arg_stack[cd->cs_stack_top-1] = cd->sbw.sbx;
+	    cd->cs_stack_top++;
 	    argn = 2;
 	    op = cs_rmoveto;
 	  }
@@ -488,7 +491,7 @@ do_operator1 (t1_chardesc *cd, card8 **data)
     CLEARSTACK();
     break;
   case cs_endchar:
-    status = CS_CHAR_END;
+    cd->status = CS_CHAR_END;
     CLEARSTACK();
     break;
   /* above oprators are candidate for first stack-clearing operator */
@@ -524,7 +527,7 @@ do_operator1 (t1_chardesc *cd, card8 **data)
   default:
     /* no-op ? */
     WARN("Unknown charstring operator: 0x%02x", op);
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     break;
   }
 
@@ -560,8 +563,8 @@ do_othersubr0 (t1_chardesc *cd)
 {
   t1_cpath *flex, *cur, *next;
 
-  if (ps_stack_top < 1) {
-    status = CS_PARSE_ERROR;
+  if (cd->ps_stack_top < 1) {
+    cd->status = CS_PARSE_ERROR;
     return;
   }
 
@@ -574,7 +577,7 @@ do_othersubr0 (t1_chardesc *cd)
     for (i = 1; i < 7; i++) {
       if (cur == NULL || cur->type != CS_FLEX_CTRL ||
 	  cur->num_args != 2) {
-	status = CS_PARSE_ERROR;
+	cd->status = CS_PARSE_ERROR;
 	return;
       }
       if (i == 1) {
@@ -589,7 +592,7 @@ do_othersubr0 (t1_chardesc *cd)
     }
   }
   if (cur != NULL) {
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   /*
@@ -597,27 +600,27 @@ do_othersubr0 (t1_chardesc *cd)
    * from starting point.
    */
   flex->type = cs_flex;
-  flex->args[12] = ps_arg_stack[--ps_stack_top]; /* flex depth */
+  flex->args[12] = cd->ps_arg_stack[--cd->ps_stack_top]; /* flex depth */
   flex->num_args = 13;
   flex->next   = NULL;
   cd->lastpath = flex;
 
-  phase = T1_CS_PHASE_PATH;
+  cd->phase = T1_CS_PHASE_PATH;
 }
 
 /* Start flex */
 static void
-do_othersubr1 (void)
+do_othersubr1 (t1_chardesc *cd)
 {
-  phase = T1_CS_PHASE_FLEX;
+  cd->phase = T1_CS_PHASE_FLEX;
 }
 
 /* Mark flex control point */
 static void
 do_othersubr2 (t1_chardesc *cd)
 {
-  if (phase != T1_CS_PHASE_FLEX || !cd->lastpath) {
-    status = CS_PARSE_ERROR;
+  if (cd->phase != T1_CS_PHASE_FLEX || !cd->lastpath) {
+    cd->status = CS_PARSE_ERROR;
     return;
   }
 
@@ -634,7 +637,7 @@ do_othersubr2 (t1_chardesc *cd)
     cd->lastpath->args[0] = 0.0;
     break;
   default:
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   cd->lastpath->type = CS_FLEX_CTRL;
@@ -651,11 +654,11 @@ do_othersubr3 (t1_chardesc *cd)
 }
 
 static void
-do_othersubr12 (void)
+do_othersubr12 (t1_chardesc *cd)
 {
   /* Othersubr12 call must immediately follow the hsbw or sbw. */
-  if (phase != T1_CS_PHASE_INIT) {
-    status = CS_PARSE_ERROR;
+  if (cd->phase != T1_CS_PHASE_INIT) {
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   /* noop */
@@ -669,24 +672,24 @@ do_othersubr13 (t1_chardesc *cd)
   double pos, del;
 
   /* After #12 callothersubr or hsbw or sbw. */
-  if (phase != T1_CS_PHASE_INIT) {
-    status = CS_PARSE_ERROR;
+  if (cd->phase != T1_CS_PHASE_INIT) {
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   for (n = 0; n < CS_STEM_GROUP_MAX; n++) {
     stemgroups[n].num_stems = 0;
   }
 
-  num_hgroups = (int) ps_arg_stack[--ps_stack_top];
+  num_hgroups = (int) cd->ps_arg_stack[--cd->ps_stack_top];
   if (num_hgroups < 0 || num_hgroups > CS_STEM_GROUP_MAX) {
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   n = 0; pos = 0.0;
-  while (ps_stack_top >= 2 && n < num_hgroups) {
+  while (cd->ps_stack_top >= 2 && n < num_hgroups) {
     /* add_stem() add sidebearing */
-    pos += ps_arg_stack[--ps_stack_top];
-    del  = ps_arg_stack[--ps_stack_top];
+    pos += cd->ps_arg_stack[--cd->ps_stack_top];
+    del  = cd->ps_arg_stack[--cd->ps_stack_top];
     stem_id = add_stem(cd,
 		       (del < 0.0) ? pos + del : pos,
 		       (del < 0.0) ? -del : del,
@@ -700,20 +703,20 @@ do_othersubr13 (t1_chardesc *cd)
     }
   }
   if (n != num_hgroups) {
-    status = CS_STACK_ERROR;
+    cd->status = CS_STACK_ERROR;
     return;
   }
 
-  num_vgroups = (int) ps_arg_stack[--ps_stack_top];
+  num_vgroups = (int) cd->ps_arg_stack[--cd->ps_stack_top];
   if (num_vgroups < 0 || num_vgroups > CS_STEM_GROUP_MAX) {
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   n = 0; pos = 0.0;
-  while (ps_stack_top >= 2 && n < num_vgroups) {
+  while (cd->ps_stack_top >= 2 && n < num_vgroups) {
     /* add_stem() add sidebearing */
-    pos += ps_arg_stack[--ps_stack_top];
-    del  = ps_arg_stack[--ps_stack_top];
+    pos += cd->ps_arg_stack[--cd->ps_stack_top];
+    del  = cd->ps_arg_stack[--cd->ps_stack_top];
     stem_id = add_stem(cd,
 		       (del < 0.0) ? pos + del : pos,
 		       (del < 0.0) ? -del : del,
@@ -727,7 +730,7 @@ do_othersubr13 (t1_chardesc *cd)
     }
   }
   if (n != num_vgroups) {
-    status = CS_STACK_ERROR;
+    cd->status = CS_STACK_ERROR;
     return;
   }
 
@@ -745,23 +748,23 @@ do_callothersubr (t1_chardesc *cd)
   int argn, subrno;
 
   CHECKSTACK(2);
-  subrno = (int) cs_arg_stack[--cs_stack_top];
-  argn   = (int) cs_arg_stack[--cs_stack_top];
+  subrno = (int) cd->cs_arg_stack[--cd->cs_stack_top];
+  argn   = (int) cd->cs_arg_stack[--cd->cs_stack_top];
 
   CHECKSTACK(argn);
-  if (ps_stack_top+argn > PS_ARG_STACK_MAX) {
-    status = CS_PARSE_ERROR;
+  if (cd->ps_stack_top+argn > PS_ARG_STACK_MAX) {
+    cd->status = CS_PARSE_ERROR;
     return;
   }
   while (argn-- > 0)
-    ps_arg_stack[ps_stack_top++] = cs_arg_stack[--cs_stack_top];
+    cd->ps_arg_stack[cd->ps_stack_top++] = cd->cs_arg_stack[--cd->cs_stack_top];
 
   switch (subrno) {
   case 0:  do_othersubr0(cd) ; break;
-  case 1:  do_othersubr1()   ; break;
+  case 1:  do_othersubr1(cd) ; break;
   case 2:  do_othersubr2(cd) ; break;
   case 3:  do_othersubr3(cd) ; break;
-  case 12: do_othersubr12()  ; break;
+  case 12: do_othersubr12(cd); break;
   case 13: do_othersubr13(cd); break;
   default:
     ERROR("Unknown othersubr #%ld.", subrno);
@@ -787,10 +790,10 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
   switch(op) {
   case cs_sbw:
     CHECKSTACK(4);
-    cd->sbw.wy  = cs_arg_stack[--cs_stack_top];
-    cd->sbw.wx  = cs_arg_stack[--cs_stack_top];
-    cd->sbw.sby = cs_arg_stack[--cs_stack_top];
-    cd->sbw.sbx = cs_arg_stack[--cs_stack_top];
+    cd->sbw.wy  = cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->sbw.wx  = cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->sbw.sby = cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->sbw.sbx = cd->cs_arg_stack[--cd->cs_stack_top];
     CLEARSTACK();
     break;
   case cs_hstem3:
@@ -806,18 +809,18 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
       for (i = 2; i >= 0; i--) {
 	int stem_id;
 	stem_id = add_stem(cd,
-			   cs_arg_stack[cs_stack_top-2*i-2],
-			   cs_arg_stack[cs_stack_top-2*i-1],
+			   cd->cs_arg_stack[cd->cs_stack_top-2*i-2],
+			   cd->cs_arg_stack[cd->cs_stack_top-2*i-1],
 			   ((op == cs_hstem3) ? HSTEM : VSTEM));
 	if (stem_id < 0) {
 	  WARN("Too many hints...");
-	  status = CS_PARSE_ERROR;
+	  cd->status = CS_PARSE_ERROR;
 	  return;
 	}
 	/* Put stem_id onto the stack... */
-	cs_arg_stack[cs_stack_top++] = stem_id;
+	cd->cs_arg_stack[cd->cs_stack_top++] = stem_id;
 	ADD_PATH(cd, CS_HINT_DECL, 1);
-	cs_stack_top--;
+	cd->cs_stack_top--;
       }
     }
     CLEARSTACK();
@@ -833,12 +836,12 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
      * Transfer a operand from PS interpreter operand stack to BuildChar
      * operand stack.
      */
-    if (ps_stack_top < 1) {
-      status = CS_PARSE_ERROR;
+    if (cd->ps_stack_top < 1) {
+      cd->status = CS_PARSE_ERROR;
       return;
     }
     LIMITCHECK(1);
-    cs_arg_stack[cs_stack_top++] = ps_arg_stack[--ps_stack_top];
+    cd->cs_arg_stack[cd->cs_stack_top++] = cd->ps_arg_stack[--cd->ps_stack_top];
     break;
   case cs_dotsection:
 #if 0
@@ -865,8 +868,8 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
     break;
   case cs_div: /* TODO: check overflow */
     CHECKSTACK(2);
-    cs_arg_stack[cs_stack_top-2] /= cs_arg_stack[cs_stack_top-1];
-    cs_stack_top--;
+    cd->cs_arg_stack[cd->cs_stack_top-2] /= cd->cs_arg_stack[cd->cs_stack_top-1];
+    cd->cs_stack_top--;
     break;
   case cs_callothersubr:
     do_callothersubr(cd);
@@ -874,19 +877,19 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
   case cs_seac:
     CHECKSTACK(5);
     cd->flags |= T1_CS_FLAG_USE_SEAC;
-    cd->seac.achar = (card8) cs_arg_stack[--cs_stack_top];
-    cd->seac.bchar = (card8) cs_arg_stack[--cs_stack_top];
-    cd->seac.ady   = cs_arg_stack[--cs_stack_top];
-    cd->seac.adx   = cs_arg_stack[--cs_stack_top];
+    cd->seac.achar = (card8) cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->seac.bchar = (card8) cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->seac.ady   = cd->cs_arg_stack[--cd->cs_stack_top];
+    cd->seac.adx   = cd->cs_arg_stack[--cd->cs_stack_top];
     /* We must compensate the difference of the glyph origin. */
     cd->seac.ady += cd->sbw.sby;
-    cd->seac.adx += cd->sbw.sbx - cs_arg_stack[--cs_stack_top];
+    cd->seac.adx += cd->sbw.sbx - cd->cs_arg_stack[--cd->cs_stack_top];
     CLEARSTACK();
     break;
   default:
     /* no-op ? */
     WARN("Unknown charstring operator: 0x0c%02x", op);
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     break;
   }
 
@@ -904,7 +907,7 @@ do_operator2 (t1_chardesc *cd, card8 **data, card8 *endptr)
 
 /* Type 2 5-bytes encoding used. */
 static void
-put_numbers (double *argv, int argn, card8 **dest, card8 *limit)
+put_numbers (t1_chardesc *cd, double *argv, int argn, card8 **dest, card8 *limit)
 {
   int i;
 
@@ -958,7 +961,7 @@ put_numbers (double *argv, int argn, card8 **dest, card8 *limit)
 }
 
 static void
-get_integer (card8 **data, card8 *endptr)
+get_integer (t1_chardesc *cd, card8 **data, card8 *endptr)
 {
   long result = 0;
   card8 b0 = **data, b1, b2;
@@ -986,19 +989,19 @@ get_integer (card8 **data, card8 *endptr)
     result = -(b0-251)*256-b1-108;
     *data += 1;
   } else {
-    status = CS_PARSE_ERROR;
+    cd->status = CS_PARSE_ERROR;
     return;
   }
 
   LIMITCHECK(1);
-  cs_arg_stack[cs_stack_top++] = (double) result;
+  cd->cs_arg_stack[cd->cs_stack_top++] = (double) result;
 
   return;
 }
 
 /* Type 1 */
 static void
-get_longint (card8 **data, card8 *endptr)
+get_longint (t1_chardesc *cd, card8 **data, card8 *endptr)
 {
   long result = 0;
   int  i;
@@ -1015,7 +1018,7 @@ get_longint (card8 **data, card8 *endptr)
   }
 
   LIMITCHECK(1);
-  cs_arg_stack[cs_stack_top++] = (double) result;
+  cd->cs_arg_stack[cd->cs_stack_top++] = (double) result;
 
   return;
 }
@@ -1026,59 +1029,90 @@ get_longint (card8 **data, card8 *endptr)
  *   We cannot do backword parsing due to subroutine, div etc.
  */
 
+static void
+t1char_build_charpath (t1_chardesc *cd, card8 **data, card8 *endptr);
+
+static void
+do_callsubr (t1_chardesc *cd, card8 **data, card8 *endptr)
+{
+  cff_index *subrs = cd->subrs;
+  card8     *subr;
+  long       len;
+  int        idx;
+
+  if (cd->cs_stack_top < 1) {
+    cd->status = CS_STACK_ERROR;
+    return;
+  }
+  idx = cd->cs_arg_stack[--cd->cs_stack_top];
+  if (!subrs || idx >= subrs->count)
+    ERROR("Invalid Subr#.");
+  subr = subrs->data + subrs->offset[idx] - 1;
+  len  = subrs->offset[idx+1] - subrs->offset[idx];
+  t1char_build_charpath(cd, &subr, subr+len);
+  *data += 1;
+}
+
+static void
+do_return (t1_chardesc *cd, card8 **data, card8 *endptr)
+{
+  cd->status = CS_SUBR_RETURN;
+}
+
+/*
+ * Operators and the shortint prefix are dispatched on their first byte.
+ */
+typedef void (*t1_operator) (t1_chardesc *cd, card8 **data, card8 *endptr);
+
+static const t1_operator t1_operators[32] = {
+  do_operator1, do_operator1, do_operator1, do_operator1, /*  0 -  3 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /*  4 -  7 */
+  do_operator1, do_operator1, do_callsubr,  do_return,    /*  8 - 11 */
+  do_operator2, do_operator1, do_operator1, do_operator1, /* 12 - 15 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 16 - 19 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 20 - 23 */
+  do_operator1, do_operator1, do_operator1, do_operator1, /* 24 - 27 */
+  get_integer,  do_operator1, do_operator1, do_operator1  /* 28 - 31 */
+};
+
 /* Parse charstring and build charpath. */
 static void
-t1char_build_charpath (t1_chardesc *cd,
-		       card8 **data, card8 *endptr, cff_index *subrs)
+t1char_build_charpath (t1_chardesc *cd, card8 **data, card8 *endptr)
 {
-  card8 b0 = 0, *subr;
-  long len;
+  card8 b0;
 
-  if (nest > CS_SUBR_NEST_MAX)
+  if (cd->nest > CS_SUBR_NEST_MAX)
     ERROR("Subroutine nested too deeply.");
 
-  nest++;
-  while (*data < endptr && status == CS_PARSE_OK) {
+  cd->nest++;
+  while (*data < endptr && cd->status == CS_PARSE_OK) {
     b0 = **data;
-    if (b0 == 255) {
-      get_longint(data, endptr); /* Type 1 */
-    } else if (b0 == cs_return) {
-      status = CS_SUBR_RETURN;
-    } else if (b0 == cs_callsubr) {
-      if (cs_stack_top < 1) {
-	status = CS_STACK_ERROR;
-      } else {
-	int idx;
-
-	idx = cs_arg_stack[--cs_stack_top];
-	if (!subrs || idx >= subrs->count)
-	  ERROR("Invalid Subr#.");
-	subr = subrs->data + subrs->offset[idx] - 1;
-	len  = subrs->offset[idx+1] - subrs->offset[idx];
-	t1char_build_charpath(cd, &subr, subr+len, subrs);
-	*data += 1;
+    if (b0 >= 32 && b0 <= 246) { /* int (1), by far the most common */
+      if (cd->cs_stack_top + 1 > CS_ARG_STACK_MAX) {
+	cd->status = CS_STACK_ERROR;
+	break;
       }
-    } else if (b0 == cs_escape) {
-      do_operator2(cd, data, endptr);
-    } else if (b0 < 32 && b0 != 28) { /* 19, 20 need mask */
-      do_operator1(cd, data);
-    } else if ((b0 <= 22 && b0 >= 27) || b0 == 31) { /* reserved */
-      status = CS_PARSE_ERROR; /* not an error ? */
-    } else { /* integer */
-      get_integer(data, endptr);
+      cd->cs_arg_stack[cd->cs_stack_top++] = (double) (b0 - 139);
+      *data += 1;
+    } else if (b0 == 255) {
+      get_longint(cd, data, endptr); /* Type 1 */
+    } else if (b0 >= 32) { /* int (2) */
+      get_integer(cd, data, endptr);
+    } else {
+      t1_operators[b0](cd, data, endptr);
     }
   }
 
-  if (status == CS_SUBR_RETURN) {
-    status = CS_PARSE_OK;
-  } else if (status == CS_CHAR_END && *data < endptr) {
+  if (cd->status == CS_SUBR_RETURN) {
+    cd->status = CS_PARSE_OK;
+  } else if (cd->status == CS_CHAR_END && *data < endptr) {
     if (!(*data == endptr - 1 && **data == cs_return))
       WARN("Garbage after endchar. (%ld bytes)", (long) (endptr - *data));
-  } else if (status < CS_PARSE_OK) { /* error */
-    ERROR("Parsing charstring failed: (status=%d, stack=%d)", status, cs_stack_top);
+  } else if (cd->status < CS_PARSE_OK) { /* error */
+    ERROR("Parsing charstring failed: (status=%d, stack=%d)", cd->status, cd->cs_stack_top);
   }
 
-  nest--;
+  cd->nest--;
 
   return;
 }
@@ -1286,10 +1320,10 @@ do_postproc (t1_chardesc *cd)
 }
 
 #define RESET_STATE() do {\
-  status = CS_PARSE_OK;\
-  phase  = T1_CS_PHASE_INIT;\
-  nest   = 0;\
-  ps_stack_top = 0;\
+  cd->status = CS_PARSE_OK;\
+  cd->phase  = T1_CS_PHASE_INIT;\
+  cd->nest   = 0;\
+  cd->ps_stack_top = 0;\
 } while (0)
 
 int
@@ -1301,9 +1335,10 @@ t1char_get_metrics (card8 *src, long srclen, cff_index *subrs, t1_ginfo *ginfo)
   init_charpath(cd);
   RESET_STATE();
   CLEARSTACK();
-  t1char_build_charpath(cd, &src, src+srclen, subrs);
-  if (cs_stack_top != 0 || ps_stack_top != 0)
-    WARN("Stack not empty. (%d, %d)", cs_stack_top, ps_stack_top);
+  cd->subrs = subrs;
+  t1char_build_charpath(cd, &src, src+srclen);
+  if (cd->cs_stack_top != 0 || cd->ps_stack_top != 0)
+    WARN("Stack not empty. (%d, %d)", cd->cs_stack_top, cd->ps_stack_top);
   do_postproc(cd);
   if (ginfo) {
     ginfo->wx = cd->sbw.wx;
@@ -1330,8 +1365,8 @@ t1char_get_metrics (card8 *src, long srclen, cff_index *subrs, t1_ginfo *ginfo)
 #define CHECK_BUFFER(n) if (dst+(n) >= endptr) {\
   ERROR("Buffer overflow.");\
 }
-#define CHECK_STATUS()  if (status != CS_PARSE_OK) {\
-  ERROR("Charstring encoder error: %d", status);\
+#define CHECK_STATUS()  if (cd->status != CS_PARSE_OK) {\
+  ERROR("Charstring encoder error: %d", cd->status);\
 }
 
 /*
@@ -1357,7 +1392,7 @@ t1char_encode_charpath (t1_chardesc *cd,
    */
   if (cd->sbw.wx != default_width) {
     double wx = cd->sbw.wx - nominal_width;
-    put_numbers(&wx, 1, &dst, endptr);
+    put_numbers(cd, &wx, 1, &dst, endptr);
     CHECK_STATUS();
   }
   /*
@@ -1374,7 +1409,7 @@ t1char_encode_charpath (t1_chardesc *cd,
 		 (cd->stems[i].pos) :
 		 (cd->stems[i].pos - (cd->stems[i-1].pos + cd->stems[i-1].del)));
       stem[1] = cd->stems[i].del;
-      put_numbers(stem, 2, &dst, endptr);
+      put_numbers(cd, stem, 2, &dst, endptr);
       CHECK_STATUS();
       reset = 0;
       if (2*num_hstems > CS_ARG_STACK_MAX - 3) {
@@ -1395,7 +1430,7 @@ t1char_encode_charpath (t1_chardesc *cd,
 		   (cd->stems[i].pos) :
 		   (cd->stems[i].pos - (cd->stems[i-1].pos + cd->stems[i-1].del)));
 	stem[1] = cd->stems[i].del;
-	put_numbers(stem, 2, &dst, endptr);
+	put_numbers(cd, stem, 2, &dst, endptr);
 	CHECK_STATUS();
 	reset = 0;
 	if (2*num_vstems > CS_ARG_STACK_MAX - 3) {
@@ -1472,7 +1507,7 @@ t1char_encode_charpath (t1_chardesc *cd,
     case cs_rrcurveto:  case cs_hvcurveto: case cs_vhcurveto:
     case cs_rlinecurve: case cs_rcurveline:
       {
-	put_numbers(curr->args, curr->num_args, &dst, endptr);
+	put_numbers(cd, curr->args, curr->num_args, &dst, endptr);
 	CHECK_STATUS();
 	CHECK_BUFFER(1);
 	*dst++ = (card8) curr->type;
@@ -1482,7 +1517,7 @@ t1char_encode_charpath (t1_chardesc *cd,
     case cs_flex: case cs_hflex:
     case cs_hflex1:
       {
-	put_numbers(curr->args, curr->num_args, &dst, endptr);
+	put_numbers(cd, curr->args, curr->num_args, &dst, endptr);
 	CHECK_STATUS();
 	CHECK_BUFFER(2);
 	*dst++ = (card8) cs_escape;
@@ -1505,7 +1540,7 @@ t1char_encode_charpath (t1_chardesc *cd,
     seac[1] = cd->seac.ady;
     seac[2] = cd->seac.bchar;
     seac[3] = cd->seac.achar;
-    put_numbers(seac, 4, &dst, endptr);
+    put_numbers(cd, seac, 4, &dst, endptr);
     CHECK_STATUS();
     CHECK_BUFFER(2);
     WARN("Obsolete four arguments of \"endchar\" will be used for Type 1 \"seac\" operator.");
@@ -1529,9 +1564,10 @@ t1char_convert_charstring (card8 *dst, long dstlen,
   init_charpath(cd);
   RESET_STATE();
   CLEARSTACK();
-  t1char_build_charpath(cd, &src, src+srclen, subrs);
-  if (cs_stack_top != 0 || ps_stack_top != 0)
-    WARN("Stack not empty. (%d, %d)", cs_stack_top, ps_stack_top);
+  cd->subrs = subrs;
+  t1char_build_charpath(cd, &src, src+srclen);
+  if (cd->cs_stack_top != 0 || cd->ps_stack_top != 0)
+    WARN("Stack not empty. (%d, %d)", cd->cs_stack_top, cd->ps_stack_top);
   do_postproc(cd);
   SORT_STEMS(cd);
 
@@ -1095,7 +1095,10 @@ t1_get_fontname (FILE *fp, char *fontname)
 static void
 init_cff_font (cff_font *cff)
 {
-  cff->stream = NULL;
+  cff->buffer = NULL;
+  cff->size   = 0;
+  cff->pos    = 0;
+  cff->buffer_owned = 0;
   cff->filter = 0;
   cff->fontname = NULL;
   cff->index    = 0;
@@ -694,7 +694,7 @@ handle_CIDFont (sfnt *sfont,
   if (num_glyphs < 1)
     ERROR("No glyph contained in this font...");
 
-  cffont = cff_open(sfont->stream, offset, 0);
+  cffont = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
   if (!cffont)
     ERROR("Could not open CFF font...");
 
@@ -836,83 +836,74 @@ handle_subst_glyphs (CMap *cmap,
                      cff_font *cffont)
 {
   USHORT count;
-  USHORT i;
+  long   i;
   struct tt_post_table *post = NULL;
 
   if (!cmap_add)
     post = tt_read_post_table(sfont);
 
-  for (count = 0, i = 0; i < 8192; i++) {
-    int   j;
+  for (count = 0, i = used_chars2_next(used_glyphs, 0); i >= 0;
+       i = used_chars2_next(used_glyphs, i + 1)) {
+    USHORT gid = i;
     long  len, inbytesleft, outbytesleft;
     const unsigned char *inbuf;
     unsigned char *outbuf;
 
-    if (used_glyphs[i] == 0)
-      continue;
-
-    for (j = 0; j < 8; j++) {
-      USHORT gid = 8 * i + j;
-
-      if (!is_used_char2(used_glyphs, gid))
-        continue;
-
-      if (!cmap_add) {
+    if (!cmap_add) {
 #define MAX_UNICODES	16
-        /* try to look up Unicode values from the glyph name... */
-        char* name;
-        long unicodes[MAX_UNICODES];
-        int  unicode_count = -1;
-        name = sfnt_get_glyphname(post, cffont, gid);
-        if (name) {
-          unicode_count = agl_get_unicodes(name, unicodes, MAX_UNICODES);
-        }
+      /* try to look up Unicode values from the glyph name... */
+      char* name;
+      long unicodes[MAX_UNICODES];
+      int  unicode_count = -1;
+      name = sfnt_get_glyphname(post, cffont, gid);
+      if (name) {
+        unicode_count = agl_get_unicodes(name, unicodes, MAX_UNICODES);
+      }
 #undef MAX_UNICODES
-        if (unicode_count == -1) {
-          if (name)
-            MESG("No Unicode mapping available: GID=%u, name=%s\n", gid, name);
-          else
-            MESG("No Unicode mapping available: GID=%u\n", gid);
-        } else {
-          /* the Unicode characters go into wbuf[2] and following, in UTF16BE */
-          /* we rely on WBUF_SIZE being more than adequate for MAX_UNICODES  */
-          unsigned char* p = wbuf + 2;
-          int  k;
-          len = 0;
-          for (k = 0; k < unicode_count; ++k) {
-            len += UC_sput_UTF16BE(unicodes[k], &p, wbuf+WBUF_SIZE);
-          }
-          wbuf[0] = (gid >> 8) & 0xff;
-          wbuf[1] =  gid & 0xff;
-          CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
-        }
-        RELEASE(name);
+      if (unicode_count == -1) {
+        if (name)
+          MESG("No Unicode mapping available: GID=%u, name=%s\n", gid, name);
+        else
+          MESG("No Unicode mapping available: GID=%u\n", gid);
       } else {
+        /* the Unicode characters go into wbuf[2] and following, in UTF16BE */
+        /* we rely on WBUF_SIZE being more than adequate for MAX_UNICODES  */
+        unsigned char* p = wbuf + 2;
+        int  k;
+        len = 0;
+        for (k = 0; k < unicode_count; ++k) {
+          len += UC_sput_UTF16BE(unicodes[k], &p, wbuf+WBUF_SIZE);
+        }
         wbuf[0] = (gid >> 8) & 0xff;
         wbuf[1] =  gid & 0xff;
+        CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
+      }
+      RELEASE(name);
+    } else {
+      wbuf[0] = (gid >> 8) & 0xff;
+      wbuf[1] =  gid & 0xff;
+
+      inbuf        = wbuf;
+      inbytesleft  = 2;
+      outbuf       = wbuf + 2;
+      outbytesleft = WBUF_SIZE - 2;
+      texpdf_CMap_decode(cmap_add, &inbuf, &inbytesleft, &outbuf, &outbytesleft);
 
-        inbuf        = wbuf;
-        inbytesleft  = 2;
-        outbuf       = wbuf + 2;
-        outbytesleft = WBUF_SIZE - 2;
-        texpdf_CMap_decode(cmap_add, &inbuf, &inbytesleft, &outbuf, &outbytesleft);
-
-        if (inbytesleft != 0) {
-          WARN("CMap conversion failed...");
-        } else {
-          len = WBUF_SIZE - 2 - outbytesleft;
-          CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
-          count++;
-
-          if (verbose > VERBOSE_LEVEL_MIN) {
-            long _i;
-
-            MESG("otf_cmap>> Additional ToUnicode mapping: <%04X> <", gid);
-            for (_i = 0; _i < len; _i++) {
-              MESG("%02X", wbuf[2 + _i]);
-            }
-            MESG(">\n");
+      if (inbytesleft != 0) {
+        WARN("CMap conversion failed...");
+      } else {
+        len = WBUF_SIZE - 2 - outbytesleft;
+        CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
+        count++;
+
+        if (verbose > VERBOSE_LEVEL_MIN) {
+          long _i;
+
+          MESG("otf_cmap>> Additional ToUnicode mapping: <%04X> <", gid);
+          for (_i = 0; _i < len; _i++) {
+            MESG("%02X", wbuf[2 + _i]);
           }
+          MESG(">\n");
         }
       }
     }
@@ -936,7 +927,7 @@ prepare_CIDFont_from_sfnt(sfnt* sfont)
     return NULL;
   }
 
-  cffont = cff_open(sfont->stream, offset, 0);
+  cffont = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
   if (!cffont)
     return NULL;
 
@@ -1056,30 +1047,21 @@ create_ToUnicode_cmap (tt_cmap *ttcmap,
   CMap_add_codespacerange(cmap, srange_min, srange_max, 2);
 
   if (code_to_cid_cmap && cffont && is_cidfont) {
-    USHORT i;
-    for (i = 0; i < 8192; i++) {
-      int j;
-
-      if (used_chars[i] == 0)
-        continue;
-
-      for (j = 0; j < 8; j++) {
-        USHORT cid = 8 * i + j;
-        int ch;
-
-        if (!is_used_char2(used_chars, cid))
-          continue;
-
-        ch = CMap_reverse_decode(code_to_cid_cmap, cid);
-        if (ch >= 0) {
-          long len;
-          unsigned char *p = wbuf + 2;
-          wbuf[0] = (cid >> 8) & 0xff;
-          wbuf[1] =  cid & 0xff;
-          len = UC_sput_UTF16BE((long)ch, &p, wbuf + WBUF_SIZE);
-          CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
-          count++;
-        }
+    long i;
+    for (i = used_chars2_next(used_chars, 0); i >= 0;
+         i = used_chars2_next(used_chars, i + 1)) {
+      USHORT cid = i;
+      int ch;
+
+      ch = CMap_reverse_decode(code_to_cid_cmap, cid);
+      if (ch >= 0) {
+        long len;
+        unsigned char *p = wbuf + 2;
+        wbuf[0] = (cid >> 8) & 0xff;
+        wbuf[1] =  cid & 0xff;
+        len = UC_sput_UTF16BE((long)ch, &p, wbuf + WBUF_SIZE);
+        CMap_add_bfchar(cmap, wbuf, 2, wbuf + 2, len);
+        count++;
       }
     }
   } else {
@@ -1164,7 +1146,7 @@ otf_create_ToUnicode_stream (const char *font_name,
   cmap_name = NEW(strlen(font_name)+strlen("-UTF16")+5, char);
   sprintf(cmap_name, "%s,%03d-UTF16", normalized_font_name, ttc_index);
 
-  res_id = pdf_findresource("CMap", cmap_name);
+  res_id = pdf_findresource_id(PDF_RESOURCE_CMAP, cmap_name);
   if (res_id >= 0) {
     RELEASE(cmap_name);
     cmap_ref = texpdf_get_resource_reference(res_id);
@@ -1240,8 +1222,8 @@ otf_create_ToUnicode_stream (const char *font_name,
   CMap_set_silent(0);
 
   if (cmap_obj) {
-    res_id   = pdf_defineresource("CMap", cmap_name,
-				  cmap_obj, PDF_RES_FLUSH_IMMEDIATE);
+    res_id   = pdf_defineresource_id(PDF_RESOURCE_CMAP, cmap_name,
+				     cmap_obj, PDF_RES_FLUSH_IMMEDIATE);
     cmap_ref = texpdf_get_resource_reference(res_id);
   } else {
     cmap_ref = NULL;
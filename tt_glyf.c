@@ -32,15 +32,12 @@
 static USHORT
 find_empty_slot (struct tt_glyphs *g)
 {
-  USHORT gid;
+  long gid;
 
   ASSERT(g);
 
-  for (gid = 0; gid < NUM_GLYPH_LIMIT; gid++) {
-    if (!(g->used_slot[gid/8] & (1 << (7 - (gid % 8)))))
-      break;
-  }
-  if (gid == NUM_GLYPH_LIMIT)
+  gid = used_chars2_next_unused((const char *) g->used_slot, 0);
+  if (gid < 0 || gid >= NUM_GLYPH_LIMIT)
     ERROR("No empty glyph slot available.");
 
   return gid;
@@ -185,6 +182,278 @@ glyf_cmp (const void *v1, const void *v2)
 #define WE_HAVE_INSTRUCTIONS      (1 << 8)
 #define USE_MY_METRICS            (1 << 9)
 
+/*
+ * Glyph data cache.
+ *
+ * When enabled, loca, hmtx, vmtx and every glyph program read from a
+ * font are kept in memory after the font has been subset once, so that
+ * later documents embedding the same font build their subsets from
+ * memory without seeking in the font file again. A cached font is
+ * found by the offsets and lengths of the tables the cached data is
+ * derived from and by the size and modification time of the file, and
+ * confirmed by an MD5 digest of those tables.
+ */
+#include <sys/stat.h>
+
+struct tt_glyf_comp
+{
+  ULONG  pos; /* position of the component GID in the glyph program */
+  USHORT gid;
+};
+
+struct tt_cached_glyph
+{
+  BYTE   *data; /* NULL until first read */
+  USHORT  num_comps;
+  struct tt_glyf_comp *comps;
+};
+
+#define GLYF_CACHE_NUM_TAGS 8
+static const char *glyf_cache_tags[GLYF_CACHE_NUM_TAGS] = {
+  "head", "hhea", "maxp", "loca", "glyf", "hmtx", "vhea", "vmtx"
+};
+
+#define GLYF_CACHE_KEY_LEN (2 * GLYF_CACHE_NUM_TAGS + 2)
+
+struct tt_glyf_cache
+{
+  ULONG   key[GLYF_CACHE_KEY_LEN];
+  unsigned char digest[16];
+  USHORT  num_glyphs;
+  ULONG  *location;
+  struct tt_longMetrics  *hmtx, *vmtx;
+  struct tt_cached_glyph *glyphs; /* NULL if not kept in the cache */
+  struct tt_glyf_cache   *next;
+};
+
+static int glyf_cache_enabled = 0;
+static struct tt_glyf_cache *glyf_cache = NULL;
+
+static void
+glyf_cache_release (struct tt_glyf_cache *c)
+{
+  if (c->glyphs) {
+    long gid;
+
+    for (gid = 0; gid < c->num_glyphs; gid++) {
+      if (c->glyphs[gid].data)
+        RELEASE(c->glyphs[gid].data);
+      if (c->glyphs[gid].comps)
+        RELEASE(c->glyphs[gid].comps);
+    }
+    RELEASE(c->glyphs);
+  }
+  RELEASE(c->location);
+  RELEASE(c->hmtx);
+  if (c->vmtx)
+    RELEASE(c->vmtx);
+  RELEASE(c);
+}
+
+void
+texpdf_tt_set_glyf_cache (int enable)
+{
+  glyf_cache_enabled = enable;
+  if (!enable) {
+    while (glyf_cache) {
+      struct tt_glyf_cache *next = glyf_cache->next;
+
+      glyf_cache_release(glyf_cache);
+      glyf_cache = next;
+    }
+  }
+}
+
+static void
+glyf_cache_key (sfnt *sfont, ULONG *key)
+{
+  struct sfnt_table_directory *td = sfont->directory;
+  struct stat sb;
+  int    i, j;
+
+  for (i = 0; i < GLYF_CACHE_NUM_TAGS; i++) {
+    key[2*i] = key[2*i+1] = 0;
+    for (j = 0; j < td->num_tables; j++) {
+      if (!memcmp(td->tables[j].tag, glyf_cache_tags[i], 4)) {
+        key[2*i]   = td->tables[j].offset;
+        key[2*i+1] = td->tables[j].length;
+        break;
+      }
+    }
+  }
+  if (fstat(fileno(sfont->stream), &sb) == 0) {
+    key[2*i]   = (ULONG) sb.st_size;
+    key[2*i+1] = (ULONG) sb.st_mtime;
+  } else {
+    key[2*i] = key[2*i+1] = 0;
+  }
+}
+
+static void
+glyf_cache_digest (sfnt *sfont, unsigned char *digest)
+{
+  struct sfnt_table_directory *td = sfont->directory;
+  MD5_CONTEXT md5;
+  BYTE   buf[4096];
+  ULONG  length, n;
+  int    i, j;
+
+  texpdf_MD5_init(&md5);
+  for (i = 0; i < GLYF_CACHE_NUM_TAGS; i++) {
+    for (j = 0; j < td->num_tables; j++) {
+      if (!memcmp(td->tables[j].tag, glyf_cache_tags[i], 4))
+        break;
+    }
+    if (j == td->num_tables)
+      continue;
+    sfnt_seek_set(sfont, td->tables[j].offset);
+    for (length = td->tables[j].length; length > 0; length -= n) {
+      n = MIN(length, sizeof(buf));
+      if (sfnt_read(buf, n, sfont) != n)
+        ERROR("Reading TrueType font file failed.");
+      texpdf_MD5_write(&md5, buf, n);
+    }
+  }
+  texpdf_MD5_final(digest, &md5);
+}
+
+/*
+ * Returns location and metrics of the font, from the cache if possible.
+ * Unless the glyph cache is enabled the result is private to the caller
+ * and must be released with glyf_cache_release().
+ */
+static struct tt_glyf_cache *
+glyf_cache_get (sfnt *sfont, struct tt_head_table *head,
+                struct tt_hhea_table *hhea, struct tt_maxp_table *maxp)
+{
+  struct tt_glyf_cache *c;
+  ULONG  key[GLYF_CACHE_KEY_LEN];
+  unsigned char digest[16];
+  int    have_digest = 0;
+  long   i;
+
+  if (glyf_cache_enabled) {
+    glyf_cache_key(sfont, key);
+    for (c = glyf_cache; c; c = c->next) {
+      if (memcmp(c->key, key, sizeof(key)))
+        continue;
+      if (!have_digest) {
+        glyf_cache_digest(sfont, digest);
+        have_digest = 1;
+      }
+      if (!memcmp(c->digest, digest, sizeof(digest)))
+        return c;
+    }
+  }
+
+  c = NEW(1, struct tt_glyf_cache);
+  c->num_glyphs = maxp->numGlyphs;
+
+  sfnt_locate_table(sfont, "hmtx");
+  c->hmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, hhea->numOfLongHorMetrics, hhea->numOfExSideBearings);
+
+  if (sfnt_find_table_pos(sfont, "vmtx") > 0) {
+    struct tt_vhea_table *vhea;
+    vhea = tt_read_vhea_table(sfont);
+    sfnt_locate_table(sfont, "vmtx");
+    c->vmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, vhea->numOfLongVerMetrics, vhea->numOfExSideBearings);
+    RELEASE(vhea);
+  } else {
+    c->vmtx = NULL;
+  }
+
+  sfnt_locate_table(sfont, "loca");
+  c->location = NEW(maxp->numGlyphs + 1, ULONG);
+  if (head->indexToLocFormat == 0) {
+    for (i = 0; i <= maxp->numGlyphs; i++)
+      c->location[i] = 2*((ULONG) sfnt_get_ushort(sfont));
+  } else if (head->indexToLocFormat == 1) {
+    for (i = 0; i <= maxp->numGlyphs; i++)
+      c->location[i] = sfnt_get_ulong(sfont);
+  } else {
+    ERROR("Unknown IndexToLocFormat.");
+  }
+
+  if (glyf_cache_enabled) {
+    if (!have_digest)
+      glyf_cache_digest(sfont, digest);
+    memcpy(c->key, key, sizeof(key));
+    memcpy(c->digest, digest, sizeof(digest));
+    c->glyphs = NEW(maxp->numGlyphs, struct tt_cached_glyph);
+    memset(c->glyphs, 0, maxp->numGlyphs * sizeof(struct tt_cached_glyph));
+    c->next    = glyf_cache;
+    glyf_cache = c;
+  } else {
+    c->glyphs = NULL;
+    c->next   = NULL;
+  }
+
+  return c;
+}
+
+/*
+ * Read the glyph program of gid, recording where the component glyph
+ * indices of a composite glyph sit in it.
+ */
+static BYTE *
+glyf_read_glyph (sfnt *sfont, ULONG offset, ULONG loc, ULONG len,
+                 USHORT gid, USHORT num_glyphs,
+                 USHORT *num_comps, struct tt_glyf_comp **comps)
+{
+  BYTE  *data, *p, *endptr;
+  SHORT  number_of_contours;
+
+  data = NEW(len, BYTE);
+  sfnt_seek_set(sfont, offset+loc);
+  if (sfnt_read(data, len, sfont) != len)
+    ERROR("Reading TrueType glyph data failed (gid %u).", gid);
+
+  *num_comps = 0;
+  *comps     = NULL;
+
+  number_of_contours = (SHORT) ((data[0] << 8)|data[1]);
+  if (number_of_contours < 0) {
+    USHORT flags, cgid; /* flag, gid of a component */
+
+    p = data + 10; endptr = data + len;
+    do {
+      if (p >= endptr)
+	ERROR("Invalid TrueType glyph data (gid %u): %u bytes", gid, len);
+      /*
+       * Flags and gid of component glyph are both USHORT.
+       */
+      flags = ((*p) << 8)| *(p+1);
+      p += 2;
+      cgid  = ((*p) << 8)| *(p+1);
+      if (cgid >= num_glyphs) {
+	ERROR("Invalid gid (%u > %u) in composite glyph %u.", cgid, num_glyphs, gid);
+      }
+      *comps = RENEW(*comps, *num_comps + 1, struct tt_glyf_comp);
+      (*comps)[*num_comps].pos = p - data;
+      (*comps)[*num_comps].gid = cgid;
+      (*num_comps)++;
+      p += 2;
+      /*
+       * Just skip remaining part.
+       */
+      p += (flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
+      if (flags & WE_HAVE_A_SCALE) /* F2Dot14 */
+	p += 2;
+      else if (flags & WE_HAVE_AN_X_AND_Y_SCALE) /* F2Dot14 x 2 */
+	p += 4;
+      else if (flags & WE_HAVE_A_TWO_BY_TWO) /* F2Dot14 x 4 */
+	p += 8;
+    } while (flags & MORE_COMPONENT);
+    /*
+     * TrueType instructions comes here:
+     *  length_of_instruction (ushort)
+     *  instruction (byte * length_of_instruction)
+     */
+  }
+
+  return data;
+}
+
 int
 tt_build_tables (sfnt *sfont, struct tt_glyphs *g)
 {
@@ -197,6 +466,7 @@ tt_build_tables (sfnt *sfont, struct tt_glyphs *g)
   struct tt_maxp_table *maxp = NULL;
   struct tt_longMetrics *hmtx, *vmtx = NULL;
   struct tt_os2__table  *os2;
+  struct tt_glyf_cache  *cache;
   /* temp */
   ULONG  *location, offset;
   long    i;
@@ -232,36 +502,16 @@ tt_build_tables (sfnt *sfont, struct tt_glyphs *g)
 
   g->emsize = head->unitsPerEm;
 
-  sfnt_locate_table(sfont, "hmtx");
-  hmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, hhea->numOfLongHorMetrics, hhea->numOfExSideBearings);
-
   os2 = tt_read_os2__table(sfont);
   if (os2) {
     g->default_advh = os2->sTypoAscender - os2->sTypoDescender;
     g->default_tsb  = g->default_advh - os2->sTypoAscender;
   }
 
-  if (sfnt_find_table_pos(sfont, "vmtx") > 0) {
-    struct tt_vhea_table *vhea;
-    vhea = tt_read_vhea_table(sfont);
-    sfnt_locate_table(sfont, "vmtx");
-    vmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, vhea->numOfLongVerMetrics, vhea->numOfExSideBearings);
-    RELEASE(vhea);
-  } else {
-    vmtx = NULL;
-  }
-
-  sfnt_locate_table(sfont, "loca");
-  location = NEW(maxp->numGlyphs + 1, ULONG);
-  if (head->indexToLocFormat == 0) {
-    for (i = 0; i <= maxp->numGlyphs; i++)
-      location[i] = 2*((ULONG) sfnt_get_ushort(sfont));
-  } else if (head->indexToLocFormat == 1) {
-    for (i = 0; i <= maxp->numGlyphs; i++)
-      location[i] = sfnt_get_ulong(sfont);
-  } else {
-    ERROR("Unknown IndexToLocFormat.");
-  }
+  cache    = glyf_cache_get(sfont, head, hhea, maxp);
+  location = cache->location;
+  hmtx     = cache->hmtx;
+  vmtx     = cache->vmtx;
 
   w_stat = NEW(g->emsize+2, USHORT);
   memset(w_stat, 0, sizeof(USHORT)*(g->emsize+2));
@@ -279,8 +529,9 @@ tt_build_tables (sfnt *sfont, struct tt_glyphs *g)
   for (i = 0; i < NUM_GLYPH_LIMIT; i++) {
     USHORT gid;     /* old gid */
     ULONG  loc, len;
-    BYTE  *p, *endptr;
-    SHORT  number_of_contours;
+    BYTE  *p;
+    USHORT num_comps, j;
+    struct tt_glyf_comp *comps;
 
     if (i >= g->num_glyphs) /* finished */
       break;
@@ -314,74 +565,50 @@ tt_build_tables (sfnt *sfont, struct tt_glyphs *g)
       ERROR("Invalid TrueType glyph data (gid %u).", gid);
     }
 
-    g->gd[i].data = p = NEW(len, BYTE);
-    endptr = p + len;
+    if (cache->glyphs) {
+      struct tt_cached_glyph *cg = &cache->glyphs[gid];
 
-    sfnt_seek_set(sfont, offset+loc);
-    number_of_contours = sfnt_get_short(sfont);
-    p += sfnt_put_short(p, number_of_contours);
+      if (!cg->data)
+        cg->data = glyf_read_glyph(sfont, offset, loc, len, gid, maxp->numGlyphs,
+                                   &cg->num_comps, &cg->comps);
+      p = NEW(len, BYTE);
+      memcpy(p, cg->data, len);
+      num_comps = cg->num_comps;
+      comps     = cg->comps;
+    } else {
+      p = glyf_read_glyph(sfont, offset, loc, len, gid, maxp->numGlyphs,
+                          &num_comps, &comps);
+    }
+    g->gd[i].data = p;
 
     /* BoundingBox: FWord x 4 */
-    g->gd[i].llx = sfnt_get_short(sfont);
-    g->gd[i].lly = sfnt_get_short(sfont);
-    g->gd[i].urx = sfnt_get_short(sfont);
-    g->gd[i].ury = sfnt_get_short(sfont);
+    g->gd[i].llx = (SHORT) ((p[2] << 8)|p[3]);
+    g->gd[i].lly = (SHORT) ((p[4] << 8)|p[5]);
+    g->gd[i].urx = (SHORT) ((p[6] << 8)|p[7]);
+    g->gd[i].ury = (SHORT) ((p[8] << 8)|p[9]);
     /* _FIXME_ */
 #if  1
     if (!vmtx) /* vertOriginY == sTypeAscender */
       g->gd[i].tsb = g->default_advh - g->default_tsb - g->gd[i].ury;
 #endif
-    p += sfnt_put_short(p, g->gd[i].llx);
-    p += sfnt_put_short(p, g->gd[i].lly);
-    p += sfnt_put_short(p, g->gd[i].urx);
-    p += sfnt_put_short(p, g->gd[i].ury);
 
-    /* Read evrything else. */
-    sfnt_read(p, len - 10, sfont);
     /*
      * Fix GIDs of composite glyphs.
      */
-    if (number_of_contours < 0) {
-      USHORT flags, cgid, new_gid; /* flag, gid of a component */
-      do {
-	if (p >= endptr)
-	  ERROR("Invalid TrueType glyph data (gid %u): %u bytes", gid, len);
-	/*
-	 * Flags and gid of component glyph are both USHORT.
-	 */
-	flags = ((*p) << 8)| *(p+1);
-	p += 2;
-	cgid  = ((*p) << 8)| *(p+1);
-	if (cgid >= maxp->numGlyphs) {
-	  ERROR("Invalid gid (%u > %u) in composite glyph %u.", cgid, maxp->numGlyphs, gid);
-	}
-	new_gid = tt_find_glyph(g, cgid);
-	if (new_gid == 0) {
-	  new_gid = tt_add_glyph(g, cgid, find_empty_slot(g));
-	}
-	p += sfnt_put_ushort(p, new_gid);
-	/*
-	 * Just skip remaining part.
-	 */
-	p += (flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
-	if (flags & WE_HAVE_A_SCALE) /* F2Dot14 */
-	  p += 2;
-	else if (flags & WE_HAVE_AN_X_AND_Y_SCALE) /* F2Dot14 x 2 */
-	  p += 4;
-	else if (flags & WE_HAVE_A_TWO_BY_TWO) /* F2Dot14 x 4 */
-	  p += 8;
-      } while (flags & MORE_COMPONENT);
-      /*
-       * TrueType instructions comes here:
-       *  length_of_instruction (ushort)
-       *  instruction (byte * length_of_instruction)
-       */
+    for (j = 0; j < num_comps; j++) {
+      USHORT new_gid;
+
+      new_gid = tt_find_glyph(g, comps[j].gid);
+      if (new_gid == 0) {
+	new_gid = tt_add_glyph(g, comps[j].gid, find_empty_slot(g));
+      }
+      sfnt_put_ushort(p + comps[j].pos, new_gid);
     }
+    if (!cache->glyphs && comps)
+      RELEASE(comps);
   }
-  RELEASE(location);
-  RELEASE(hmtx);
-  if (vmtx)
-    RELEASE(vmtx);
+  if (!cache->glyphs)
+    glyf_cache_release(cache);
 
   {
     int max_count = -1;
@@ -505,6 +732,7 @@ tt_get_metrics (sfnt *sfont, struct tt_glyphs *g)
   struct tt_maxp_table *maxp = NULL;
   struct tt_longMetrics *hmtx, *vmtx = NULL;
   struct tt_os2__table  *os2;
+  struct tt_glyf_cache  *cache;
   /* temp */
   ULONG  *location, offset;
   long    i;
@@ -537,34 +765,14 @@ tt_get_metrics (sfnt *sfont, struct tt_glyphs *g)
 
   g->emsize = head->unitsPerEm;
 
-  sfnt_locate_table(sfont, "hmtx");
-  hmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, hhea->numOfLongHorMetrics, hhea->numOfExSideBearings);
-
   os2 = tt_read_os2__table(sfont);
   g->default_advh = os2->sTypoAscender - os2->sTypoDescender;
   g->default_tsb  = g->default_advh - os2->sTypoAscender;
 
-  if (sfnt_find_table_pos(sfont, "vmtx") > 0) {
-    struct tt_vhea_table *vhea;
-    vhea = tt_read_vhea_table(sfont);
-    sfnt_locate_table(sfont, "vmtx");
-    vmtx = tt_read_longMetrics(sfont, maxp->numGlyphs, vhea->numOfLongVerMetrics, vhea->numOfExSideBearings);
-    RELEASE(vhea);
-  } else {
-    vmtx = NULL;
-  }
-
-  sfnt_locate_table(sfont, "loca");
-  location = NEW(maxp->numGlyphs + 1, ULONG);
-  if (head->indexToLocFormat == 0) {
-    for (i = 0; i <= maxp->numGlyphs; i++)
-      location[i] = 2*((ULONG) sfnt_get_ushort(sfont));
-  } else if (head->indexToLocFormat == 1) {
-    for (i = 0; i <= maxp->numGlyphs; i++)
-      location[i] = sfnt_get_ulong(sfont);
-  } else {
-    ERROR("Unknown IndexToLocFormat.");
-  }
+  cache    = glyf_cache_get(sfont, head, hhea, maxp);
+  location = cache->location;
+  hmtx     = cache->hmtx;
+  vmtx     = cache->vmtx;
 
   w_stat = NEW(g->emsize+2, USHORT);
   memset(w_stat, 0, sizeof(USHORT)*(g->emsize+2));
@@ -606,30 +814,37 @@ tt_get_metrics (sfnt *sfont, struct tt_glyphs *g)
       ERROR("Invalid TrueType glyph data (gid %u).", gid);
     }
 
-    sfnt_seek_set(sfont, offset+loc);
-    (void)               sfnt_get_short(sfont);
+    if (cache->glyphs && cache->glyphs[gid].data) {
+      BYTE *p = cache->glyphs[gid].data;
 
-    /* BoundingBox: FWord x 4 */
-    g->gd[i].llx = sfnt_get_short(sfont);
-    g->gd[i].lly = sfnt_get_short(sfont);
-    g->gd[i].urx = sfnt_get_short(sfont);
-    g->gd[i].ury = sfnt_get_short(sfont);
+      /* BoundingBox: FWord x 4 */
+      g->gd[i].llx = (SHORT) ((p[2] << 8)|p[3]);
+      g->gd[i].lly = (SHORT) ((p[4] << 8)|p[5]);
+      g->gd[i].urx = (SHORT) ((p[6] << 8)|p[7]);
+      g->gd[i].ury = (SHORT) ((p[8] << 8)|p[9]);
+    } else {
+      sfnt_seek_set(sfont, offset+loc);
+      (void)               sfnt_get_short(sfont);
+
+      /* BoundingBox: FWord x 4 */
+      g->gd[i].llx = sfnt_get_short(sfont);
+      g->gd[i].lly = sfnt_get_short(sfont);
+      g->gd[i].urx = sfnt_get_short(sfont);
+      g->gd[i].ury = sfnt_get_short(sfont);
+    }
     /* _FIXME_ */
 #if  1
     if (!vmtx) /* vertOriginY == sTypeAscender */
       g->gd[i].tsb = g->default_advh - g->default_tsb - g->gd[i].ury;
 #endif
   }
-  RELEASE(location);
-  RELEASE(hmtx);
+  if (!cache->glyphs)
+    glyf_cache_release(cache);
   RELEASE(maxp);
   RELEASE(hhea);
   RELEASE(head);
   RELEASE(os2);
 
-  if (vmtx)
-    RELEASE(vmtx);
-
   {
     int max_count = -1;
 
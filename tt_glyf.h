@@ -55,4 +55,7 @@ extern USHORT tt_find_glyph (struct tt_glyphs *g, USHORT gid);
 extern int    tt_build_tables (sfnt *sfont, struct tt_glyphs *g);
 extern int    tt_get_metrics  (sfnt *sfont, struct tt_glyphs *g);
 
+/* Keep glyph data of subset TrueType fonts in memory across documents. */
+extern void   texpdf_tt_set_glyf_cache (int enable);
+
 #endif /* _TT_GLYF_H_ */
@@ -492,7 +492,7 @@ otl_gsub_read_single (struct otl_gsub_subtab *subtab, sfnt *sfont)
 
   ASSERT(subtab && sfont);
 
-  offset = tell_position(sfont->stream);
+  offset = sfnt_tell(sfont);
 
   subtab->LookupType  = OTL_GSUB_TYPE_SINGLE;
   subtab->SubstFormat = sfnt_get_ushort(sfont);
@@ -551,7 +551,7 @@ otl_gsub_read_alternate (struct otl_gsub_subtab *subtab, sfnt *sfont)
 
   ASSERT(subtab && sfont);
 
-  offset = tell_position(sfont->stream);
+  offset = sfnt_tell(sfont);
 
   subtab->LookupType  = OTL_GSUB_TYPE_ALTERNATE;
   subtab->SubstFormat = sfnt_get_ushort(sfont); /* Must be 1 */
@@ -618,7 +618,7 @@ otl_gsub_read_ligature (struct otl_gsub_subtab *subtab, sfnt *sfont)
 
   ASSERT(subtab && sfont);
 
-  offset = tell_position(sfont->stream);
+  offset = sfnt_tell(sfont);
 
   subtab->LookupType  = OTL_GSUB_TYPE_LIGATURE;
   subtab->SubstFormat = sfnt_get_ushort(sfont); /* Must be 1 */
@@ -60,6 +60,150 @@ new_used_chars2(void)
   return used_chars;
 }
 
+/*
+ * The bitmap is scanned 64 bits at a time. Bytes are loaded big-endian
+ * so that bit order within a word matches CID order (CID 0 is the most
+ * significant bit of the first byte), which keeps the CIDSet layout.
+ */
+#define USED_CHARS2_WORDS (8192 / 8)
+
+#if defined(__GNUC__)
+#define clz64(x)      __builtin_clzll(x)
+#define ctz64(x)      __builtin_ctzll(x)
+#define popcount64(x) __builtin_popcountll(x)
+#else
+static int
+clz64 (uint64_t x)
+{
+  int n = 0;
+
+  while (!(x & ((uint64_t) 1 << 63))) {
+    x <<= 1; n++;
+  }
+  return n;
+}
+
+static int
+ctz64 (uint64_t x)
+{
+  int n = 0;
+
+  while (!(x & 1)) {
+    x >>= 1; n++;
+  }
+  return n;
+}
+
+static int
+popcount64 (uint64_t x)
+{
+  int n = 0;
+
+  for (; x; x &= x - 1)
+    n++;
+  return n;
+}
+#endif
+
+static uint64_t
+used_chars2_word (const char *used_chars, long w)
+{
+  const unsigned char *p = (const unsigned char *) used_chars + 8 * w;
+
+  return ((uint64_t) p[0] << 56) | ((uint64_t) p[1] << 48) |
+         ((uint64_t) p[2] << 40) | ((uint64_t) p[3] << 32) |
+         ((uint64_t) p[4] << 24) | ((uint64_t) p[5] << 16) |
+         ((uint64_t) p[6] <<  8) |  (uint64_t) p[7];
+}
+
+/* Smallest used CID >= cid, or -1 if there is none. */
+long
+used_chars2_next (const char *used_chars, long cid)
+{
+  long     w;
+  uint64_t word;
+
+  if (cid < 0)
+    cid = 0;
+  if (cid > CID_MAX)
+    return -1;
+
+  w    = cid / 64;
+  word = used_chars2_word(used_chars, w) & (~(uint64_t) 0 >> (cid % 64));
+  while (!word) {
+    if (++w >= USED_CHARS2_WORDS)
+      return -1;
+    word = used_chars2_word(used_chars, w);
+  }
+
+  return w * 64 + clz64(word);
+}
+
+/* Smallest unused CID >= cid, or -1 if there is none. */
+long
+used_chars2_next_unused (const char *used_chars, long cid)
+{
+  long     w;
+  uint64_t word;
+
+  if (cid < 0)
+    cid = 0;
+  if (cid > CID_MAX)
+    return -1;
+
+  w    = cid / 64;
+  word = ~used_chars2_word(used_chars, w) & (~(uint64_t) 0 >> (cid % 64));
+  while (!word) {
+    if (++w >= USED_CHARS2_WORDS)
+      return -1;
+    word = ~used_chars2_word(used_chars, w);
+  }
+
+  return w * 64 + clz64(word);
+}
+
+/* Largest used CID <= cid, or -1 if there is none. */
+long
+used_chars2_prev (const char *used_chars, long cid)
+{
+  long     w;
+  uint64_t word;
+
+  if (cid < 0)
+    return -1;
+  if (cid > CID_MAX)
+    cid = CID_MAX;
+
+  w    = cid / 64;
+  word = used_chars2_word(used_chars, w) & (~(uint64_t) 0 << (63 - cid % 64));
+  while (!word) {
+    if (--w < 0)
+      return -1;
+    word = used_chars2_word(used_chars, w);
+  }
+
+  return w * 64 + 63 - ctz64(word);
+}
+
+/* Number of used CIDs in the range 0 to last_cid. */
+long
+used_chars2_count (const char *used_chars, long last_cid)
+{
+  long w, count = 0;
+
+  if (last_cid < 0)
+    return 0;
+  if (last_cid > CID_MAX)
+    last_cid = CID_MAX;
+
+  for (w = 0; w < last_cid / 64; w++)
+    count += popcount64(used_chars2_word(used_chars, w));
+  count += popcount64(used_chars2_word(used_chars, w) &
+                      (~(uint64_t) 0 << (63 - last_cid % 64)));
+
+  return count;
+}
+
 #define FLAG_NONE              0
 #define FLAG_USED_CHARS_SHARED (1 << 0)
 
@@ -648,7 +792,7 @@ pdf_read_ToUnicode_file (const char *cmap_name)
 
   ASSERT(cmap_name);
 
-  res_id = pdf_findresource("CMap", cmap_name);
+  res_id = pdf_findresource_id(PDF_RESOURCE_CMAP, cmap_name);
   if (res_id < 0) {
     if (!strcmp(cmap_name, "Adobe-Identity-UCS2"))
       stream = create_dummy_CMap();
@@ -656,9 +800,9 @@ pdf_read_ToUnicode_file (const char *cmap_name)
       stream = pdf_load_ToUnicode_stream(cmap_name);
     }
     if (stream) {
-      res_id   = pdf_defineresource("CMap",
-                                    cmap_name,
-                                    stream, PDF_RES_FLUSH_IMMEDIATE);
+      res_id   = pdf_defineresource_id(PDF_RESOURCE_CMAP,
+                                       cmap_name,
+                                       stream, PDF_RES_FLUSH_IMMEDIATE);
     }
   }
 
@@ -26,6 +26,12 @@
 #define add_to_used_chars2(b,c) {(b)[(c)/8] |= (1 << (7-((c)%8)));}
 #define is_used_char2(b,c) (((b)[(c)/8]) & (1 << (7-((c)%8))))
 
+/* Word-at-a-time scans over a 65536-bit used_chars bitmap. */
+extern long       used_chars2_next        (const char *used_chars, long cid);
+extern long       used_chars2_next_unused (const char *used_chars, long cid);
+extern long       used_chars2_prev        (const char *used_chars, long cid);
+extern long       used_chars2_count       (const char *used_chars, long last_cid);
+
 typedef struct Type0Font Type0Font;
 
 extern void       Type0Font_set_verbose (void);
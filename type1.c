@@ -439,6 +439,255 @@ write_fontfile (pdf_font *font, cff_font *cffont)
 }
 
 
+/*
+ * Converted charstring cache: Type 2 charstrings produced by
+ * t1char_convert_charstring() are kept in <dir>/<md5>.t1c, where <md5>
+ * is the MD5 digest of the Type 1 font file. Glyphs are added to the
+ * file as documents use them, so each glyph of a font is converted
+ * only once per cache directory. All numbers are big-endian.
+ */
+
+#define T1CACHE_MAGIC     "TPDFT1C1"
+#define T1CACHE_MAGIC_LEN 8
+
+static char *t1cache_dir = NULL;
+
+void
+texpdf_type1_set_cache_dir (const char *dir)
+{
+  if (t1cache_dir)
+    RELEASE(t1cache_dir);
+  t1cache_dir = NULL;
+  if (dir && dir[0]) {
+    t1cache_dir = NEW(strlen(dir)+1, char);
+    strcpy(t1cache_dir, dir);
+  }
+}
+
+struct t1_cache {
+  char      *filename;
+  unsigned char digest[16];
+  long       count;     /* number of glyphs in the font */
+  card8    **cstring;   /* converted charstring by original GID, or NULL */
+  card16    *length;
+  t1_ginfo  *ginfo;     /* only use_seac, wx and seac.achar/bchar are kept */
+  int        modified;
+};
+
+static void
+t1cache_put (FILE *fp, ULONG value, int n)
+{
+  while (n-- > 0)
+    fputc((value >> (8 * n)) & 0xff, fp);
+}
+
+static ULONG
+t1cache_get (const card8 **p, const card8 *endptr, int n, int *error)
+{
+  ULONG value = 0;
+
+  if (*error || endptr - *p < n) {
+    *error = 1;
+    return 0;
+  }
+  while (n-- > 0)
+    value = (value << 8) | *(*p)++;
+
+  return value;
+}
+
+static void
+t1cache_read (struct t1_cache *cache)
+{
+  card8       *data;
+  const card8 *p, *endptr;
+  FILE        *fp;
+  long         len, gid;
+  ULONG        count, i, size, fx;
+  int          error = 0;
+
+  fp = fopen(cache->filename, FOPEN_RBIN_MODE);
+  if (!fp)
+    return;
+
+  len  = file_size(fp);
+  data = NEW(len > 0 ? len : 1, card8);
+  if (len < T1CACHE_MAGIC_LEN + 16 + 4 ||
+      fread(data, 1, len, fp) != (size_t) len ||
+      memcmp(data, T1CACHE_MAGIC, T1CACHE_MAGIC_LEN) ||
+      memcmp(data + T1CACHE_MAGIC_LEN, cache->digest, 16)) {
+    RELEASE(data);
+    fclose(fp);
+    return;
+  }
+  fclose(fp);
+
+  p      = data + T1CACHE_MAGIC_LEN + 16;
+  endptr = data + len;
+  if (t1cache_get(&p, endptr, 2, &error) != cache->count) {
+    RELEASE(data);
+    return;
+  }
+  count = t1cache_get(&p, endptr, 2, &error);
+  for (i = 0; i < count && !error; i++) {
+    t1_ginfo *gm;
+
+    gid  = t1cache_get(&p, endptr, 2, &error);
+    size = t1cache_get(&p, endptr, 2, &error);
+    if (error || gid >= cache->count || size > CS_STR_LEN_MAX ||
+	(ULONG) (endptr - p) < size + 7 || cache->cstring[gid]) {
+      error = 1;
+      break;
+    }
+    gm = &cache->ginfo[gid];
+    gm->use_seac   = t1cache_get(&p, endptr, 1, &error);
+    gm->seac.achar = t1cache_get(&p, endptr, 1, &error);
+    gm->seac.bchar = t1cache_get(&p, endptr, 1, &error);
+    fx = t1cache_get(&p, endptr, 4, &error);
+    gm->wx = ((fx & 0x80000000UL) ?
+	      -(double) ((~fx + 1) & 0xffffffffUL) : (double) fx) / 0x10000;
+    cache->cstring[gid] = NEW(size > 0 ? size : 1, card8);
+    memcpy(cache->cstring[gid], p, size);
+    cache->length[gid]  = size;
+    p += size;
+  }
+  if (error) {
+    WARN("Type1: Ignoring broken charstring cache \"%s\".", cache->filename);
+    for (gid = 0; gid < cache->count; gid++) {
+      if (cache->cstring[gid])
+	RELEASE(cache->cstring[gid]);
+      cache->cstring[gid] = NULL;
+    }
+  }
+
+  RELEASE(data);
+}
+
+static struct t1_cache *
+t1cache_open (FILE *fp, long num_glyphs)
+{
+  struct t1_cache *cache;
+  MD5_CONTEXT      md5;
+  unsigned char    buf[4096];
+  size_t           n;
+  long             gid;
+  int              i;
+
+  if (!t1cache_dir)
+    return NULL;
+
+  cache = NEW(1, struct t1_cache);
+
+  texpdf_MD5_init(&md5);
+  rewind(fp);
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    texpdf_MD5_write(&md5, buf, n);
+  texpdf_MD5_final(cache->digest, &md5);
+  rewind(fp);
+
+  cache->filename = NEW(strlen(t1cache_dir) + 32 + 6, char);
+  sprintf(cache->filename, "%s/", t1cache_dir);
+  for (i = 0; i < 16; i++)
+    sprintf(cache->filename + strlen(cache->filename), "%02x", cache->digest[i]);
+  strcat(cache->filename, ".t1c");
+
+  cache->count    = num_glyphs;
+  cache->cstring  = NEW(num_glyphs, card8 *);
+  cache->length   = NEW(num_glyphs, card16);
+  cache->ginfo    = NEW(num_glyphs, t1_ginfo);
+  cache->modified = 0;
+  for (gid = 0; gid < num_glyphs; gid++)
+    cache->cstring[gid] = NULL;
+
+  t1cache_read(cache);
+
+  return cache;
+}
+
+/* Returns the length of the Type 2 charstring of GID written to dst. */
+static long
+t1cache_convert (struct t1_cache *cache, cff_font *cffont, card16 gid,
+		 card8 *dst, double defaultwidth, double nominalwidth,
+		 t1_ginfo *gm)
+{
+  card8 *src;
+  long   srclen, len;
+
+  if (cache && cache->cstring[gid]) {
+    memcpy(dst, cache->cstring[gid], cache->length[gid]);
+    *gm = cache->ginfo[gid];
+    return cache->length[gid];
+  }
+
+  src    = cffont->cstrings->data + cffont->cstrings->offset[gid] - 1;
+  srclen = cffont->cstrings->offset[gid + 1] - cffont->cstrings->offset[gid];
+  len    = t1char_convert_charstring(dst, CS_STR_LEN_MAX, src, srclen,
+				     cffont->subrs[0], defaultwidth, nominalwidth, gm);
+  if (cache) {
+    cache->cstring[gid] = NEW(len > 0 ? len : 1, card8);
+    memcpy(cache->cstring[gid], dst, len);
+    cache->length[gid] = len;
+    cache->ginfo[gid]  = *gm;
+    cache->modified    = 1;
+  }
+
+  return len;
+}
+
+static void
+t1cache_close (struct t1_cache *cache)
+{
+  FILE  *fp;
+  char  *tmpname;
+  long   gid, count;
+
+  if (!cache)
+    return;
+
+  if (cache->modified) {
+    /* Written under a temporary name and renamed, so readers never see a partial file. */
+    fp = dpx_open_temp_file(cache->filename, &tmpname);
+    if (fp) {
+      for (count = 0, gid = 0; gid < cache->count; gid++) {
+	if (cache->cstring[gid])
+	  count++;
+      }
+      fwrite(T1CACHE_MAGIC, 1, T1CACHE_MAGIC_LEN, fp);
+      fwrite(cache->digest, 1, 16, fp);
+      t1cache_put(fp, cache->count, 2);
+      t1cache_put(fp, count, 2);
+      for (gid = 0; gid < cache->count; gid++) {
+	t1_ginfo *gm = &cache->ginfo[gid];
+
+	if (!cache->cstring[gid])
+	  continue;
+	t1cache_put(fp, gid, 2);
+	t1cache_put(fp, cache->length[gid], 2);
+	t1cache_put(fp, gm->use_seac ? 1 : 0, 1);
+	t1cache_put(fp, gm->use_seac ? gm->seac.achar : 0, 1);
+	t1cache_put(fp, gm->use_seac ? gm->seac.bchar : 0, 1);
+	t1cache_put(fp, (ULONG) (long) floor(gm->wx * 0x10000 + 0.5), 4);
+	fwrite(cache->cstring[gid], 1, cache->length[gid], fp);
+      }
+      if (fclose(fp) == 0)
+	rename(tmpname, cache->filename);
+      else
+	remove(tmpname);
+      RELEASE(tmpname);
+    }
+  }
+
+  for (gid = 0; gid < cache->count; gid++) {
+    if (cache->cstring[gid])
+      RELEASE(cache->cstring[gid]);
+  }
+  RELEASE(cache->cstring);
+  RELEASE(cache->length);
+  RELEASE(cache->ginfo);
+  RELEASE(cache->filename);
+  RELEASE(cache);
+}
+
 int
 pdf_font_load_type1 (pdf_font *font)
 {
@@ -453,6 +702,7 @@ pdf_font_load_type1 (pdf_font *font)
   double        defaultwidth, nominalwidth;
   double       *widths;
   card16       *GIDMap, num_glyphs = 0;
+  struct t1_cache *cache;
   FILE         *fp;
   long          offset;
   int           code, verbose;
@@ -498,6 +748,7 @@ pdf_font_load_type1 (pdf_font *font)
   if (!cffont) {
     ERROR("Could not load Type 1 font: %s", ident);
   }
+  cache = t1cache_open(fp, cffont->cstrings->count);
   DPXFCLOSE(fp);
 
   fullname = NEW(strlen(fontname) + 8, char);
@@ -643,8 +894,8 @@ pdf_font_load_type1 (pdf_font *font)
     cff_index *cstring;
     t1_ginfo   gm;
     card16     gid, gid_orig;
-    long       dstlen_max, srclen;
-    card8     *srcptr, *dstptr;
+    long       dstlen_max;
+    card8     *dstptr;
 
     offset  = dstlen_max = 0L;
     cstring = cff_new_index(cffont->cstrings->count);
@@ -660,12 +911,9 @@ pdf_font_load_type1 (pdf_font *font)
       gid_orig = GIDMap[gid];
 
       dstptr   = cstring->data + cstring->offset[gid] - 1;
-      srcptr   = cffont->cstrings->data + cffont->cstrings->offset[gid_orig] - 1;
-      srclen   = cffont->cstrings->offset[gid_orig + 1] - cffont->cstrings->offset[gid_orig];
 
-      offset  += t1char_convert_charstring(dstptr, CS_STR_LEN_MAX,
-					   srcptr, srclen,
-					   cffont->subrs[0], defaultwidth, nominalwidth, &gm);
+      offset  += t1cache_convert(cache, cffont, gid_orig, dstptr,
+				 defaultwidth, nominalwidth, &gm);
       cstring->offset[gid + 1] = offset + 1;
       if (gm.use_seac) {
 	long  bchar_gid, achar_gid, i;
@@ -720,6 +968,8 @@ pdf_font_load_type1 (pdf_font *font)
     }
     cstring->count = num_glyphs;
 
+    t1cache_close(cache);
+
     cff_release_index(cffont->subrs[0]);
     cffont->subrs[0] = NULL;
     RELEASE(cffont->subrs);
@@ -728,6 +978,9 @@ pdf_font_load_type1 (pdf_font *font)
     cff_release_index(cffont->cstrings);
     cffont->cstrings = cstring;
 
+    cff_release_index(cffont->gsubr);
+    cffont->gsubr    = cs_subroutinize(cffont->cstrings);
+
     cff_release_charsets(cffont->charsets);
     cffont->charsets = charset;
   }
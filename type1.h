@@ -28,4 +28,7 @@
 extern int  pdf_font_open_type1 (pdf_font *font);
 extern int  pdf_font_load_type1 (pdf_font *font);
 
+/* Directory for cached Type 2 conversions of Type 1 charstrings, NULL to disable. */
+extern void texpdf_type1_set_cache_dir (const char *dir);
+
 #endif /* _TYPE1_H_ */
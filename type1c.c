@@ -67,7 +67,7 @@ pdf_font_open_type1c (pdf_font *font)
     ERROR("No \"CFF \" table found; not a CFF/OpenType font (10)?");
   }
 
-  cffont = cff_open(sfont->stream, offset, 0);
+  cffont = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
   if (!cffont) {
     ERROR("Could not read CFF font data");
   }
@@ -264,7 +264,7 @@ pdf_font_load_type1c (pdf_font *font)
     ERROR("Not a CFF/OpenType font (11)?");
   }
 
-  cffont = cff_open(fp, offset, 0);
+  cffont = cff_open_buffer(sfont->buffer, sfont->size, offset, 0);
   if (!cffont) {
     ERROR("Could not open CFF font.");
   }
@@ -538,7 +538,6 @@ pdf_font_load_type1c (pdf_font *font)
 
   charstrings->offset[num_glyphs] = charstring_len + 1;
   charstrings->count = num_glyphs;
-  charstring_len     = cff_index_size(charstrings);
   cffont->num_glyphs = num_glyphs;
 
   /*
@@ -551,11 +550,13 @@ pdf_font_load_type1c (pdf_font *font)
     cff_release_encoding(cffont->encoding);
   cffont->encoding = encoding;
   /*
-   * We don't use subroutines at all.
+   * We don't use the font's subroutines; new global ones are made
+   * only when subroutinization is enabled.
    */
   if (cffont->gsubr)
     cff_release_index(cffont->gsubr);
-  cffont->gsubr = cff_new_index(0);
+  cffont->gsubr  = cs_subroutinize(charstrings);
+  charstring_len = cff_index_size(charstrings);
   if (cffont->subrs[0])
     cff_release_index(cffont->subrs[0]);
   cffont->subrs[0] = NULL;